@@ -1,45 +1,276 @@
 #include "ButtonController.h"
 
-ButtonController::ButtonController(int pinBlack, int pinRed)
-    : pinBlack(pinBlack), pinRed(pinRed) { init(); }
+#include "Metrics.h"
+
+ButtonController::ButtonController(int pinBlack, int pinRed) {
+    buttons[BUTTON_BLACK].pin = pinBlack;
+    buttons[BUTTON_RED].pin = pinRed;
+}
+
+/**
+ * @brief Configures the pins and attaches the edge interrupts.
+ *
+ * Call this once in setup().
+ */
+void ButtonController::begin() {
+    init();
+}
 
 void ButtonController::init() {
-    pinMode(pinBlack, INPUT_PULLUP);
-    pinMode(pinRed, INPUT_PULLUP);
+    for (Button& button : buttons) {
+        pinMode(button.pin, INPUT_PULLUP);
+        button.pressed = digitalRead(button.pin) == LOW;
+    }
+    attachInterruptArg(digitalPinToInterrupt(buttons[BUTTON_BLACK].pin), onBlackEdge, this, CHANGE);
+    attachInterruptArg(digitalPinToInterrupt(buttons[BUTTON_RED].pin), onRedEdge, this, CHANGE);
+}
 
-    // Initialize Bounce-Objects
-    buttonBlack.attach(pinBlack);
-    buttonRed.attach(pinRed);
-    buttonBlack.interval(50);  // Debounce-Zeit in ms
-    buttonRed.interval(50);
+void IRAM_ATTR ButtonController::onBlackEdge(void* arg) {
+    static_cast<ButtonController*>(arg)->pushEdge(BUTTON_BLACK);
 }
 
+void IRAM_ATTR ButtonController::onRedEdge(void* arg) {
+    static_cast<ButtonController*>(arg)->pushEdge(BUTTON_RED);
+}
+
+/**
+ * @brief Stores an edge with its time and the new level.
+ *
+ * Runs in the interrupt. If the buffer is full, the edge is dropped and
+ * update() reads the pins again instead.
+ */
+void IRAM_ATTR ButtonController::pushEdge(uint8_t button) {
+    uint8_t h = head.load(std::memory_order_relaxed);
+    if ((uint8_t)(h - tail.load(std::memory_order_acquire)) >= BUTTON_EDGE_QUEUE_SIZE) {
+        overflow.store(true, std::memory_order_relaxed);
+        return;
+    }
+    Edge& edge = edges[h % BUTTON_EDGE_QUEUE_SIZE];
+    edge.at = millis();
+    edge.button = button;
+    edge.low = digitalRead(buttons[button].pin) == LOW;
+    head.store(h + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Debounces the stored edges and calls the callbacks.
+ *
+ * Call this in every loop. The edges are evaluated by their timestamps,
+ * so the result does not depend on how long ago the last call was.
+ */
 void ButtonController::update() {
-    // Update Bounce-Objects
-    buttonBlack.update();
-    buttonRed.update();
+    // Vor dem Leeren des Puffers: jede Flanke bis now steht dann schon darin
+    uint32_t now = millis();
+    uint8_t t = tail.load(std::memory_order_relaxed);
+    while (t != head.load(std::memory_order_acquire)) {
+        Edge edge = edges[t % BUTTON_EDGE_QUEUE_SIZE];
+        tail.store(++t, std::memory_order_release);
+        settle(edge.at);
+        handleEdge(edge);
+    }
+    if (overflow.exchange(false)) {
+        metrics.buttonEdgeOverflows++;
+        resync(now);
+    }
+    settle(now);
+}
 
-    bool blackPressed = buttonBlack.read() == LOW;
-    bool redPressed = buttonRed.read() == LOW;
+/**
+ * @brief Starts or cancels a level change of a button.
+ *
+ * A bounce back to the debounced level cancels the pending change; every
+ * further change restarts the debounce time.
+ */
+void ButtonController::handleEdge(const Edge& edge) {
+    Button& button = buttons[edge.button];
+    bool current = button.pending ? button.pendingLow : button.pressed;
+    if (edge.low == current) {
+        return;
+    }
+    if (edge.low == button.pressed) {
+        button.pending = false;
+        return;
+    }
+    button.pending = true;
+    button.pendingLow = edge.low;
+    button.pendingSince = edge.at;
+}
 
-    // Trigger individual events only if the combined event is not running
-    if (buttonBlack.fell() && !redPressed) {
-        if (blackPressedCallback) {
-            blackPressedCallback();
+/**
+ * @brief Accepts all level changes that were stable for the debounce time.
+ *
+ * The changes of both buttons are handled in the order they happened, and
+ * the gesture timers only run up to the next change, so the gestures do
+ * not depend on when update() is called.
+ *
+ * @param now The time up to which no further edge exists.
+ */
+void ButtonController::settle(uint32_t now) {
+    while (true) {
+        int8_t next = -1;
+        for (uint8_t id = 0; id < BUTTON_COUNT; id++) {
+            const Button& button = buttons[id];
+            if (!button.pending || (int32_t)(now - button.pendingSince) < BUTTON_DEBOUNCE_MS) {
+                continue;
+            }
+            if (next < 0 || (int32_t)(button.pendingSince - buttons[next].pendingSince) < 0) {
+                next = id;
+            }
+        }
+        if (next < 0) {
+            break;
         }
+        Button& button = buttons[next];
+        for (uint8_t id = 0; id < BUTTON_COUNT; id++) {
+            tick(id, button.pendingSince);
+        }
+        button.pending = false;
+        button.pressed = button.pendingLow;
+        handleChange(next, button.pendingSince);
+    }
+    for (uint8_t id = 0; id < BUTTON_COUNT; id++) {
+        tick(id, now);
     }
+}
 
-    if (buttonRed.fell() && !blackPressed) {
-        if (redPressedCallback) {
-            redPressedCallback();
+/**
+ * @brief Advances the gesture state of a button on a debounced change.
+ *
+ * @param id The button.
+ * @param at The time of the change.
+ */
+void ButtonController::handleChange(uint8_t id, uint32_t at) {
+    Button& button = buttons[id];
+    Button& other = buttons[id == BUTTON_BLACK ? BUTTON_RED : BUTTON_BLACK];
+    button.stateSince = at;
+
+    if (!button.pressed) {
+        if (button.state == STATE_DOWN) {
+            if (button.gestures[GESTURE_DOUBLE_PRESS]) {
+                button.state = STATE_WAIT_SECOND;
+                return;
+            }
+            fire(id, GESTURE_PRESS);
+        }
+        button.state = STATE_IDLE;
+        return;
+    }
+
+    if (other.pressed) {
+        // Akkord: beide Buttons gelten bis zum Loslassen als verbraucht
+        if (other.state != STATE_DONE && chordCallback) {
+            chordCallback();
+        }
+        button.state = STATE_DONE;
+        other.state = STATE_DONE;
+        return;
+    }
+    if (button.state == STATE_WAIT_SECOND) {
+        fire(id, GESTURE_DOUBLE_PRESS);
+        button.state = STATE_DONE;
+        return;
+    }
+    if (!deferPress(id)) {
+        fire(id, GESTURE_PRESS);
+        button.state = STATE_DONE;
+        return;
+    }
+    button.state = STATE_DOWN;
+}
+
+/**
+ * @brief Runs the gesture timers of a button up to the given time.
+ *
+ * While a level change is still being debounced, the timers stop at its
+ * start: the button may already have been released.
+ */
+void ButtonController::tick(uint8_t id, uint32_t now) {
+    Button& button = buttons[id];
+    if (button.pending && (int32_t)(now - button.pendingSince) > 0) {
+        now = button.pendingSince;
+    }
+    uint32_t elapsed = now - button.stateSince;
+    if ((int32_t)elapsed < 0) {
+        return;
+    }
+    switch (button.state) {
+        case STATE_DOWN:
+            if (elapsed >= BUTTON_LONG_PRESS_MS && (button.gestures[GESTURE_LONG_PRESS] || button.gestures[GESTURE_REPEAT])) {
+                // ohne Callback für den langen Druck beginnt hier schon die Wiederholung
+                fire(id, button.gestures[GESTURE_LONG_PRESS] ? GESTURE_LONG_PRESS : GESTURE_REPEAT);
+                button.state = STATE_HELD;
+                button.nextRepeat = button.stateSince + BUTTON_LONG_PRESS_MS + BUTTON_REPEAT_MS;
+            }
+            break;
+        case STATE_HELD:
+            if ((int32_t)(now - button.nextRepeat) >= 0) {
+                fire(id, GESTURE_REPEAT);
+                // nach einer langen Blockade nicht alle verpassten Wiederholungen nachholen
+                button.nextRepeat = (int32_t)(now - button.nextRepeat) >= BUTTON_REPEAT_MS ? now + BUTTON_REPEAT_MS : button.nextRepeat + BUTTON_REPEAT_MS;
+            }
+            break;
+        case STATE_WAIT_SECOND:
+            if (elapsed >= BUTTON_DOUBLE_PRESS_MS) {
+                fire(id, GESTURE_PRESS);
+                button.state = STATE_IDLE;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Checks whether a press has to wait because it may become another gesture.
+ */
+bool ButtonController::deferPress(uint8_t id) {
+    const Button& button = buttons[id];
+    return button.gestures[GESTURE_LONG_PRESS] || button.gestures[GESTURE_REPEAT] || button.gestures[GESTURE_DOUBLE_PRESS] || chordCallback;
+}
+
+void ButtonController::fire(uint8_t id, Gesture gesture) {
+    if (buttons[id].gestures[gesture]) {
+        buttons[id].gestures[gesture]();
+    }
+}
+
+/**
+ * @brief Reads the pins again after edges were dropped.
+ */
+void ButtonController::resync(uint32_t now) {
+    for (Button& button : buttons) {
+        bool low = digitalRead(button.pin) == LOW;
+        bool current = button.pending ? button.pendingLow : button.pressed;
+        if (low != current) {
+            button.pending = low != button.pressed;
+            button.pendingLow = low;
+            button.pendingSince = now;
         }
     }
 }
 
 void ButtonController::onButtonBlackPressed(Callback callback) {
-    blackPressedCallback = callback;
+    onGesture(BUTTON_BLACK, GESTURE_PRESS, callback);
 }
 
 void ButtonController::onButtonRedPressed(Callback callback) {
-    redPressedCallback = callback;
+    onGesture(BUTTON_RED, GESTURE_PRESS, callback);
+}
+
+/**
+ * @brief Registers a callback for a gesture of a button.
+ *
+ * @param button The button.
+ * @param gesture The gesture.
+ * @param callback The function to call, nullptr to remove it.
+ */
+void ButtonController::onGesture(ButtonId button, Gesture gesture, Callback callback) {
+    buttons[button].gestures[gesture] = callback;
+}
+
+/**
+ * @brief Registers a callback for pressing both buttons together.
+ */
+void ButtonController::onChord(Callback callback) {
+    chordCallback = callback;
 }
@@ -1,33 +1,113 @@
-#include <Bounce2.h>
+#include <Arduino.h>
 
+#include <atomic>
 #include <functional>
 
+// Flanken, die bis zum nächsten update() gespeichert werden (Zweierpotenz, höchstens 128)
+#ifndef BUTTON_EDGE_QUEUE_SIZE
+#define BUTTON_EDGE_QUEUE_SIZE 32
+#endif
+// Entprellzeit in ms: so lange muss ein Pegel stabil sein
+#ifndef BUTTON_DEBOUNCE_MS
+#define BUTTON_DEBOUNCE_MS 50
+#endif
+// Gesten: ab wann ein Druck lang ist, Abstand der Wiederholungen beim Halten,
+// wie lange nach dem Loslassen auf einen zweiten Druck gewartet wird
+#ifndef BUTTON_LONG_PRESS_MS
+#define BUTTON_LONG_PRESS_MS 800
+#endif
+#ifndef BUTTON_REPEAT_MS
+#define BUTTON_REPEAT_MS 250
+#endif
+#ifndef BUTTON_DOUBLE_PRESS_MS
+#define BUTTON_DOUBLE_PRESS_MS 300
+#endif
+
+/**
+ * Liest die Buttons per Interrupt: jede Flanke wird mit Zeitstempel in
+ * einen Ringpuffer geschrieben und erst in update() entprellt. So geht
+ * kein Tastendruck verloren, auch wenn loop() lange blockiert (Messung,
+ * delay()); die Callbacks kommen dann verspätet, aber in der richtigen
+ * Reihenfolge.
+ *
+ * Aus den entprellten Pegeln erkennt ein Zustandsautomat je Button Gesten:
+ * kurzer, langer und doppelter Druck, Wiederholung beim Halten und beide
+ * Buttons zusammen (Akkord). Ein kurzer Druck wird sofort gemeldet, solange
+ * für den Button weder Doppel-, Lang- noch Akkord-Gesten registriert sind;
+ * sonst erst, wenn feststeht, dass es keine andere Geste wird.
+ */
 class ButtonController {
    public:
     using Callback = std::function<void()>;
 
+    enum ButtonId : uint8_t { BUTTON_BLACK,
+                              BUTTON_RED,
+                              BUTTON_COUNT };
+
+    enum Gesture : uint8_t { GESTURE_PRESS,
+                             GESTURE_LONG_PRESS,
+                             GESTURE_DOUBLE_PRESS,
+                             GESTURE_REPEAT,
+                             GESTURE_COUNT };
+
     ButtonController(int pinBlack, int pinRed);
 
+    void begin();
     void update();
 
     // Event-Handler-Setter
     void onButtonBlackPressed(Callback callback);
     void onButtonRedPressed(Callback callback);
+    void onGesture(ButtonId button, Gesture gesture, Callback callback);
+    void onChord(Callback callback);
 
    private:
-    // Pins und Bounce-Objekte für die Buttons
-    int pinBlack;
-    int pinRed;
+    enum GestureState : uint8_t { STATE_IDLE,
+                                  STATE_DOWN,         // gedrückt, Geste noch offen
+                                  STATE_HELD,         // langer Druck gemeldet, wiederholt
+                                  STATE_WAIT_SECOND,  // losgelassen, wartet auf einen zweiten Druck
+                                  STATE_DONE };       // Geste gemeldet, wartet aufs Loslassen
+
+    struct Edge {
+        uint32_t at;  // millis() der Flanke
+        uint8_t button;
+        bool low;     // Pegel nach der Flanke, LOW = gedrückt
+    };
+
+    struct Button {
+        int pin;
+        bool pressed = false;      // entprellter Zustand
+        bool pending = false;      // Pegelwechsel, der noch nicht lange genug stabil ist
+        bool pendingLow = false;
+        uint32_t pendingSince = 0;
+
+        GestureState state = STATE_IDLE;
+        uint32_t stateSince = 0;  // Zeit des letzten entprellten Pegelwechsels
+        uint32_t nextRepeat = 0;
+        Callback gestures[GESTURE_COUNT];
+    };
+
+    Button buttons[BUTTON_COUNT];
 
-    void resetFlags();
+    // Ringpuffer: nur die Interrupts schreiben (head), nur update() liest (tail)
+    Edge edges[BUTTON_EDGE_QUEUE_SIZE];
+    std::atomic<uint8_t> head{0};
+    std::atomic<uint8_t> tail{0};
+    std::atomic<bool> overflow{false};
 
-    Bounce buttonBlack;
-    Bounce buttonRed;
+    Callback chordCallback;
 
-    // Callback-Funktionen
-    Callback blackPressedCallback;
-    Callback redPressedCallback;
+    static void onBlackEdge(void* arg);
+    static void onRedEdge(void* arg);
+    void pushEdge(uint8_t button);
+    void handleEdge(const Edge& edge);
+    void settle(uint32_t now);
+    void resync(uint32_t now);
+    void handleChange(uint8_t id, uint32_t at);
+    void tick(uint8_t id, uint32_t now);
+    bool deferPress(uint8_t id);
+    void fire(uint8_t id, Gesture gesture);
 
    protected:
     void init();
-};
\ No newline at end of file
+};
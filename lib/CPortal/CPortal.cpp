@@ -3,56 +3,260 @@
 #define ADDR_SSID "wifi_ssid"
 #define ADDR_PASSWORD "wifi_password"
 
-CPortal::CPortal() : server(80) {}
+CPortal::CPortal() : server(80), events("/events"), sensorBody('s'), statusBody('t') {}
 
+/**
+ * @brief Starts the captive portal.
+ *
+ * Starts connecting to the best known network in the background and sets
+ * up the web server. Without stored networks the access point is started
+ * right away, otherwise only after the first failed attempt (see update()).
+ */
 void CPortal::begin() {
     // Serial.println("CPortal::begin");
     WiFi.hostname(HOSTNAME);
     WiFi.mode(WIFI_STA);
     // WiFi.disconnect();
-    currentSSID = store.read(ADDR_SSID, "");
-    currentPassword = store.read(ADDR_PASSWORD, "");
+    gotIpHandler = WiFi.onStationModeGotIP([this](const WiFiEventStationModeGotIP& event) {
+        if (wifiEverConnected) {
+            metrics.wifiReconnects++;
+        }
+        wifiEverConnected = true;
+    });
+    networks.load();
+    migrateCredentials();
 
-    if (currentSSID.isEmpty()) {
-        setupAccessPoint();
-    } else {
-        WiFi.begin(currentSSID.c_str(), currentPassword.c_str());
-        if (WiFi.waitForConnectResult() != WL_CONNECTED) {
-            Serial.println("CaptivePortal::begin --> FAILED TO CONNECT");
-            reset();
-            setupAccessPoint();
-        } else {
-            Serial.println("CaptivePortal::begin --> CONNECTED: " + WiFi.localIP().toString());
+    scans.onComplete([this]() { answerScanWaiters(); });
+    wifi.begin(&networks, &scans);
+    updateAccessPoint();
+
+    setupWebServer();
+}
+
+/**
+ * @brief Updates the captive portal.
+ *
+ * Rebuilds the cached /sensor and /status bodies if a new sensor state was
+ * published since the last call, answers config requests that loop() has
+ * handled, saves changed known networks and drives WiFi, DNS and the SSE
+ * channel.
+ * The sensor values are not passed in; they are read as one consistent copy
+ * from the snapshot, and only when its version changed.
+ */
+void CPortal::update() {
+    if (snapshot && snapshot->version() != sensor.version) {
+        sensor = snapshot->read();
+        buildSensorBody();
+        buildStatusBody();
+        sensorEventPending = true;
+    }
+    answerConfigWaiters();
+    if (networksPending) {
+        networksPending = false;
+        networks.save();
+    }
+    if (connectPending) {
+        connectPending = false;
+        wifi.connectTo(pendingSsid);
+    }
+    scans.update();
+    wifi.update();
+    updateAccessPoint();
+    if (millis() - lastStatusCheck >= STATUS_REFRESH_MS) {
+        refreshStatus();
+    }
+    dnsServer.processNextRequest();  // DNS-Anfragen verarbeiten
+    pushEvents();
+}
+
+/**
+ * @brief Pushes pending changes to all connected SSE clients.
+ *
+ * A sensor event is only sent when a new measurement arrived or a setting
+ * changed since the last event. Every event carries the complete sensor
+ * state, so a client that misses one event is fully up to date with the
+ * next. While the clients are still busy with earlier events, the new event
+ * is held back and coalesced with the following changes instead of piling
+ * up in the send queues. Without changes, a keep-alive is sent every
+ * EVENT_KEEPALIVE_MS so proxies and browsers keep the connection open.
+ */
+void CPortal::pushEvents() {
+    if (events.count() == 0) {
+        sensorEventPending = false;
+        return;
+    }
+
+    unsigned long now = millis();
+    if (sensorEventPending) {
+        if (events.avgPacketsWaiting() >= MAX_EVENT_BACKLOG) {
+            return;  // Langsame Clients: später mit dem aktuellen Stand senden
         }
+        events.send(sensorBody.json(), "sensor", sensorBody.version());
+        sensorEventPending = false;
+        lastEventTime = now;
+    } else if (now - lastEventTime >= EVENT_KEEPALIVE_MS) {
+        events.send("{}", "ping", sensorBody.version());
+        lastEventTime = now;
     }
+}
 
-    setupWebServer();
+/**
+ * @brief Serialises the sensor state into the cached /sensor body.
+ *
+ * Called only when a measurement completed or a setting changed. The
+ * handlers and the SSE channel send this buffer as-is, so no JSON is built
+ * per request. The version of the snapshot is used as SSE event id and ETag.
+ */
+void CPortal::buildSensorBody() {
+    JsonDocument doc;
+    sensorToJson(sensor, doc.to<JsonObject>());
+    sensorBody.build(doc, sensor.version);
 }
 
 /**
- * @brief Updates the captive portal's sensor data.
+ * @brief Checks whether the WiFi state shown in /status changed.
  *
- * This function updates the captive portal's sensor data with the given values.
- * The values are stored in the class's member variables and can be accessed
- * through the corresponding getter functions.
+ * Reads the WiFi state at most every STATUS_REFRESH_MS instead of on every
+ * request and rebuilds the cached /status body only if something visible
+ * changed (connection, IP, SSID, channel, the signal in percent or the
+ * state of the connection attempts).
+ */
+void CPortal::refreshStatus() {
+    lastStatusCheck = millis();
+
+    bool connected = WiFi.status() == WL_CONNECTED;
+    uint32_t ip = connected ? (uint32_t)WiFi.localIP() : 0;
+    int signal = connected ? map(WiFi.RSSI(), -100, -50, 0, 100) : 0;
+    uint8_t channel = connected ? WiFi.channel() : 0;
+
+    if (connected != wifiConnected || ip != wifiIp || signal != wifiSignal || channel != wifiChannel || wifi.version() != wifiVersion) {
+        wifiConnected = connected;
+        wifiIp = ip;
+        wifiSignal = signal;
+        wifiChannel = channel;
+        wifiVersion = wifi.version();
+        buildStatusBody();
+    }
+}
+
+/**
+ * @brief Serialises the cached /status body.
  *
- * @param level The current level of the sensor.
- * @param adcValue The current ADC value of the sensor.
- * @param minAdcValue The minimum ADC value of the sensor.
- * @param maxAdcValue The maximum ADC value of the sensor.
- * @param interval The current measurement interval of the sensor.
- * @param timestamp The current timestamp of the sensor.
- * @param upsideDown Whether the menu is upside down or not.
+ * Uses the WiFi values sampled by refreshStatus(); only the SSID and the
+ * password check are read from the WiFi API, and only if connected.
  */
-void CPortal::update(unsigned int level, unsigned int adcValue, unsigned int minAdcValue, unsigned int maxAdcValue, unsigned int interval, unsigned int timestamp, boolean upsideDown) {
-    sensorLevel = level;
-    sensorAdc = adcValue;
-    sensorAdcMin = minAdcValue;
-    sensorAdcMax = maxAdcValue;
-    measureInterval = interval;
-    measureTimestamp = timestamp;
-	menuUpsideDown = upsideDown;
-    dnsServer.processNextRequest();  // DNS-Anfragen verarbeiten
+void CPortal::buildStatusBody() {
+    PortalStatus status;
+    status.state = wifi.stateName();
+    status.attempts = wifi.attempts;
+    status.failures = wifi.failures;
+    status.lastAttemptMs = wifi.lastAttemptMillis;
+    status.bootToConnectedMs = wifi.bootToConnectedMillis;
+    status.fastConnect = wifi.fastConnected;
+    status.accessPoint = accessPointActive;
+
+    String ssid;
+    if (wifiConnected) {
+        ssid = WiFi.SSID();
+        status.connected = true;
+        status.ip = wifiIp;
+        status.ssid = ssid.c_str();
+        status.signal = wifiSignal;
+        status.channel = wifiChannel;
+        status.secured = !WiFi.psk().isEmpty();
+    }
+
+    JsonDocument doc;
+    statusToJson(status, sensor, doc.to<JsonObject>());
+    statusBody.build(doc, statusBody.version() + 1);
+}
+
+/**
+ * @brief Sends a cached response body.
+ *
+ * The body is tagged with its version as ETag. A client that already has
+ * this version (If-None-Match) gets an empty 304 response. Clients asking
+ * for MessagePack get the binary body, with its own ETag.
+ *
+ * @param request The request object.
+ * @param body The pre-serialised body.
+ */
+void CPortal::sendCached(AsyncWebServerRequest* request, const CachedBody& body) {
+    bool msgPack = acceptsMsgPack(request);
+    char etag[CACHED_BODY_ETAG_SIZE];
+    body.etag(etag, sizeof(etag), msgPack);
+
+    AsyncWebServerResponse* response;
+    if (request->hasHeader("If-None-Match") && CachedBody::matches(request->header("If-None-Match").c_str(), etag)) {
+        response = request->beginResponse(304);
+    } else if (msgPack) {
+        AsyncResponseStream* stream = request->beginResponseStream(MSGPACK_CONTENT_TYPE);
+        stream->write(body.pack(), body.packSize());
+        response = stream;
+    } else {
+        response = request->beginResponse(200, "application/json", body.json());
+    }
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    response->addHeader("Vary", "Accept");
+    request->send(response);
+}
+
+/**
+ * @brief Checks whether the client asks for MessagePack.
+ *
+ * @param request The request object.
+ * @return true if the Accept header contains application/msgpack.
+ */
+bool CPortal::acceptsMsgPack(AsyncWebServerRequest* request) {
+    if (!request->hasHeader("Accept")) {
+        return false;
+    }
+    const String& accept = request->header("Accept");
+    return accept.indexOf(MSGPACK_CONTENT_TYPE) >= 0 || accept.indexOf("application/x-msgpack") >= 0;
+}
+
+/**
+ * @brief Sends a JSON document as JSON or MessagePack.
+ *
+ * The format follows the Accept header; both have the same structure.
+ *
+ * @param request The request object.
+ * @param code The HTTP status code.
+ * @param doc The document to send.
+ */
+void CPortal::sendDocument(AsyncWebServerRequest* request, int code, const JsonDocument& doc) {
+    AsyncWebServerResponse* response;
+    if (acceptsMsgPack(request)) {
+        AsyncResponseStream* stream = request->beginResponseStream(MSGPACK_CONTENT_TYPE);
+        stream->setCode(code);
+        serializeMsgPack(doc, *stream);
+        response = stream;
+    } else {
+        String body;
+        serializeJson(doc, body);
+        response = request->beginResponse(code, "application/json", body);
+    }
+    response->addHeader("Vary", "Accept");
+    request->send(response);
+}
+
+/**
+ * @brief Handle a new SSE client.
+ *
+ * Connections beyond MAX_EVENT_CLIENTS are closed right away, the browser
+ * falls back to polling then. Accepted clients immediately receive the
+ * current sensor state, so they do not have to wait for the next measurement.
+ *
+ * @param client The new event source client.
+ */
+void CPortal::handleEventsConnect(AsyncEventSourceClient* client) {
+    metrics.countRequest(ROUTE_EVENTS);
+    if (events.count() > MAX_EVENT_CLIENTS) {
+        client->close();
+        return;
+    }
+    client->send(sensorBody.json(), "sensor", sensorBody.version(), EVENT_RECONNECT_MS);
 }
 
 /**
@@ -65,8 +269,7 @@ void CPortal::update(unsigned int level, unsigned int adcValue, unsigned int min
  */
 void CPortal::setupAccessPoint() {
     // Serial.println("CPortal::setupAccessPoint");
-    WiFi.disconnect();
-    WiFi.mode(WIFI_AP);
+    WiFi.mode(WIFI_AP_STA);  // Verbindungsversuche laufen weiter
     WiFi.softAPConfig(APIP, APIP, IPAddress(255, 255, 255, 0));
     WiFi.softAP(CP_SSID);
 
@@ -74,6 +277,7 @@ void CPortal::setupAccessPoint() {
     IPAddress apIP = WiFi.softAPIP();
 
     Serial.println("Captive Portal gestartet. IP: " + apIP.toString());
+    accessPointActive = true;
 }
 
 /**
@@ -85,8 +289,26 @@ void CPortal::setupAccessPoint() {
  */
 void CPortal::stopAccessPoint() {
     // Serial.println("CPortal::stopAccessPoint");
+    WiFi.softAPdisconnect(true);
     WiFi.mode(WIFI_STA);
     stopDNS();
+    accessPointActive = false;
+}
+
+/**
+ * @brief Starts or stops the access point depending on the connection.
+ *
+ * The access point runs alongside the station (AP+STA) while there are no
+ * credentials or the connection failed, so the sensor can be set up again
+ * without forgetting the stored network. It is stopped once connected.
+ */
+void CPortal::updateAccessPoint() {
+    WifiState state = wifi.state();
+    if (!accessPointActive && (state == WIFI_NO_CREDENTIALS || state == WIFI_WAITING)) {
+        setupAccessPoint();
+    } else if (accessPointActive && state == WIFI_CONNECTED) {
+        stopAccessPoint();
+    }
 }
 
 /**
@@ -122,29 +344,82 @@ void CPortal::setupWebServer() {
     // Serial.println("CPortal::setupWebServer");
 
     server.on("/", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_ROOT);
         handleRoot(request);
     });
 
     // Andere Routen
-    server.on("/scan", HTTP_GET, [this](AsyncWebServerRequest* request) { handleScan(request); });
-    server.on("/sensor", HTTP_GET, [this](AsyncWebServerRequest* request) { handleSensorLevel(request); });
-    server.on("/status", HTTP_GET, [this](AsyncWebServerRequest* request) { handleStatus(request); });
+    server.on("/scan", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_SCAN);
+        handleScan(request);
+    });
+    server.on("/sensor", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_SENSOR);
+        handleSensorLevel(request);
+    });
+    server.on("/status", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_STATUS);
+        handleStatus(request);
+    });
+    server.on("/history", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_HISTORY);
+        handleHistory(request);
+    });
+
+    // Server-Sent Events: Push neuer Messwerte statt Polling
+    events.onConnect([this](AsyncEventSourceClient* client) { handleEventsConnect(client); });
+    server.addHandler(&events);
 
     server.on("/manifest.json", HTTP_GET, [this](AsyncWebServerRequest* request) { handleManifest(request); });
     server.on("/icon.webp", HTTP_GET, [](AsyncWebServerRequest* request) {
         request->send(LittleFS, "/icon.webp", "image/webp");
     });
 
-    server.on("/interval", HTTP_POST, [](AsyncWebServerRequest* request) {}, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleInterval(request, data, len, index, total); });
-    server.on("/connect", HTTP_POST, [](AsyncWebServerRequest* request) {}, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleConnect(request, data, len, index, total); });
+    server.on("/metrics", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_METRICS);
+        handleMetrics(request);
+    });
+
+    server.on("/config", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_CONFIG);
+        handleConfig(request);
+    });
+    server.on("/config", HTTP_PATCH | HTTP_POST, [](AsyncWebServerRequest* request) { metrics.countRequest(ROUTE_CONFIG); }, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleConfigPatch(request, data, len, index, total); });
+    server.on("/interval", HTTP_POST, [](AsyncWebServerRequest* request) { metrics.countRequest(ROUTE_CONFIG); }, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleInterval(request, data, len, index, total); });
+    server.on("/connect", HTTP_POST, [](AsyncWebServerRequest* request) { metrics.countRequest(ROUTE_CONNECT); }, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleConnect(request, data, len, index, total); });
+
+    server.on("/adc", HTTP_POST, [](AsyncWebServerRequest* request) { metrics.countRequest(ROUTE_CONFIG); }, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleAdc(request, data, len, index, total); });
+    server.on("/calibration", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_CALIBRATION);
+        handleCalibration(request);
+    });
+    server.on("/calibration", HTTP_POST, [](AsyncWebServerRequest* request) { metrics.countRequest(ROUTE_CALIBRATION); }, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleCalibrationStart(request, data, len, index, total); });
+    server.on("/calibration", HTTP_DELETE, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_CALIBRATION);
+        queueCalibration(request, COMMAND_CALIBRATION_CANCEL);
+    });
+    server.on("/ledDirection", HTTP_POST, [](AsyncWebServerRequest* request) { metrics.countRequest(ROUTE_CONFIG); }, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleLedDirection(request, data, len, index, total); });
 
-    server.on("/adc", HTTP_POST, [](AsyncWebServerRequest* request) {}, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleAdc(request, data, len, index, total); });
-    server.on("/ledDirection", HTTP_POST, [](AsyncWebServerRequest* request) {}, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleLedDirection(request, data, len, index, total); });
+    server.on("/disconnect", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_DISCONNECT);
+        handleDisconnect(request);
+    });
 
-    server.on("/disconnect", HTTP_GET, [this](AsyncWebServerRequest* request) { handleDisconnect(request); });
+    server.on("/networks", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_NETWORKS);
+        handleNetworks(request);
+    });
+    server.on("/networks", HTTP_POST, [](AsyncWebServerRequest* request) { metrics.countRequest(ROUTE_NETWORKS); }, NULL, [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { handleNetworkAdd(request, data, len, index, total); });
+    server.on("/networks", HTTP_DELETE, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_NETWORKS);
+        handleNetworkRemove(request);
+    });
 
     // Allways redirect to captive portal. Request comes with IP (8.8.8.8) or URL (connectivitycheck.XXX / captive.apple / etc.)
-    server.on("/hotspot-detect.html", HTTP_GET, [this](AsyncWebServerRequest* request) { handleRoot(request); });
+    server.on("/hotspot-detect.html", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        metrics.countRequest(ROUTE_CAPTIVE);
+        handleRoot(request);
+    });
     server.on("/success.txt", [this](AsyncWebServerRequest* request) { handleSuccess(request); });     // detectportal.firefox.com/sucess.txt
                                                                                                        // redirects
     server.on("/generate_204", [this](AsyncWebServerRequest* request) { redirect(request); });         // Android captive portal.
@@ -164,6 +439,7 @@ void CPortal::setupWebServer() {
  * @param request The request object.
  */
 void CPortal::redirect(AsyncWebServerRequest* request) {
+    metrics.countRequest(ROUTE_CAPTIVE);
     // Serial.println("CaptivePortal::redirect");
     request->redirect(String("http://") + toStringIp(WiFi.localIP()));
     // request->addHeader("Location", String("http://") + toStringIp(WiFi.localIP()), true);
@@ -180,6 +456,7 @@ void CPortal::redirect(AsyncWebServerRequest* request) {
  * @param request The request object.
  */
 void CPortal::handleSuccess(AsyncWebServerRequest* request) {
+    metrics.countRequest(ROUTE_CAPTIVE);
     // Serial.println("CaptivePortal::handleSuccess");
     // Serial.println(F("Handle success.txt"));
     request->send(200, "text/plain", "success");
@@ -220,31 +497,75 @@ void CPortal::handleRoot(AsyncWebServerRequest* request) {
 /**
  * @brief Handle scan request.
  *
- * This function processes an HTTP GET request to scan for available
- * WiFi networks. It uses WiFi.scanNetworksAsync() to scan for networks
- * and sends a JSON response containing the SSID, signal strength, channel,
- * and encryption type of each network.
+ * This function processes an HTTP GET request for the available WiFi
+ * networks. A scan younger than SCAN_TTL_MS is answered right away. Otherwise
+ * the request waits for the next scan, which is started unless one is
+ * running already, so all requests share one scan. The response contains the
+ * SSID, signal strength, channel, and encryption type of each network.
  *
  * @param request The request object.
  */
 void CPortal::handleScan(AsyncWebServerRequest* request) {
     // Serial.println("CaptivePortal::handleScan");
-    WiFi.scanNetworksAsync([request](int networks) {
-        String response;
-        JsonDocument doc;
-        JsonArray networksArray = doc.to<JsonArray>();
-
-        for (int i = 0; i < networks; i++) {
-            JsonObject net = networksArray.add<JsonObject>();
-            net["ssid"] = WiFi.SSID(i);
-            net["signal"] = map(WiFi.RSSI(i), -100, -50, 0, 100);
-            net["channel"] = WiFi.channel(i);
-            net["secured"] = (WiFi.encryptionType(i) != AUTH_OPEN);
+    if (scans.fresh(SCAN_TTL_MS)) {
+        sendScan(request);
+        return;
+    }
+    size_t slot = 0;
+    while (slot < MAX_SCAN_WAITERS && scanWaiters[slot]) {
+        slot++;
+    }
+    if (slot == MAX_SCAN_WAITERS || !scans.start()) {
+        request->send(503, "application/json", "{\"error\":\"Scan busy\"}");
+        return;
+    }
+    scanWaiters[slot] = request;
+    // Bricht der Client ab, wird die Anfrage gelöscht und darf nicht mehr beantwortet werden
+    request->onDisconnect([this, request]() { forgetScanWaiter(request); });
+}
+
+/**
+ * @brief Answers all requests waiting for the scan that just finished.
+ */
+void CPortal::answerScanWaiters() {
+    for (size_t i = 0; i < MAX_SCAN_WAITERS; i++) {
+        AsyncWebServerRequest* request = scanWaiters[i];
+        if (!request) {
+            continue;
         }
-        serializeJson(doc, response);
-        request->send(200, "application/json", response);
-        WiFi.scanDelete();  // Speicher freigeben
-    });
+        scanWaiters[i] = nullptr;
+        if (scans.failed()) {
+            request->send(503, "application/json", "{\"error\":\"Scan failed\"}");
+        } else {
+            sendScan(request);
+        }
+    }
+}
+
+/**
+ * @brief Sends the results of the last scan.
+ *
+ * JSON is sent from the buffer of the scan service; MessagePack is
+ * serialised per request, which is rare.
+ */
+void CPortal::sendScan(AsyncWebServerRequest* request) {
+    if (!acceptsMsgPack(request)) {
+        AsyncWebServerResponse* response = request->beginResponse(200, "application/json", scans.json());
+        response->addHeader("Vary", "Accept");
+        request->send(response);
+        return;
+    }
+    JsonDocument doc;
+    scans.toJson(doc.to<JsonArray>());
+    sendDocument(request, 200, doc);
+}
+
+void CPortal::forgetScanWaiter(AsyncWebServerRequest* request) {
+    for (size_t i = 0; i < MAX_SCAN_WAITERS; i++) {
+        if (scanWaiters[i] == request) {
+            scanWaiters[i] = nullptr;
+        }
+    }
 }
 
 /**
@@ -253,8 +574,9 @@ void CPortal::handleScan(AsyncWebServerRequest* request) {
  * This function processes an HTTP POST request to connect to a WiFi network.
  * It deserializes the incoming JSON data to extract the SSID and password.
  * If the JSON is invalid or the SSID is missing, it sends a 400 error response.
- * Otherwise, it saves the SSID and password, sends a 200 success response,
- * and restarts the ESP to apply the changes.
+ * Otherwise, the network is added to the known networks (or its password is
+ * updated) and the sensor connects to it in the background; the other known
+ * networks are kept.
  *
  * @param request The HTTP request object.
  * @param data The incoming data buffer containing the JSON payload.
@@ -266,7 +588,7 @@ void CPortal::handleConnect(AsyncWebServerRequest* request, uint8_t* data, size_
     // Serial.println("CaptivePortal::handleConnect");
 
     JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, data);
+    DeserializationError error = deserializeJson(doc, data, len);
 
     if (error) {
         request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
@@ -274,60 +596,71 @@ void CPortal::handleConnect(AsyncWebServerRequest* request, uint8_t* data, size_
     }
 
     String ssid = doc["ssid"] | "";
-    String password = doc["password"] | "";
 
-    // Überprüfen, ob SSID vorhanden ist
-    if (ssid.isEmpty()) {
+    // Überprüfen, ob SSID vorhanden ist, höchstens 32 Zeichen
+    if (ssid.isEmpty() || ssid.length() > 32) {
         request->send(400, "application/json", "{\"error\":\"Missing SSID\"}");
         return;
     }
 
-    request->send(200, "application/json", "{\"restart\":true}");
+    // Ohne Passwort bleibt das eines bekannten Netzwerks erhalten
+    const WifiNetwork* known = networks.find(ssid);
+    String password = doc["password"] | (known ? known->password : String());
+    uint8_t priority = doc["priority"] | (known ? known->priority : 0);
 
-    store.save(ADDR_SSID, ssid);
-    store.save(ADDR_PASSWORD, password);
+    if (networks.add(ssid, password, priority)) {
+        networksPending = true;
+    }
+    pendingSsid = ssid;
+    connectPending = true;
 
-    ESP.restart();
+    JsonDocument response;
+    response["added"] = true;
+    response["connected"] = false;
+    response["ssid"] = ssid;
+    String body;
+    serializeJson(response, body);
+    request->send(200, "application/json", body);
 }
 
 /**
- * @brief Try to connect to the given network.
+ * @brief Handle WiFi disconnect request.
  *
- * @param ssid The network's SSID.
- * @param password The network's password.
+ * Removes the current network from the known networks. If other known
+ * networks are left, the sensor connects to the best of them, otherwise the
+ * access point is started.
  *
- * @return true if the connection was successful, false otherwise.
+ * @param request The HTTP request object.
  */
-bool CPortal::tryConnect(const String& ssid, const String& password) {
-    // Serial.println("CaptivePortal::tryConnect");
-
-    // stopAccessPoint();
-    WiFi.begin(ssid.c_str(), password.c_str());
-    if (WiFi.waitForConnectResult() != WL_CONNECTED) {
-        Serial.println("CaptivePortal::begin --> FAILED TO CONNECT");
-        return false;
-    } else {
-        Serial.println("CaptivePortal::begin --> CONNECTED");
-        return true;
-    }
-}
-
 void CPortal::handleDisconnect(AsyncWebServerRequest* request) {
     // Serial.println("CaptivePortal::handleDisconnect");
     request->send(200, "application/json", "{\"connected\":false,\"restart\":true}");
-    delay(2500);
-    WiFi.disconnect(true);
-    reset();
-    setupAccessPoint();
+    if (networks.remove(wifi.currentSsid())) {
+        networksPending = true;
+    }
+    pendingSsid = "";
+    connectPending = true;
 }
 
 /**
- * @brief Handle changed measurement interval.
+ * @brief Handle request for the known networks.
  *
- * This function is called when the measurement interval is changed
- * via the captive portal. It deserializes the incoming JSON data to
- * extract the new interval, sends a 200 success response and invokes
- * the callback to change the interval.
+ * Sends the known networks in the order they are tried, without passwords.
+ *
+ * @param request The HTTP request object.
+ */
+void CPortal::handleNetworks(AsyncWebServerRequest* request) {
+    JsonDocument doc;
+    networks.toJson(doc.to<JsonArray>(), wifi.state() == WIFI_CONNECTED ? wifi.currentSsid() : String());
+    sendDocument(request, 200, doc);
+}
+
+/**
+ * @brief Handle request to add or update a known network.
+ *
+ * Expects {"ssid": ..., "password": ..., "priority": ...}. Unlike /connect
+ * the current connection is kept; the network is used when the sensor
+ * connects the next time.
  *
  * @param request The HTTP request object.
  * @param data The incoming data buffer containing the JSON payload.
@@ -335,33 +668,247 @@ void CPortal::handleDisconnect(AsyncWebServerRequest* request) {
  * @param index The current index of the data being processed.
  * @param total The total size of the data being processed.
  */
-void CPortal::handleInterval(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+void CPortal::handleNetworkAdd(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
     JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, data);
+    if (deserializeJson(doc, data, len)) {
+        sendError(request, "Invalid JSON");
+        return;
+    }
+    String ssid = doc["ssid"] | "";
+    if (ssid.isEmpty() || ssid.length() > 32) {
+        sendError(request, "Missing SSID");
+        return;
+    }
+    const WifiNetwork* known = networks.find(ssid);
+    String password = doc["password"] | (known ? known->password : String());
+    uint8_t priority = doc["priority"] | (known ? known->priority : 0);
+    if (networks.add(ssid, password, priority)) {
+        networksPending = true;
+    }
+    if (wifi.state() == WIFI_NO_CREDENTIALS) {
+        pendingSsid = ssid;
+        connectPending = true;
+    }
+    handleNetworks(request);
+}
 
-    if (error) {
+/**
+ * @brief Handle request to remove a known network.
+ *
+ * Expects the SSID as query parameter, e.g. DELETE /networks?ssid=Yard.
+ * Removing the current network does not disconnect the sensor.
+ *
+ * @param request The HTTP request object.
+ */
+void CPortal::handleNetworkRemove(AsyncWebServerRequest* request) {
+    if (!request->hasParam("ssid")) {
+        sendError(request, "Missing SSID");
+        return;
+    }
+    if (!networks.remove(request->getParam("ssid")->value())) {
+        request->send(404, "application/json", "{\"error\":\"Unknown SSID\"}");
+        return;
+    }
+    networksPending = true;
+    handleNetworks(request);
+}
+
+/**
+ * @brief Moves the single network of older firmware into the list.
+ */
+void CPortal::migrateCredentials() {
+    String ssid = store.read(ADDR_SSID, "");
+    if (ssid.isEmpty()) {
+        return;
+    }
+    networks.add(ssid, store.read(ADDR_PASSWORD, ""), 0);
+    if (networks.save()) {
+        store.clear(ADDR_SSID);
+        store.clear(ADDR_PASSWORD);
+    }
+}
+
+/**
+ * @brief Handle config request.
+ *
+ * Sends all settings together with their version.
+ *
+ * @param request The HTTP request object.
+ */
+void CPortal::handleConfig(AsyncWebServerRequest* request) {
+    JsonDocument doc;
+    ConfigStore::toJson(config, doc.to<JsonObject>());
+    sendDocument(request, 200, doc);
+}
+
+/**
+ * @brief Handle config change request.
+ *
+ * This function processes an HTTP PATCH (or POST) request with any subset of
+ * the settings. All values are validated together; if one is invalid, nothing
+ * is changed and a 400 error response is sent. Otherwise the change is
+ * queued for loop(), which applies and saves all changes at once, and the
+ * response contains the settings with the change applied.
+ *
+ * @param request The HTTP request object.
+ * @param data The incoming data buffer containing the JSON payload.
+ * @param len The length of the data buffer.
+ * @param index The current index of the data being processed.
+ * @param total The total size of the data being processed.
+ */
+void CPortal::handleConfigPatch(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+    JsonDocument doc;
+    if (index != 0 || len != total || deserializeJson(doc, data, len) || !doc.is<JsonObject>()) {
         request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
         return;
     }
 
-    request->send(200, "application/json", "{\"success\":true}");
+    applyConfig(request, doc.as<JsonObjectConst>());
+}
+
+/**
+ * @brief Validates a config change and queues it for loop().
+ *
+ * Used by /config and by the old single-setting routes. Saving to the flash
+ * and switching the step-up or the LEDs happens in loop(), not in the
+ * network callback. loop() validates each change again before it is
+ * applied, so the request waits for that result and is answered from
+ * update() (see answerConfigWaiters()).
+ *
+ * @param request The HTTP request object.
+ * @param json The changed settings, in the format of /config.
+ */
+void CPortal::applyConfig(AsyncWebServerRequest* request, JsonObjectConst json) {
+    Command command;
+    String error;
+    if (!command.patch.fromJson(json, error) || !command.patch.validate(config, error)) {
+        sendError(request, error);
+        return;
+    }
+    size_t slot = 0;
+    while (slot < MAX_CONFIG_WAITERS && configWaiters[slot].request) {
+        slot++;
+    }
+    command.type = COMMAND_CONFIG;
+    command.source = SOURCE_PORTAL;
+    // 0 heißt "niemand wartet"
+    lastCommandId = lastCommandId == UINT16_MAX ? 1 : lastCommandId + 1;
+    command.id = lastCommandId;
+    if (slot == MAX_CONFIG_WAITERS || !commands.push(command)) {
+        request->send(503, "application/json", "{\"error\":\"Busy\"}");
+        return;
+    }
+    ConfigWaiter& waiter = configWaiters[slot];
+    waiter.request = request;
+    waiter.id = command.id;
+    waiter.done = false;
+    waiter.error = "";
+    // Bricht der Client ab, wird die Anfrage gelöscht und darf nicht mehr beantwortet werden
+    request->onDisconnect([this, request]() { forgetConfigWaiter(request); });
+}
+
+/**
+ * @brief Takes the result of a queued config change from loop().
+ *
+ * Called by loop() for every config change it took from the queue, after a
+ * valid change was saved and passed on with setConfig(). The waiting
+ * request is answered by the next update().
+ *
+ * @param id The number of the command, 0 if no request waits for it.
+ * @param error Why the change was dropped, empty if it was saved.
+ */
+void CPortal::finishCommand(uint16_t id, const String& error) {
+    if (id == 0) {
+        return;
+    }
+    for (size_t i = 0; i < MAX_CONFIG_WAITERS; i++) {
+        ConfigWaiter& waiter = configWaiters[i];
+        if (waiter.request && waiter.id == id) {
+            waiter.done = true;
+            waiter.error = error;
+        }
+    }
+}
+
+/**
+ * @brief Answers the config requests whose change loop() has handled.
+ *
+ * A saved change is answered with 200 and the settings including their new
+ * version; a change dropped because an earlier one made it invalid is
+ * answered with 409 and the reason.
+ */
+void CPortal::answerConfigWaiters() {
+    for (size_t i = 0; i < MAX_CONFIG_WAITERS; i++) {
+        ConfigWaiter& waiter = configWaiters[i];
+        if (!waiter.request || !waiter.done) {
+            continue;
+        }
+        AsyncWebServerRequest* request = waiter.request;
+        waiter.request = nullptr;
+        if (waiter.error.length() > 0) {
+            sendError(request, waiter.error, 409);
+            continue;
+        }
+        JsonDocument doc;
+        ConfigStore::toJson(config, doc.to<JsonObject>());
+        sendDocument(request, 200, doc);
+    }
+}
+
+void CPortal::forgetConfigWaiter(AsyncWebServerRequest* request) {
+    for (size_t i = 0; i < MAX_CONFIG_WAITERS; i++) {
+        if (configWaiters[i].request == request) {
+            configWaiters[i].request = nullptr;
+        }
+    }
+}
+
+/**
+ * @brief Sends an error response with a message, 400 by default.
+ *
+ * @param request The HTTP request object.
+ * @param message The error message.
+ * @param code The HTTP status code.
+ */
+void CPortal::sendError(AsyncWebServerRequest* request, const String& message, int code) {
+    JsonDocument doc;
+    doc["error"] = message;
 
-    String temp = doc["interval"];
-    unsigned int interval = temp.toInt();
+    String response;
+    serializeJson(doc, response);
+    request->send(code, "application/json", response);
+}
 
-    if (onIntervalChangedCallback) {
-        onIntervalChangedCallback(interval);
+/**
+ * @brief Handle changed measurement interval.
+ *
+ * Old route, kept for compatibility. Takes {"interval": n} and applies it
+ * like a /config request.
+ *
+ * @param request The HTTP request object.
+ * @param data The incoming data buffer containing the JSON payload.
+ * @param len The length of the data buffer.
+ * @param index The current index of the data being processed.
+ * @param total The total size of the data being processed.
+ */
+void CPortal::handleInterval(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+    JsonDocument doc;
+    if (deserializeJson(doc, data, len)) {
+        request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        return;
     }
+
+    JsonDocument patchDoc;
+    patchDoc["interval"] = doc["interval"];
+    applyConfig(request, patchDoc.as<JsonObjectConst>());
 }
 
 /**
  * @brief Handle ADC value change request.
  *
- * This function processes an HTTP POST request to change the ADC values for
- * min or max. It deserializes the incoming JSON data to extract the new ADC
- * value. If the JSON is invalid, it sends a 400 error response. Otherwise, it
- * sends a 200 success response and invokes the callback to change the ADC
- * values.
+ * Old route, kept for compatibility. Takes {"change": "min"|"max", "value": n}
+ * and applies it like a /config request. Without a value, the limit is
+ * measured like with POST /calibration.
  *
  * @param request The HTTP request object.
  * @param data The incoming data buffer containing the JSON payload.
@@ -371,27 +918,99 @@ void CPortal::handleInterval(AsyncWebServerRequest* request, uint8_t* data, size
  */
 void CPortal::handleAdc(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
     JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, data);
-
-    if (error) {
+    if (deserializeJson(doc, data, len)) {
         request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
         return;
     }
 
-    request->send(200, "application/json", "{\"success\":true}");
+    String change = doc["change"] | "";
+    if (change != "min" && change != "max") {
+        sendError(request, "change must be min or max");
+        return;
+    }
+    if (doc["value"].isNull()) {
+        queueCalibration(request, COMMAND_CALIBRATE, change == "min" ? CALIBRATION_MIN : CALIBRATION_MAX);
+        return;
+    }
+    JsonDocument patchDoc;
+    patchDoc[change == "min" ? "adcMin" : "adcMax"] = doc["value"];
+    applyConfig(request, patchDoc.as<JsonObjectConst>());
+}
+
+/**
+ * @brief Handle calibration status request.
+ *
+ * Returns the running or the last calibration since the start: target,
+ * state, progress and, once the window is full, mean, standard deviation
+ * and confidence.
+ *
+ * @param request The request object.
+ */
+void CPortal::handleCalibration(AsyncWebServerRequest* request) {
+    JsonDocument doc;
+    CalibrationStatus status = snapshot ? snapshot->read().calibration : CalibrationStatus();
+    status.toJson(doc.to<JsonObject>());
+    sendDocument(request, 200, doc);
+}
+
+/**
+ * @brief Handle calibration start request.
+ *
+ * Takes {"target": "min"|"max"}. The calibration runs in loop() for a few
+ * seconds; its progress is reported by GET /calibration and /sensor.
+ *
+ * @param request The HTTP request object.
+ * @param data The incoming data buffer containing the JSON payload.
+ * @param len The length of the data buffer.
+ * @param index The current index of the data being processed.
+ * @param total The total size of the data being processed.
+ */
+void CPortal::handleCalibrationStart(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+    JsonDocument doc;
+    if (index != 0 || len != total || deserializeJson(doc, data, len)) {
+        request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        return;
+    }
+    CalibrationTarget target;
+    if (!CalibrationStatus::parseTarget(doc["target"] | "", target)) {
+        sendError(request, "target must be min or max");
+        return;
+    }
+    queueCalibration(request, COMMAND_CALIBRATE, target);
+}
 
-    if (onIntervalAdcChangedCallback && doc["change"] != "" && doc["value"] != "") {
-        onIntervalAdcChangedCallback(doc["change"], doc["value"]);
+/**
+ * @brief Queues the start or cancellation of a calibration for loop().
+ *
+ * Answers with 202 and the current calibration status; a started
+ * calibration gets the next session number. A start while another
+ * calibration runs is ignored by loop().
+ *
+ * @param request The HTTP request object.
+ * @param type COMMAND_CALIBRATE or COMMAND_CALIBRATION_CANCEL.
+ * @param target The limit to calibrate.
+ */
+void CPortal::queueCalibration(AsyncWebServerRequest* request, CommandType type, CalibrationTarget target) {
+    Command command;
+    command.type = type;
+    command.source = SOURCE_PORTAL;
+    command.target = target;
+    if (!commands.push(command)) {
+        request->send(503, "application/json", "{\"error\":\"Busy\"}");
+        return;
     }
+    JsonDocument doc;
+    CalibrationStatus status = snapshot ? snapshot->read().calibration : CalibrationStatus();
+    status.toJson(doc.to<JsonObject>());
+    doc["queued"] = true;
+    sendDocument(request, 202, doc);
 }
 
 /**
  * @brief Handle LED direction change request.
  *
- * This function processes an HTTP POST request to change the LED direction.
- * It deserializes the incoming JSON data to extract the new LED direction state.
- * If the JSON is invalid, it sends a 400 error response. Otherwise, it sends a
- * 200 success response and invokes the callback to change the LED direction.
+ * Old route, kept for compatibility. Takes {"status": true|false} and applies
+ * it like a /config request.
  *
  * @param request The HTTP request object.
  * @param data The incoming data buffer containing the JSON payload.
@@ -400,52 +1019,28 @@ void CPortal::handleAdc(AsyncWebServerRequest* request, uint8_t* data, size_t le
  * @param total The total size of the data being processed.
  */
 void CPortal::handleLedDirection(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
-	JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, data);
-	
-    if (error) {
-		request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+    JsonDocument doc;
+    if (deserializeJson(doc, data, len)) {
+        request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
         return;
     }
-	
-    request->send(200, "application/json", "{\"success\":true}");
-	
-	Serial.println("CPortal::handleLedDirection : " + String(doc["status"]));
-    if (onLedDirectionChangedCallback && doc["status"] != "") {
-        onLedDirectionChangedCallback(doc["status"]);
-    }
+
+    JsonDocument patchDoc;
+    patchDoc["upsideDown"] = doc["status"];
+    applyConfig(request, patchDoc.as<JsonObjectConst>());
 }
 
 /**
  * @brief Handle status request.
  *
- * This function generates and sends a status JSON response for the captive portal.
- * It includes the current connection status, timestamp, interval, menu orientation,
- * and network information (IP, SSID, signal strength, channel, and if secured).
- * The response is sent in JSON format with the necessary properties.
+ * This function sends the status JSON of the captive portal. It includes the
+ * current connection status, timestamp, interval, menu orientation, and network
+ * information (IP, SSID, signal strength, channel, and if secured). The body is
+ * kept pre-serialised and is only rebuilt when one of these values changes.
  */
 void CPortal::handleStatus(AsyncWebServerRequest* request) {
     // Serial.println("CaptivePortal::handleStatus");
-    JsonDocument doc;
-
-    if (WiFi.status() == WL_CONNECTED) {
-        doc["connected"] = true;
-        doc["timestamp"] = measureTimestamp;
-        doc["interval"] = measureInterval;
-        doc["menuUpsideDown"] = menuUpsideDown;
-        JsonObject wifi = doc["wifi"].to<JsonObject>();
-        wifi["ip"] = WiFi.localIP().toString();
-        wifi["ssid"] = WiFi.SSID();
-        wifi["signal"] = map(WiFi.RSSI(), -100, -50, 0, 100);
-        wifi["channel"] = WiFi.channel();
-        wifi["secured"] = !WiFi.psk().isEmpty();
-    } else {
-        doc["connected"] = false;
-    }
-
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    sendCached(request, statusBody);
 }
 
 /**
@@ -483,24 +1078,89 @@ void CPortal::handleManifest(AsyncWebServerRequest* request) {
  * This function is called when the sensor level is requested from the captive
  * portal. It returns the sensor level, the ADC value, the minimum and maximum
  * ADC values, the timestamp of the measurement and the interval of the
- * measurement.
+ * measurement. The body is served from the buffer built in buildSensorBody().
  *
  * @param request The request object.
  */
 void CPortal::handleSensorLevel(AsyncWebServerRequest* request) {
     // Serial.println("CaptivePortal::handleSensorLevel");
-    JsonDocument doc;
-    doc["value"] = String(sensorLevel);
-    doc["adcValue"] = String(sensorAdc);
-    doc["adcMin"] = String(sensorAdcMin);
-    doc["adcMax"] = String(sensorAdcMax);
-    doc["timestamp"] = String(measureTimestamp);
-    doc["interval"] = String(measureInterval);
+    sendCached(request, sensorBody);
+}
 
-    String response;
-    serializeJson(doc, response);
+/**
+ * @brief Handle history request.
+ *
+ * Streams the stored measurements of a time range as chunked response.
+ * Query parameters:
+ * - from, to: time range in seconds (timestamps of the history), optional
+ * - step: minimum distance between two returned measurements in seconds, optional
+ * - points: reduce the range to this number of points (LTTB downsampling), optional
+ * - format: csv (default), json, msgpack or bin (see HistoryRecord for the layout);
+ *   without format, a client that accepts MessagePack gets msgpack
+ *
+ * Only one block of measurements is read at a time, and the next block is
+ * only read when the connection can take more data. The number of parallel
+ * downloads is limited; further requests get a 503 response.
+ *
+ * @param request The request object.
+ */
+void CPortal::handleHistory(AsyncWebServerRequest* request) {
+    if (!history) {
+        request->send(404, "application/json", "{\"error\":\"No history\"}");
+        return;
+    }
+    if (!HistoryStream::available()) {
+        request->send(503, "application/json", "{\"error\":\"Busy\"}");
+        return;
+    }
 
-    request->send(200, "application/json", response);
+    uint32_t from = request->hasParam("from") ? strtoul(request->getParam("from")->value().c_str(), nullptr, 10) : 0;
+    uint32_t to = request->hasParam("to") ? strtoul(request->getParam("to")->value().c_str(), nullptr, 10) : UINT32_MAX;
+    uint32_t step = request->hasParam("step") ? strtoul(request->getParam("step")->value().c_str(), nullptr, 10) : 0;
+    uint32_t points = request->hasParam("points") ? strtoul(request->getParam("points")->value().c_str(), nullptr, 10) : 0;
+    String format = request->hasParam("format") ? request->getParam("format")->value() : (acceptsMsgPack(request) ? "msgpack" : "csv");
+
+    HistoryFormat historyFormat = HISTORY_CSV;
+    const char* contentType = "text/csv";
+    if (format == "json") {
+        historyFormat = HISTORY_JSON;
+        contentType = "application/json";
+    } else if (format == "msgpack") {
+        historyFormat = HISTORY_MSGPACK;
+        contentType = MSGPACK_CONTENT_TYPE;
+    } else if (format == "bin") {
+        historyFormat = HISTORY_BIN;
+        contentType = "application/octet-stream";
+    } else if (format != "csv") {
+        request->send(400, "application/json", "{\"error\":\"Invalid format\"}");
+        return;
+    }
+
+    std::shared_ptr<HistoryStream> stream = std::make_shared<HistoryStream>(*history, from, to, step, points, historyFormat);
+    AsyncWebServerResponse* response = request->beginChunkedResponse(contentType, [stream](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+        size_t written = stream->fill(buffer, maxLen);
+        // 0 beendet die Antwort; mitten in einem LTTB-Bucket später weiterlesen
+        return written == 0 && !stream->finished() ? RESPONSE_TRY_AGAIN : written;
+    });
+    response->addHeader("Vary", "Accept");
+    request->send(response);
+}
+
+/**
+ * @brief Handle metrics request.
+ *
+ * Sends the runtime metrics of the sensor in the Prometheus text format.
+ * The text is created line by line while the response is sent, so no
+ * complete copy of it is held in RAM.
+ *
+ * @param request The request object.
+ */
+void CPortal::handleMetrics(AsyncWebServerRequest* request) {
+    std::shared_ptr<MetricsStream> stream = std::make_shared<MetricsStream>();
+    AsyncWebServerResponse* response = request->beginChunkedResponse("text/plain; version=0.0.4", [stream](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+        return stream->fill(buffer, maxLen);
+    });
+    request->send(response);
 }
 
 /**
@@ -522,51 +1182,63 @@ String CPortal::toStringIp(IPAddress ip) {
 /**
  * @brief Resets the Captive Portal to its default state.
  *
- * This function clears the stored SSID and password, and disconnects
- * the ESP from any currently connected network. The Captive Portal
- * is then restarted. This function is called when the user requests
- * a factory reset.
+ * This function clears all known networks. The Captive Portal is then
+ * restarted. This function is called when the user requests a factory
+ * reset.
  */
 void CPortal::reset() {
     store.clear(ADDR_SSID);
     store.clear(ADDR_PASSWORD);
+    networks.clear();
+    networks.save();
 }
 
 /**
- * @brief Registers a callback for changed measurement intervals.
+ * @brief Sets the current settings shown by /config.
  *
- * This function sets a user-defined callback to be invoked when the
- * measurement interval is changed via the captive portal. The callback
- * is provided with a single parameter:
- * - An unsigned integer containing the new measurement interval in seconds.
+ * @param value The saved settings.
  */
-void CPortal::onIntervalChanged(std::function<void(unsigned int)> callback) {
-    onIntervalChangedCallback = callback;
+void CPortal::setConfig(const SensorConfig& value) {
+    config = value;
 }
 
 /**
- * @brief Registers a callback for changed ADC values.
+ * @brief Sets the history store used by the /history endpoint.
  *
- * This function sets a user-defined callback to be invoked when the
- * ADC value is changed via the captive portal. The callback is
- * provided with two parameters:
- * - A string indicating if the minimum or maximum ADC value was changed.
- * - An unsigned integer containing the new ADC value.
+ * @param historyStore The history store, or nullptr to disable the endpoint.
  */
-void CPortal::onAdcChanged(std::function<void(String, unsigned int)> callback) {
-    onIntervalAdcChangedCallback = callback;
+void CPortal::setHistory(HistoryStore* historyStore) {
+    history = historyStore;
 }
 
 /**
- * @brief Registers a callback for LED direction changes.
+ * @brief Sets the sensor state shown by /sensor, /status and the SSE channel.
  *
- * This function sets a user-defined callback to be invoked when the
- * LED direction is changed via the captive portal.
+ * @param sensorSnapshot The snapshot published by the main loop.
+ */
+void CPortal::setSensorSnapshot(SensorSnapshot* sensorSnapshot) {
+    snapshot = sensorSnapshot;
+}
+
+/**
+ * @brief Sets the data of the last WiFi connection for a fast reconnect.
  *
- * @param callback A function that takes a boolean parameter indicating
- * the new LED direction state.
+ * Call this before begin().
+ *
+ * @param cache The cached connection data.
  */
+void CPortal::setWifiCache(const WifiCache& cache) {
+    wifi.setCache(cache);
+}
 
-void CPortal::onLedDirectionChanged(std::function<void(boolean)> callback) {
-    onLedDirectionChangedCallback = callback;
-}
\ No newline at end of file
+/**
+ * @brief Registers a callback for changed WiFi connection data.
+ *
+ * The callback is called after a connection if BSSID, channel or the IP
+ * configuration differ from the cache, and should save the data.
+ *
+ * @param callback A function that takes the connection data.
+ */
+void CPortal::onWifiCacheChanged(std::function<void(const WifiCache&)> callback) {
+    wifi.onCacheChanged(callback);
+}
@@ -4,21 +4,34 @@
 #include <ArduinoJson.h>
 #include <DNSServer.h>
 #include <ESP8266WiFi.h>
-#include <ESP8266WiFiMulti.h>
 #include <ESPAsyncWebServer.h>
 #include <pgmspace.h>
 
+#include "CachedBody.h"
+#include "CommandQueue.h"
+#include "ConfigStore.h"
+#include "HistoryStore.h"
 #include "LittleFSManager.h"
+#include "Metrics.h"
+#include "NetworkList.h"
+#include "ScanService.h"
+#include "SensorSnapshot.h"
+#include "WifiConnection.h"
+
+#define MSGPACK_CONTENT_TYPE "application/msgpack"
 
 class CPortal {
    public:
     CPortal();
     void begin();
-    void update(unsigned int level, unsigned int adcValue, unsigned int minAdcValue, unsigned int maxAdcValue, unsigned int interval, unsigned int timestamp, boolean menuDirection);
+    void update();
     void reset();
-    void onIntervalChanged(std::function<void(unsigned int)> callback);
-    void onAdcChanged(std::function<void(String, unsigned int)> callback);
-    void onLedDirectionChanged(std::function<void(boolean)> callback);
+    void setConfig(const SensorConfig& value);
+    void setHistory(HistoryStore* historyStore);
+    void setSensorSnapshot(SensorSnapshot* sensorSnapshot);
+    void setWifiCache(const WifiCache& cache);
+    void onWifiCacheChanged(std::function<void(const WifiCache&)> callback);
+    void finishCommand(uint16_t id, const String& error);
 
    private:
     String CP_SSID = "Sensor";
@@ -26,50 +39,109 @@ class CPortal {
     String HOSTNAME = "sensor";
     int DNS_PORT = 53;
 
+    static const size_t MAX_EVENT_CLIENTS = 4;              // gleichzeitige SSE-Verbindungen
+    static const size_t MAX_EVENT_BACKLOG = 4;              // max. wartende Nachrichten je Client
+    static const unsigned long EVENT_KEEPALIVE_MS = 15000;  // Keep-Alive, falls sich nichts ändert
+    static const unsigned long EVENT_RECONNECT_MS = 3000;   // Reconnect-Zeit für den Browser
+    static const unsigned long STATUS_REFRESH_MS = 2000;    // Abfrage des WLAN-Status für /status
+    static const size_t MAX_SCAN_WAITERS = 4;               // auf einen Scan wartende /scan-Anfragen
+    static const size_t MAX_CONFIG_WAITERS = 4;             // auf loop() wartende /config-Anfragen
+
     void setupAccessPoint();
     void stopAccessPoint();
+    void updateAccessPoint();
     void setupWebServer();
     void setupDNS();
     void stopDNS();
 
-    unsigned int sensorLevel;
-    unsigned int sensorAdc;
-    unsigned int sensorAdcMin;
-    unsigned int sensorAdcMax;
-    unsigned int measureTimestamp;
-    unsigned int measureInterval;
-    boolean menuUpsideDown;
+    SensorSnapshot* snapshot = nullptr;
+    SensorState sensor;  // Stand, aus dem die Antworten erzeugt wurden
 
     AsyncWebServer server;
+    AsyncEventSource events;
     DNSServer dnsServer;
-    ESP8266WiFiMulti WiFiMulti;
+    WifiConnection wifi;
+    NetworkList networks;
+    ScanService scans;
+    AsyncWebServerRequest* scanWaiters[MAX_SCAN_WAITERS] = {};
+
+    // Änderung an den Einstellungen, deren Anfrage auf das Ergebnis von loop() wartet
+    struct ConfigWaiter {
+        AsyncWebServerRequest* request = nullptr;
+        uint16_t id = 0;      // Nummer des Befehls in der Warteschlange
+        bool done = false;    // von loop() bearbeitet, in update() beantworten
+        String error;         // leer, wenn die Änderung gespeichert wurde
+    };
+    ConfigWaiter configWaiters[MAX_CONFIG_WAITERS];
+    uint16_t lastCommandId = 0;
+    bool accessPointActive = false;
+    bool connectPending = false;  // Verbindung zu pendingSsid in update() starten
+    bool networksPending = false;  // bekannte Netzwerke in update() speichern
+    String pendingSsid;
 
-    String currentSSID;
-    String currentPassword;
     LittleFSManager store;
+    HistoryStore* history = nullptr;
+    SensorConfig config;
 
     void handleRoot(AsyncWebServerRequest* request);
     void handleScan(AsyncWebServerRequest* request);
+    void answerScanWaiters();
+    void sendScan(AsyncWebServerRequest* request);
+    void forgetScanWaiter(AsyncWebServerRequest* request);
     void handleConnect(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
     void handleDisconnect(AsyncWebServerRequest* request);
+    void handleNetworks(AsyncWebServerRequest* request);
+    void handleNetworkAdd(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+    void handleNetworkRemove(AsyncWebServerRequest* request);
+    void migrateCredentials();
     void handleStatus(AsyncWebServerRequest* request);
     void handleManifest(AsyncWebServerRequest* request);
     void handleInterval(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
     void handleAdc(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+    void handleCalibration(AsyncWebServerRequest* request);
+    void handleCalibrationStart(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+    void queueCalibration(AsyncWebServerRequest* request, CommandType type, CalibrationTarget target = CALIBRATION_MIN);
     void handleLedDirection(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+    void handleConfig(AsyncWebServerRequest* request);
+    void handleConfigPatch(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+    void applyConfig(AsyncWebServerRequest* request, JsonObjectConst json);
+    void answerConfigWaiters();
+    void forgetConfigWaiter(AsyncWebServerRequest* request);
+    void sendError(AsyncWebServerRequest* request, const String& message, int code = 400);
     void handleSensorLevel(AsyncWebServerRequest* request);
+    void handleEventsConnect(AsyncEventSourceClient* client);
+    void handleHistory(AsyncWebServerRequest* request);
+    void handleMetrics(AsyncWebServerRequest* request);
+
+    void sendCached(AsyncWebServerRequest* request, const CachedBody& body);
+    void sendDocument(AsyncWebServerRequest* request, int code, const JsonDocument& doc);
+    bool acceptsMsgPack(AsyncWebServerRequest* request);
 
-    bool tryConnect(const String& ssid, const String& password);
+    // Vorserialisierte Antworten (JSON und MessagePack), werden nur bei Änderungen neu erzeugt
+    CachedBody sensorBody;
+    CachedBody statusBody;
+    unsigned long lastStatusCheck = 0;
+    bool wifiConnected = false;
+    uint32_t wifiIp = 0;
+    int wifiSignal = 0;
+    uint8_t wifiChannel = 0;
+    uint32_t wifiVersion = 0;
+
+    WiFiEventHandler gotIpHandler;
+    bool wifiEverConnected = false;  // jede weitere IP-Vergabe zählt als Reconnect
+
+    bool sensorEventPending = false;
+    unsigned long lastEventTime = 0;
+
+    void buildSensorBody();
+    void buildStatusBody();
+    void refreshStatus();
+    void pushEvents();
 
     void redirect(AsyncWebServerRequest* request);
     void handleSuccess(AsyncWebServerRequest* request);
 
     String toStringIp(IPAddress ip);
-
-    // Callback
-    std::function<void(unsigned int)> onIntervalChangedCallback;
-    std::function<void(String, unsigned int)> onIntervalAdcChangedCallback;
-    std::function<void(boolean)> onLedDirectionChangedCallback;
 };
 
 #endif
@@ -0,0 +1,148 @@
+#include "CachedBody.h"
+
+#include <stdio.h>
+#include <string.h>
+
+CachedBody::CachedBody(char tag) : tag(tag), jsonBody(1, '\0') {}
+
+/**
+ * @brief Serialises a document into both cached bodies.
+ *
+ * The buffers keep their capacity, so rebuilding a body of the same size
+ * does not allocate.
+ *
+ * @param doc The document to send.
+ * @param version The version of the content, used as ETag and SSE event id.
+ */
+void CachedBody::build(const JsonDocument& doc, uint32_t version) {
+    jsonBody.resize(measureJson(doc) + 1);
+    size_t len = serializeJson(doc, jsonBody.data(), jsonBody.size());
+    jsonBody[len] = '\0';
+    packBody.resize(measureMsgPack(doc));
+    serializeMsgPack(doc, packBody.data(), packBody.size());
+    bodyVersion = version;
+}
+
+const char* CachedBody::json() const {
+    return jsonBody.data();
+}
+
+const uint8_t* CachedBody::pack() const {
+    return packBody.data();
+}
+
+size_t CachedBody::packSize() const {
+    return packBody.size();
+}
+
+uint32_t CachedBody::version() const {
+    return bodyVersion;
+}
+
+/**
+ * @brief Formats the ETag of the body.
+ *
+ * The MessagePack body has its own ETag, so a cache never mixes the two.
+ *
+ * @param buffer Receives the quoted ETag, CACHED_BODY_ETAG_SIZE is enough.
+ * @param size The size of the buffer.
+ * @param msgPack true for the MessagePack body.
+ * @return The length of the ETag.
+ */
+size_t CachedBody::etag(char* buffer, size_t size, bool msgPack) const {
+    int len = snprintf(buffer, size, "\"%c%lu%s\"", tag, (unsigned long)bodyVersion, msgPack ? "m" : "");
+    return len < 0 ? 0 : min((size_t)len, size - 1);
+}
+
+/**
+ * @brief Checks an If-None-Match header against an ETag.
+ *
+ * The header may list several ETags separated by commas, weak ETags (W/)
+ * count as equal, and "*" matches any ETag.
+ *
+ * @param ifNoneMatch The value of the header.
+ * @param etag The quoted ETag of the current body.
+ * @return true if the client already has this body (304).
+ */
+bool CachedBody::matches(const char* ifNoneMatch, const char* etag) {
+    size_t etagLen = strlen(etag);
+    const char* p = ifNoneMatch;
+    while (*p) {
+        while (*p == ' ' || *p == ',') {
+            p++;
+        }
+        if (*p == '*') {
+            return true;
+        }
+        if (p[0] == 'W' && p[1] == '/') {
+            p += 2;
+        }
+        const char* end = p;
+        while (*end && *end != ',') {
+            end++;
+        }
+        const char* last = end;
+        while (last > p && last[-1] == ' ') {
+            last--;
+        }
+        if ((size_t)(last - p) == etagLen && strncmp(p, etag, etagLen) == 0) {
+            return true;
+        }
+        p = end;
+    }
+    return false;
+}
+
+/**
+ * @brief Writes the sensor state in the format of /sensor and the SSE events.
+ *
+ * Values are emitted as numbers. Once a calibration was started, its
+ * progress is included, so the SSE channel also reports it.
+ */
+void sensorToJson(const SensorState& sensor, JsonObject json) {
+    json["value"] = sensor.level;
+    json["adcValue"] = sensor.adc;
+    json["adcMin"] = sensor.adcMin;
+    json["adcMax"] = sensor.adcMax;
+    json["timestamp"] = sensor.timestamp;
+    json["interval"] = sensor.interval;
+    json["menuUpsideDown"] = sensor.upsideDown;
+    if (sensor.calibration.session != 0) {
+        sensor.calibration.toJson(json["calibration"].to<JsonObject>());
+    }
+}
+
+/**
+ * @brief Writes the connection state in the format of /status.
+ *
+ * @param status The WiFi values collected by the captive portal.
+ * @param sensor The sensor state for timestamp, interval and direction.
+ */
+void statusToJson(const PortalStatus& status, const SensorState& sensor, JsonObject json) {
+    JsonObject connection = json["connection"].to<JsonObject>();
+    connection["state"] = status.state;
+    connection["attempts"] = status.attempts;
+    connection["failures"] = status.failures;
+    connection["lastAttemptMs"] = status.lastAttemptMs;
+    connection["bootToConnectedMs"] = status.bootToConnectedMs;
+    connection["fastConnect"] = status.fastConnect;
+    connection["accessPoint"] = status.accessPoint;
+
+    if (!status.connected) {
+        json["connected"] = false;
+        return;
+    }
+    json["connected"] = true;
+    json["timestamp"] = sensor.timestamp;
+    json["interval"] = sensor.interval;
+    json["menuUpsideDown"] = sensor.upsideDown;
+    JsonObject wifi = json["wifi"].to<JsonObject>();
+    char ip[16];
+    snprintf(ip, sizeof(ip), "%u.%u.%u.%u", (unsigned)(status.ip & 0xFF), (unsigned)((status.ip >> 8) & 0xFF),
+             (unsigned)((status.ip >> 16) & 0xFF), (unsigned)(status.ip >> 24));
+    wifi["ip"] = ip;
+    wifi["ssid"] = status.ssid;
+    wifi["signal"] = status.signal;
+    wifi["channel"] = status.channel;
+    wifi["secured"] = status.secured;
+}
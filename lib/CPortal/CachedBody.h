@@ -0,0 +1,65 @@
+#ifndef CACHED_BODY_H
+#define CACHED_BODY_H
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "SensorSnapshot.h"
+
+#define CACHED_BODY_ETAG_SIZE 20  // "\"s4294967295m\"" mit Nullbyte
+
+/**
+ * Werte von /status, von CPortal aus dem WLAN-Zustand gesammelt.
+ */
+struct PortalStatus {
+    const char* state = "";  // Zustand des Verbindungsaufbaus
+    uint32_t attempts = 0;
+    uint32_t failures = 0;
+    uint32_t lastAttemptMs = 0;
+    uint32_t bootToConnectedMs = 0;
+    bool fastConnect = false;
+    bool accessPoint = false;
+    bool connected = false;
+    uint32_t ip = 0;        // wie IPAddress, erstes Oktett im untersten Byte
+    const char* ssid = "";
+    int signal = 0;         // %
+    uint8_t channel = 0;
+    bool secured = false;
+};
+
+/**
+ * Vorserialisierte Antwort als JSON und MessagePack mit ihrer Version.
+ *
+ * Wird nur bei Änderungen neu gebaut; die Handler senden den Puffer oder
+ * antworten mit 304, wenn der Client diese Version schon hat. Ohne
+ * Webserver und Arduino-Core, damit der Weg einer Anfrage auch in den
+ * Host-Benchmarks läuft.
+ */
+class CachedBody {
+   public:
+    explicit CachedBody(char tag);
+
+    void build(const JsonDocument& doc, uint32_t version);
+
+    const char* json() const;  // nullterminiert
+    const uint8_t* pack() const;
+    size_t packSize() const;
+    uint32_t version() const;
+
+    size_t etag(char* buffer, size_t size, bool msgPack) const;
+    static bool matches(const char* ifNoneMatch, const char* etag);
+
+   private:
+    char tag;  // erstes Zeichen der ETag, unterscheidet die Ressourcen
+    std::vector<char> jsonBody;
+    std::vector<uint8_t> packBody;
+    uint32_t bodyVersion = 0;
+};
+
+void sensorToJson(const SensorState& sensor, JsonObject json);
+void statusToJson(const PortalStatus& status, const SensorState& sensor, JsonObject json);
+
+#endif
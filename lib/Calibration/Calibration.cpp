@@ -0,0 +1,150 @@
+#include "Calibration.h"
+
+#include "Metrics.h"
+
+Calibration::Calibration(CurrentLoopSensor& sensor, uint8_t powerPin) : sensor(sensor), powerPin(powerPin) {}
+
+/**
+ * @brief Starts a calibration of the minimum or maximum.
+ *
+ * Switches the step-up converter on; the samples are taken in update().
+ *
+ * @param target The limit to calibrate.
+ * @return false if a calibration is running already.
+ */
+bool Calibration::start(CalibrationTarget target) {
+    if (running()) {
+        return false;
+    }
+    uint16_t session = current.session + 1;
+    current = CalibrationStatus();
+    current.session = session;
+    current.target = target;
+    current.state = CALIBRATION_SETTLING;
+    sum = 0;
+    sumSquares = 0;
+    digitalWrite(powerPin, HIGH);
+    phaseStartedAt = millis();
+    notify();
+    return true;
+}
+
+/**
+ * @brief Stops a running calibration without changing the limits.
+ */
+void Calibration::cancel() {
+    if (running()) {
+        finish(CALIBRATION_CANCELLED);
+    }
+}
+
+/**
+ * @brief Advances a running calibration.
+ *
+ * Call this in every loop. Takes at most one sample per call.
+ */
+void Calibration::update() {
+    uint32_t now = millis();
+    if (current.state == CALIBRATION_SETTLING) {
+        if (now - phaseStartedAt >= CALIBRATION_SETTLE_MS) {
+            current.state = CALIBRATION_SAMPLING;
+            phaseStartedAt = now;
+            sample();
+        }
+    } else if (current.state == CALIBRATION_SAMPLING) {
+        if (now - lastSampleAt >= CALIBRATION_SAMPLE_MS) {
+            sample();
+        }
+    }
+}
+
+/**
+ * @brief Takes one sample into the window.
+ */
+void Calibration::sample() {
+    sensor.getValue();
+    lastSampleAt = millis();  // getValue() blockiert ~100 ms, die Pause zählt ab dem Ende
+    uint32_t adc = sensor.getAdc();
+    sum += adc;
+    sumSquares += adc * adc;
+    current.samples++;
+    current.progress = current.samples * 100 / CALIBRATION_SAMPLES;
+    if (current.samples >= CALIBRATION_SAMPLES) {
+        evaluate();
+    } else {
+        notify();
+    }
+}
+
+/**
+ * @brief Calculates mean, spread and confidence of the full window.
+ *
+ * The confidence falls linearly from 100 % without any spread to 0 % at
+ * CALIBRATION_MAX_STDDEV; a wider spread rejects the window.
+ */
+void Calibration::evaluate() {
+    uint32_t n = current.samples;
+    current.mean = (sum + n / 2) / n;
+    // Varianz in ADC-Schritten², ganzzahlig: (n * Σx² - (Σx)²) / n²
+    uint64_t spread = n * sumSquares - (uint64_t)sum * sum;
+    current.stddev = lroundf(sqrtf((float)spread / (n * n)) * 10);
+    int32_t confidence = 100 - (int32_t)current.stddev * 10 / CALIBRATION_MAX_STDDEV;
+    current.confidence = confidence > 0 ? confidence : 0;
+
+    if (current.stddev > CALIBRATION_MAX_STDDEV * 10) {
+        finish(CALIBRATION_NOISY);
+    } else if ((current.target == CALIBRATION_MIN && current.mean >= sensor.getMaxAdcValue()) ||
+               (current.target == CALIBRATION_MAX && current.mean <= sensor.getMinAdcValue())) {
+        finish(CALIBRATION_OUT_OF_RANGE);
+    } else {
+        finish(CALIBRATION_OK);
+    }
+}
+
+/**
+ * @brief Ends the calibration and switches the converter off.
+ *
+ * @param error CALIBRATION_OK if the mean can be taken over.
+ */
+void Calibration::finish(CalibrationError error) {
+    digitalWrite(powerPin, LOW);
+    current.state = error == CALIBRATION_OK ? CALIBRATION_DONE : CALIBRATION_FAILED;
+    current.error = error;
+    metrics.calibrations[error]++;
+    notify();
+    if (finishedCallback) {
+        finishedCallback(current);
+    }
+}
+
+void Calibration::notify() {
+    if (progressCallback) {
+        progressCallback(current);
+    }
+}
+
+bool Calibration::running() const {
+    return current.running();
+}
+
+const CalibrationStatus& Calibration::status() const {
+    return current;
+}
+
+/**
+ * @brief Registers a callback for every change of the status.
+ *
+ * @param callback The function to call.
+ */
+void Calibration::onProgress(Callback callback) {
+    progressCallback = callback;
+}
+
+/**
+ * @brief Registers a callback for finished calibrations, successful or not.
+ *
+ * @param callback The function to call.
+ */
+void Calibration::onFinished(Callback callback) {
+    finishedCallback = callback;
+}
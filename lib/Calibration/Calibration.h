@@ -0,0 +1,68 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <Arduino.h>
+
+#include <functional>
+
+#include "CalibrationStatus.h"
+#include "NoiascaCurrentLoop.h"
+
+// Wartezeit nach dem Einschalten des Step-Up-Wandlers, bis der Schleifenstrom stabil ist
+#ifndef CALIBRATION_SETTLE_MS
+#define CALIBRATION_SETTLE_MS 1000
+#endif
+// Pause zwischen dem Ende einer Messung und der nächsten, eine Messung dauert ~100 ms
+#ifndef CALIBRATION_SAMPLE_MS
+#define CALIBRATION_SAMPLE_MS 50
+#endif
+// Größte zulässige Standardabweichung der Messungen in ADC-Schritten, darüber wird verworfen
+#ifndef CALIBRATION_MAX_STDDEV
+#define CALIBRATION_MAX_STDDEV 4
+#endif
+
+/**
+ * Kalibriert Minimum oder Maximum des Sensors über mehrere loop()-Durchläufe,
+ * ohne zu blockieren.
+ *
+ * start() schaltet den Step-Up-Wandler ein; nach CALIBRATION_SETTLE_MS wird
+ * mit CALIBRATION_SAMPLE_MS Pause gemessen, bis CALIBRATION_SAMPLES Werte im
+ * Fenster sind. Ist die Streuung zu groß oder liegt der Mittelwert auf der
+ * falschen Seite der anderen Grenze, wird verworfen; sonst meldet
+ * onFinished() den Mittelwert mit seiner Konfidenz. Übernehmen und Speichern
+ * ist Sache des Aufrufers.
+ */
+class Calibration {
+   public:
+    using Callback = std::function<void(const CalibrationStatus&)>;
+
+    Calibration(CurrentLoopSensor& sensor, uint8_t powerPin);
+
+    bool start(CalibrationTarget target);
+    void cancel();
+    void update();
+    bool running() const;
+    const CalibrationStatus& status() const;
+
+    void onProgress(Callback callback);  // bei jeder Änderung von status()
+    void onFinished(Callback callback);  // nach DONE oder FAILED
+
+   private:
+    CurrentLoopSensor& sensor;
+    uint8_t powerPin;
+    CalibrationStatus current;
+    uint32_t phaseStartedAt = 0;
+    uint32_t lastSampleAt = 0;
+    uint32_t sum = 0;
+    uint64_t sumSquares = 0;
+
+    Callback progressCallback;
+    Callback finishedCallback;
+
+    void sample();
+    void evaluate();
+    void finish(CalibrationError error);
+    void notify();
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "CalibrationStatus.h"
+
+#include <string.h>
+
+static const char* const TARGET_NAMES[] = {"min", "max"};
+static const char* const STATE_NAMES[] = {"idle", "settling", "sampling", "done", "failed"};
+static const char* const ERROR_NAMES[] = {"", "noisy", "out_of_range", "cancelled"};
+
+bool CalibrationStatus::running() const {
+    return state == CALIBRATION_SETTLING || state == CALIBRATION_SAMPLING;
+}
+
+bool CalibrationStatus::equals(const CalibrationStatus& other) const {
+    return session == other.session && target == other.target && state == other.state && error == other.error &&
+           progress == other.progress && samples == other.samples && mean == other.mean && stddev == other.stddev &&
+           confidence == other.confidence;
+}
+
+/**
+ * @brief Writes the status into a JSON object.
+ *
+ * This is the format of /calibration and of the calibration in /sensor.
+ * The standard deviation is given in ADC steps.
+ */
+void CalibrationStatus::toJson(JsonObject json) const {
+    json["session"] = session;
+    json["target"] = targetName(target);
+    json["state"] = STATE_NAMES[state];
+    if (error != CALIBRATION_OK) {
+        json["error"] = ERROR_NAMES[error];
+    }
+    json["progress"] = progress;
+    json["samples"] = samples;
+    json["window"] = CALIBRATION_SAMPLES;
+    if (state == CALIBRATION_DONE || (state == CALIBRATION_FAILED && samples == CALIBRATION_SAMPLES)) {
+        json["mean"] = mean;
+        json["stddev"] = stddev / 10.0f;
+        json["confidence"] = confidence;
+    }
+}
+
+const char* CalibrationStatus::targetName(CalibrationTarget target) {
+    return TARGET_NAMES[target];
+}
+
+/**
+ * @brief Reads a target from its name, "min" or "max".
+ *
+ * @return false for any other name.
+ */
+bool CalibrationStatus::parseTarget(const char* name, CalibrationTarget& target) {
+    if (strcmp(name, "min") == 0) {
+        target = CALIBRATION_MIN;
+    } else if (strcmp(name, "max") == 0) {
+        target = CALIBRATION_MAX;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef CALIBRATION_STATUS_H
+#define CALIBRATION_STATUS_H
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+
+// Messungen je Kalibrierung, höchstens 255
+#ifndef CALIBRATION_SAMPLES
+#define CALIBRATION_SAMPLES 32
+#endif
+
+enum CalibrationTarget : uint8_t { CALIBRATION_MIN,
+                                   CALIBRATION_MAX };
+
+enum CalibrationState : uint8_t { CALIBRATION_IDLE,
+                                  CALIBRATION_SETTLING,  // Wandler an, warten auf stabilen Strom
+                                  CALIBRATION_SAMPLING,  // Messfenster wird gefüllt
+                                  CALIBRATION_DONE,      // Wert übernommen
+                                  CALIBRATION_FAILED };
+
+enum CalibrationError : uint8_t { CALIBRATION_OK,
+                                  CALIBRATION_NOISY,         // Streuung über CALIBRATION_MAX_STDDEV
+                                  CALIBRATION_OUT_OF_RANGE,  // Minimum nicht unter dem Maximum oder umgekehrt
+                                  CALIBRATION_CANCELLED };
+
+/**
+ * Stand der laufenden oder letzten Kalibrierung. Ohne Arduino-Core, damit
+ * er auch in den Host-Tests serialisiert werden kann.
+ */
+struct CalibrationStatus {
+    uint16_t session = 0;  // laufende Nummer seit dem Start, 0 = noch keine Kalibrierung
+    CalibrationTarget target = CALIBRATION_MIN;
+    CalibrationState state = CALIBRATION_IDLE;
+    CalibrationError error = CALIBRATION_OK;
+    uint8_t progress = 0;    // Fortschritt in %
+    uint8_t samples = 0;     // Messungen im Fenster
+    uint16_t mean = 0;       // Mittelwert der Messungen (ADC)
+    uint16_t stddev = 0;     // Standardabweichung in 1/10 ADC-Schritten
+    uint8_t confidence = 0;  // 100 % ohne Streuung, 0 % an der Grenze CALIBRATION_MAX_STDDEV
+
+    bool running() const;
+    bool equals(const CalibrationStatus& other) const;
+    void toJson(JsonObject json) const;
+
+    static const char* targetName(CalibrationTarget target);
+    static bool parseTarget(const char* name, CalibrationTarget& target);
+};
+
+#endif
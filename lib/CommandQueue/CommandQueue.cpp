@@ -0,0 +1,57 @@
+#include "CommandQueue.h"
+
+#include "Metrics.h"
+
+CommandQueue commands;
+
+/**
+ * @brief Queues a command for loop().
+ *
+ * Only call this from the network callbacks. The command is copied into its
+ * slot before it is published to the reader.
+ *
+ * @param command The command.
+ * @return false if the queue is full and the command was dropped.
+ */
+bool CommandQueue::push(Command command) {
+    uint8_t h = head.load(std::memory_order_relaxed);
+    uint8_t t = tail.load(std::memory_order_acquire);
+    if ((uint8_t)(h - t) >= COMMAND_QUEUE_SIZE) {
+        metrics.commandsDropped++;
+        return false;
+    }
+    command.queuedAt = micros();
+    slots[h % COMMAND_QUEUE_SIZE] = command;
+    head.store(h + 1, std::memory_order_release);
+
+    uint8_t waiting = h + 1 - t;
+    if (waiting > metrics.commandQueueHighWater) {
+        metrics.commandQueueHighWater = waiting;
+    }
+    return true;
+}
+
+/**
+ * @brief Takes the oldest command from the queue.
+ *
+ * Only call this from loop().
+ *
+ * @param command Receives the command.
+ * @return false if the queue is empty.
+ */
+bool CommandQueue::pop(Command& command) {
+    uint8_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    command = slots[t % COMMAND_QUEUE_SIZE];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Returns the number of waiting commands.
+ */
+size_t CommandQueue::depth() const {
+    return (uint8_t)(head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire));
+}
@@ -0,0 +1,62 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <Arduino.h>
+
+#include <atomic>
+
+#include "Calibration.h"
+#include "ConfigStore.h"
+
+// Plätze in der Warteschlange, Zweierpotenz bis 128
+#ifndef COMMAND_QUEUE_SIZE
+#define COMMAND_QUEUE_SIZE 8
+#endif
+
+enum CommandType : uint8_t { COMMAND_CONFIG,
+                              COMMAND_CALIBRATE,
+                              COMMAND_CALIBRATION_CANCEL };
+
+enum CommandSource : uint8_t { SOURCE_PORTAL,
+                               SOURCE_MQTT };
+
+/**
+ * Ein Befehl an loop(). Bei COMMAND_CONFIG enthält `patch` die bereits
+ * geprüften Änderungen, bei COMMAND_CALIBRATE `target` die zu messende Grenze.
+ */
+struct Command {
+    CommandType type = COMMAND_CONFIG;
+    CommandSource source = SOURCE_PORTAL;
+    ConfigPatch patch;
+    CalibrationTarget target = CALIBRATION_MIN;
+    uint32_t queuedAt = 0;  // micros() beim Einreihen
+    uint16_t id = 0;        // Nummer der wartenden Anfrage, 0 = niemand wartet auf das Ergebnis
+};
+
+/**
+ * Warteschlange von den Netzwerk-Callbacks (Webserver, MQTT) zu loop().
+ *
+ * Die Callbacks von ESPAsyncTCP laufen alle im selben Kontext und
+ * unterbrechen sich nicht gegenseitig, sie sind also zusammen der einzige
+ * Schreiber; loop() ist der einzige Leser. Deshalb genügen zwei
+ * Positionszähler ohne Sperre: push() schreibt nur `head`, pop() nur `tail`.
+ * Ist die Schlange voll, wird der Befehl abgewiesen.
+ */
+class CommandQueue {
+   public:
+    bool push(Command command);
+    bool pop(Command& command);
+    size_t depth() const;
+
+   private:
+    static_assert((COMMAND_QUEUE_SIZE & (COMMAND_QUEUE_SIZE - 1)) == 0 && COMMAND_QUEUE_SIZE <= 128,
+                  "COMMAND_QUEUE_SIZE must be a power of two up to 128");
+
+    Command slots[COMMAND_QUEUE_SIZE];
+    std::atomic<uint8_t> head{0};  // laufende Nummer des nächsten freien Platzes
+    std::atomic<uint8_t> tail{0};  // laufende Nummer des nächsten Befehls
+};
+
+extern CommandQueue commands;
+
+#endif
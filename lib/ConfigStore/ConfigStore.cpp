@@ -0,0 +1,357 @@
+#include "ConfigStore.h"
+
+#include "Metrics.h"
+
+void ConfigPatch::setInterval(uint8_t value) {
+    values.interval = value;
+    fields |= CONFIG_INTERVAL;
+}
+
+void ConfigPatch::setBrightness(uint8_t value) {
+    values.brightness = value;
+    fields |= CONFIG_BRIGHTNESS;
+}
+
+void ConfigPatch::setUpsideDown(bool value) {
+    values.upsideDown = value;
+    fields |= CONFIG_UPSIDE_DOWN;
+}
+
+void ConfigPatch::setMinAdc(uint16_t value, uint8_t confidence) {
+    values.minAdc = value;
+    values.minConfidence = confidence;
+    fields |= CONFIG_MIN_ADC;
+}
+
+void ConfigPatch::setMaxAdc(uint16_t value, uint8_t confidence) {
+    values.maxAdc = value;
+    values.maxConfidence = confidence;
+    fields |= CONFIG_MAX_ADC;
+}
+
+bool ConfigPatch::has(uint8_t field) const {
+    return (fields & field) != 0;
+}
+
+/**
+ * @brief Copies the set values into a config.
+ *
+ * @param config The config to change.
+ */
+void ConfigPatch::applyTo(SensorConfig& config) const {
+    if (has(CONFIG_INTERVAL)) config.interval = values.interval;
+    if (has(CONFIG_BRIGHTNESS)) config.brightness = values.brightness;
+    if (has(CONFIG_UPSIDE_DOWN)) config.upsideDown = values.upsideDown;
+    if (has(CONFIG_MIN_ADC)) {
+        config.minAdc = values.minAdc;
+        config.minConfidence = values.minConfidence;
+    }
+    if (has(CONFIG_MAX_ADC)) {
+        config.maxAdc = values.maxAdc;
+        config.maxConfidence = values.maxConfidence;
+    }
+}
+
+/**
+ * @brief Reads a patch from a JSON object.
+ *
+ * Accepts any subset of the keys written by ConfigStore::toJson(), except
+ * "version". Numbers may also be sent as strings, like the old web UI did.
+ * The calibration confidences are ignored; a limit set here has confidence 0.
+ * Unknown keys and values of the wrong type are rejected.
+ *
+ * @param json The JSON object of the request.
+ * @param error Receives the error message.
+ * @return true if the object could be read.
+ */
+bool ConfigPatch::fromJson(JsonObjectConst json, String& error) {
+    for (JsonPairConst pair : json) {
+        const char* key = pair.key().c_str();
+        JsonVariantConst value = pair.value();
+        long number = value.as<long>();
+        bool isNumber = value.is<long>();
+        if (value.is<const char*>()) {
+            // ganze Zeichenkette muss eine Zahl sein, "abc" oder "12a" wird abgewiesen
+            const char* text = value.as<const char*>();
+            char* end;
+            number = strtol(text, &end, 10);
+            isNumber = end != text && *end == '\0';
+        }
+
+        if (strcmp(key, "adcMinConfidence") == 0 || strcmp(key, "adcMaxConfidence") == 0) {
+            continue;  // nur lesbar, Ergebnis der Kalibrierung
+        }
+        if (strcmp(key, "upsideDown") == 0) {
+            if (!value.is<bool>()) {
+                error = "upsideDown must be a boolean";
+                return false;
+            }
+            setUpsideDown(value.as<bool>());
+            continue;
+        }
+        if (!isNumber || number < 0 || number > 0xFFFF) {
+            error = String("Invalid value for ") + key;
+            return false;
+        }
+        bool isByte = strcmp(key, "interval") == 0 || strcmp(key, "brightness") == 0;
+        if (isByte && number > 0xFF) {
+            error = String("Invalid value for ") + key;
+            return false;
+        }
+        if (strcmp(key, "interval") == 0) {
+            setInterval(number);
+        } else if (strcmp(key, "brightness") == 0) {
+            setBrightness(number);
+        } else if (strcmp(key, "adcMin") == 0) {
+            setMinAdc(number);
+        } else if (strcmp(key, "adcMax") == 0) {
+            setMaxAdc(number);
+        } else {
+            error = String("Unknown setting ") + key;
+            return false;
+        }
+    }
+    if (fields == 0) {
+        error = "No settings";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Validates the patch together with the current settings.
+ *
+ * All values are checked before anything is applied, so a request is either
+ * applied completely or not at all. The ADC range is checked with the values
+ * that result from the patch, so min and max can be moved in one request.
+ *
+ * @param current The current settings.
+ * @param error Receives the error message.
+ * @return true if the patch can be applied.
+ */
+bool ConfigPatch::validate(const SensorConfig& current, String& error) const {
+    if (has(CONFIG_INTERVAL) && (values.interval < 1 || values.interval > 6)) {
+        error = "interval must be 1..6";
+        return false;
+    }
+    if (has(CONFIG_BRIGHTNESS) && (values.brightness < 1 || values.brightness > 6)) {
+        error = "brightness must be 1..6";
+        return false;
+    }
+    uint16_t minAdc = has(CONFIG_MIN_ADC) ? values.minAdc : current.minAdc;
+    uint16_t maxAdc = has(CONFIG_MAX_ADC) ? values.maxAdc : current.maxAdc;
+    if (minAdc > 1023 || maxAdc > 1023) {
+        error = "adcMin/adcMax must be 0..1023";
+        return false;
+    }
+    if (minAdc != 0 && maxAdc != 0 && minAdc >= maxAdc) {
+        error = "adcMin must be lower than adcMax";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Loads the settings.
+ *
+ * Reads the config file. If it does not exist yet, the settings are taken
+ * over from the single-value files of older firmware versions and saved in
+ * the new format.
+ *
+ * @param legacy The store holding the single-value files.
+ */
+void ConfigStore::begin(LittleFSManager& legacy) {
+    if (!load()) {
+        migrate(legacy);
+    }
+}
+
+/**
+ * @brief Reads the config file.
+ *
+ * @return true if the file exists and could be parsed.
+ */
+bool ConfigStore::load() {
+    File file = LittleFS.open(CONFIG_FILE, "r");
+    if (!file) {
+        return false;
+    }
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        Serial.println("ConfigStore::load --> INVALID " CONFIG_FILE);
+        return false;
+    }
+    config.interval = doc["interval"] | config.interval;
+    config.brightness = doc["brightness"] | config.brightness;
+    config.upsideDown = doc["upsideDown"] | config.upsideDown;
+    config.minAdc = doc["adcMin"] | config.minAdc;
+    config.maxAdc = doc["adcMax"] | config.maxAdc;
+    config.minConfidence = doc["adcMinConfidence"] | config.minConfidence;
+    config.maxConfidence = doc["adcMaxConfidence"] | config.maxConfidence;
+    config.version = doc["version"] | config.version;
+    return true;
+}
+
+/**
+ * @brief Takes over the settings of older firmware versions.
+ *
+ * @param legacy The store holding the single-value files.
+ */
+void ConfigStore::migrate(LittleFSManager& legacy) {
+    config.interval = legacy.read("interval", config.interval);
+    config.brightness = legacy.read("brightness", config.brightness);
+    config.upsideDown = legacy.read("upsideDown", config.upsideDown);
+    config.minAdc = legacy.read("minAdcValue", config.minAdc);
+    config.maxAdc = legacy.read("maxAdcValue", config.maxAdc);
+    dirty = true;
+    if (commit()) {
+        legacy.clear("interval");
+        legacy.clear("brightness");
+        legacy.clear("upsideDown");
+        legacy.clear("minAdcValue");
+        legacy.clear("maxAdcValue");
+    }
+}
+
+/**
+ * @brief Returns the current settings.
+ */
+const SensorConfig& ConfigStore::get() {
+    return config;
+}
+
+/**
+ * @brief Applies a patch to the settings without saving it.
+ *
+ * @param patch The changed settings.
+ */
+void ConfigStore::apply(const ConfigPatch& patch) {
+    patch.applyTo(config);
+    dirty = dirty || patch.fields != 0;
+}
+
+/**
+ * @brief Saves the settings if they were changed.
+ *
+ * All settings are written in one go to a temporary file, which then
+ * replaces the config file. A power loss while writing leaves the previous
+ * settings intact. Each save increases the version.
+ *
+ * @return true if the settings are saved.
+ */
+bool ConfigStore::commit() {
+    if (!dirty) {
+        return true;
+    }
+    config.version++;
+
+    JsonDocument doc;
+    toJson(config, doc.to<JsonObject>());
+    File file = LittleFS.open(CONFIG_FILE_TMP, "w");
+    if (!file) {
+        Serial.println("ConfigStore::commit --> FAILED TO OPEN " CONFIG_FILE_TMP);
+        return false;
+    }
+    size_t written = serializeJson(doc, file);
+    file.close();
+    metrics.countFlashWrite(FILE_CONFIG, written);
+    if (!LittleFS.rename(CONFIG_FILE_TMP, CONFIG_FILE)) {
+        Serial.println("ConfigStore::commit --> FAILED TO RENAME " CONFIG_FILE_TMP);
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+/**
+ * @brief Writes the settings into a JSON object.
+ *
+ * This is the format of the config file and of the /config endpoint.
+ *
+ * @param config The settings.
+ * @param json The JSON object to fill.
+ */
+void ConfigStore::toJson(const SensorConfig& config, JsonObject json) {
+    json["version"] = config.version;
+    json["interval"] = config.interval;
+    json["brightness"] = config.brightness;
+    json["upsideDown"] = config.upsideDown;
+    json["adcMin"] = config.minAdc;
+    json["adcMax"] = config.maxAdc;
+    json["adcMinConfidence"] = config.minConfidence;
+    json["adcMaxConfidence"] = config.maxConfidence;
+}
+
+bool WifiCache::valid() const {
+    return channel != 0 && !ssid.isEmpty();
+}
+
+bool WifiCache::equals(const WifiCache& other) const {
+    return ssid == other.ssid && memcmp(bssid, other.bssid, sizeof(bssid)) == 0 && channel == other.channel &&
+           ip == other.ip && gateway == other.gateway && subnet == other.subnet && dns == other.dns;
+}
+
+/**
+ * @brief Reads the data of the last WiFi connection.
+ *
+ * Kept in its own file, so it is neither part of the /config endpoint nor
+ * written together with the settings.
+ *
+ * @param cache Receives the data.
+ * @return true if the file exists and could be parsed.
+ */
+bool ConfigStore::loadWifiCache(WifiCache& cache) {
+    File file = LittleFS.open(WIFI_CACHE_FILE, "r");
+    if (!file) {
+        return false;
+    }
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        return false;
+    }
+    cache.ssid = doc["ssid"] | "";
+    JsonArrayConst bssid = doc["bssid"];
+    for (size_t i = 0; i < sizeof(cache.bssid) && i < bssid.size(); i++) {
+        cache.bssid[i] = bssid[i];
+    }
+    cache.channel = doc["channel"] | 0;
+    cache.ip = doc["ip"] | 0;
+    cache.gateway = doc["gateway"] | 0;
+    cache.subnet = doc["subnet"] | 0;
+    cache.dns = doc["dns"] | 0;
+    return true;
+}
+
+/**
+ * @brief Saves the data of the last WiFi connection.
+ *
+ * @param cache The data to save.
+ * @return true if the file was written.
+ */
+bool ConfigStore::saveWifiCache(const WifiCache& cache) {
+    JsonDocument doc;
+    doc["ssid"] = cache.ssid;
+    JsonArray bssid = doc["bssid"].to<JsonArray>();
+    for (size_t i = 0; i < sizeof(cache.bssid); i++) {
+        bssid.add(cache.bssid[i]);
+    }
+    doc["channel"] = cache.channel;
+    doc["ip"] = cache.ip;
+    doc["gateway"] = cache.gateway;
+    doc["subnet"] = cache.subnet;
+    doc["dns"] = cache.dns;
+
+    File file = LittleFS.open(WIFI_CACHE_FILE, "w");
+    if (!file) {
+        Serial.println("ConfigStore::saveWifiCache --> FAILED TO OPEN " WIFI_CACHE_FILE);
+        return false;
+    }
+    size_t written = serializeJson(doc, file);
+    file.close();
+    metrics.countFlashWrite(FILE_WIFI, written);
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+#include "LittleFSManager.h"
+
+#define CONFIG_FILE "/config.json"
+#define CONFIG_FILE_TMP "/config.json.tmp"
+#define WIFI_CACHE_FILE "/wifi.json"
+
+// Felder einer Konfigurationsänderung
+#define CONFIG_INTERVAL 0x01
+#define CONFIG_BRIGHTNESS 0x02
+#define CONFIG_UPSIDE_DOWN 0x04
+#define CONFIG_MIN_ADC 0x08
+#define CONFIG_MAX_ADC 0x10
+
+/**
+ * Alle Einstellungen des Sensors. Jede gespeicherte Änderung erhöht die
+ * Version, so können Clients erkennen, ob ihr Stand aktuell ist.
+ */
+struct SensorConfig {
+    uint8_t interval = 6;    // Messintervall 1..6 (siehe timedInterval)
+    uint8_t brightness = 5;  // Helligkeit 1..6
+    bool upsideDown = true;  // LED-Anzeige umgedreht
+    uint16_t minAdc = 0;     // 0 = Standardwert des Sensors
+    uint16_t maxAdc = 0;     // 0 = Standardwert des Sensors
+    uint8_t minConfidence = 0;  // Konfidenz der Kalibrierung in %, 0 = eingegeben
+    uint8_t maxConfidence = 0;
+    uint32_t version = 0;
+};
+
+/**
+ * Eine Änderung einzelner Einstellungen. Nur die in `fields` markierten
+ * Werte sind gesetzt.
+ */
+struct ConfigPatch {
+    uint8_t fields = 0;
+    SensorConfig values;
+
+    void setInterval(uint8_t value);
+    void setBrightness(uint8_t value);
+    void setUpsideDown(bool value);
+    void setMinAdc(uint16_t value, uint8_t confidence = 0);
+    void setMaxAdc(uint16_t value, uint8_t confidence = 0);
+    bool has(uint8_t field) const;
+    void applyTo(SensorConfig& config) const;
+
+    bool fromJson(JsonObjectConst json, String& error);
+    bool validate(const SensorConfig& current, String& error) const;
+};
+
+/**
+ * Daten der letzten erfolgreichen WLAN-Verbindung für den schnellen
+ * Verbindungsaufbau nach einem Neustart (ohne Scan und ohne DHCP).
+ */
+struct WifiCache {
+    String ssid;
+    uint8_t bssid[6] = {};
+    uint8_t channel = 0;  // 0 = kein Cache
+    uint32_t ip = 0;
+    uint32_t gateway = 0;
+    uint32_t subnet = 0;
+    uint32_t dns = 0;
+
+    bool valid() const;
+    bool equals(const WifiCache& other) const;
+};
+
+/**
+ * Speichert alle Einstellungen gemeinsam in einer Datei. Eine Änderung
+ * mehrerer Werte wird mit einem einzigen Schreibvorgang übernommen.
+ */
+class ConfigStore {
+   public:
+    void begin(LittleFSManager& legacy);
+    const SensorConfig& get();
+    void apply(const ConfigPatch& patch);
+    bool commit();
+
+    static void toJson(const SensorConfig& config, JsonObject json);
+
+    static bool loadWifiCache(WifiCache& cache);
+    static bool saveWifiCache(const WifiCache& cache);
+
+   private:
+    SensorConfig config;
+    bool dirty = false;
+
+    bool load();
+    void migrate(LittleFSManager& legacy);
+};
+
+#endif
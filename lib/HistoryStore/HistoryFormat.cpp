@@ -0,0 +1,93 @@
+#include "HistoryFormat.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Encodes a record into its 8 byte little-endian layout.
+ */
+void historyEncode(const HistoryRecord& record, uint8_t* out) {
+    out[0] = record.timestamp & 0xFF;
+    out[1] = (record.timestamp >> 8) & 0xFF;
+    out[2] = (record.timestamp >> 16) & 0xFF;
+    out[3] = (record.timestamp >> 24) & 0xFF;
+    out[4] = record.adc & 0xFF;
+    out[5] = (record.adc >> 8) & 0xFF;
+    out[6] = record.level;
+    out[7] = record.flags;
+}
+
+/**
+ * @brief Decodes a record from its 8 byte little-endian layout.
+ */
+void historyDecode(const uint8_t* in, HistoryRecord& record) {
+    record.timestamp = in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+    record.adc = in[4] | (in[5] << 8);
+    record.level = in[6];
+    record.flags = in[7];
+}
+
+// MessagePack: Schlüssel als fixstr, Zahlen in der kürzesten Form wie bei ArduinoJson
+static uint8_t* packKey(uint8_t* out, const char* key) {
+    size_t len = strlen(key);
+    *out++ = 0xa0 | len;
+    memcpy(out, key, len);
+    return out + len;
+}
+
+static uint8_t* packUint(uint8_t* out, uint32_t value) {
+    if (value < 0x80) {
+        *out++ = value;
+    } else if (value <= 0xff) {
+        *out++ = 0xcc;
+        *out++ = value;
+    } else if (value <= 0xffff) {
+        *out++ = 0xcd;
+        *out++ = value >> 8;
+        *out++ = value;
+    } else {
+        *out++ = 0xce;
+        *out++ = value >> 24;
+        *out++ = value >> 16;
+        *out++ = value >> 8;
+        *out++ = value;
+    }
+    return out;
+}
+
+/**
+ * @brief Formats a record for a download.
+ *
+ * In MessagePack every record is a map with the keys of the JSON format.
+ * The records follow each other without an enclosing array, because its
+ * length is not known when the download starts.
+ *
+ * @param format The format of the download.
+ * @param record The record to format.
+ * @param first true for the first record, which gets no JSON separator.
+ * @param line Receives the formatted record, at least HISTORY_LINE_SIZE bytes.
+ * @param size The size of line.
+ * @return The number of bytes in line.
+ */
+size_t historyFormatRecord(HistoryFormat format, const HistoryRecord& record, bool first, char* line, size_t size) {
+    switch (format) {
+        case HISTORY_CSV:
+            return snprintf(line, size, "%lu,%u,%u,%u\n", (unsigned long)record.timestamp, record.level, record.adc, record.flags);
+        case HISTORY_JSON:
+            return snprintf(line, size, "%s{\"timestamp\":%lu,\"value\":%u,\"adcValue\":%u,\"flags\":%u}", first ? "" : ",",
+                            (unsigned long)record.timestamp, record.level, record.adc, record.flags);
+        case HISTORY_BIN:
+            historyEncode(record, (uint8_t*)line);
+            return HISTORY_RECORD_SIZE;
+        case HISTORY_MSGPACK: {
+            uint8_t* out = (uint8_t*)line;
+            *out++ = 0x84;  // fixmap mit 4 Einträgen
+            out = packUint(packKey(out, "timestamp"), record.timestamp);
+            out = packUint(packKey(out, "value"), record.level);
+            out = packUint(packKey(out, "adcValue"), record.adc);
+            out = packUint(packKey(out, "flags"), record.flags);
+            return out - (uint8_t*)line;
+        }
+    }
+    return 0;
+}
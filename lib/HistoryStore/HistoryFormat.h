@@ -0,0 +1,21 @@
+#ifndef HISTORY_FORMAT_H
+#define HISTORY_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "HistoryRecord.h"
+
+#define HISTORY_LINE_SIZE 64  // größter formatierter Messwert
+
+enum HistoryFormat { HISTORY_CSV,
+                     HISTORY_JSON,
+                     HISTORY_BIN,
+                     HISTORY_MSGPACK };
+
+// Formate der Messwerte ohne Dateisystem und Arduino-Core, damit sie auch auf dem Host laufen
+void historyEncode(const HistoryRecord& record, uint8_t* out);
+void historyDecode(const uint8_t* in, HistoryRecord& record);
+size_t historyFormatRecord(HistoryFormat format, const HistoryRecord& record, bool first, char* line, size_t size);
+
+#endif
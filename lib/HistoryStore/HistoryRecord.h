@@ -0,0 +1,26 @@
+#ifndef HISTORY_RECORD_H
+#define HISTORY_RECORD_H
+
+#include <stdint.h>
+
+#define HISTORY_RECORD_SIZE 8
+#define HISTORY_FLAG_UPTIME 0x01  // Zeitstempel in Sekunden seit Boot (keine NTP-Zeit)
+#define HISTORY_FLAG_GAP 0x02     // kein Messwert: Sequenznummer nach einem Reset übersprungen
+
+/**
+ * Ein gespeicherter Messwert. Im Flash und im Binärformat der History-API
+ * als 8 Byte little-endian abgelegt:
+ *
+ *   Offset 0  uint32  timestamp  Unixzeit in Sekunden (ohne NTP: siehe HISTORY_FLAG_UPTIME)
+ *   Offset 4  uint16  adc        gemittelter ADC-Wert
+ *   Offset 6  uint8   level      angezeigte Stufe (0..8)
+ *   Offset 7  uint8   flags      HISTORY_FLAG_*
+ */
+struct HistoryRecord {
+    uint32_t timestamp;
+    uint16_t adc;
+    uint8_t level;
+    uint8_t flags;
+};
+
+#endif
@@ -0,0 +1,691 @@
+#include "HistoryStore.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Metrics.h"
+
+#define HISTORY_NTP_VALID 1600000000UL  // ab hier gilt die Systemzeit als per NTP gesetzt
+#define HISTORY_META_FILE_TMP HISTORY_META_FILE ".tmp"
+
+static void putUint32(uint8_t* buffer, uint32_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+    buffer[2] = (value >> 16) & 0xFF;
+    buffer[3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t getUint32(const uint8_t* buffer) {
+    return buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+HistoryStore::HistoryStore() {}
+
+/**
+ * @brief Opens the history and restores the sequence number.
+ *
+ * The next sequence number is the one reserved in the metadata file, or the
+ * end of the newest segment if that is further. Numbers reserved before a
+ * reset are skipped and stored as gap records, so no number is handed out
+ * twice. Segments of a different layout and segments left over from an
+ * interrupted rotation are removed. LittleFS must already be mounted.
+ * The timestamp of the newest record is used as base for timestamps until
+ * the system time is set via NTP, so timestamps never run backwards.
+ */
+void HistoryStore::begin() {
+    LittleFS.mkdir(HISTORY_DIR);
+    uint32_t seq;
+    if (!readMeta(seq)) {
+        removeSegments();
+    }
+
+    bool found = false;
+    uint32_t oldest = 0;
+    uint32_t newestEnd = 0;
+    Dir dir = LittleFS.openDir(HISTORY_DIR);
+    while (dir.next()) {
+        uint32_t segment;
+        if (!parseSegment(dir.fileName(), segment)) {
+            continue;
+        }
+        uint32_t end = segment * HISTORY_SEGMENT_RECORDS + dir.fileSize() / HISTORY_RECORD_SIZE;
+        if (!found || segment < oldest) {
+            oldest = segment;
+        }
+        if (!found || end > newestEnd) {
+            newestEnd = end;
+        }
+        found = true;
+    }
+
+    uint32_t segmentStart = seq - seq % HISTORY_SEGMENT_RECORDS;
+    oldestSegment = found ? oldest : seq / HISTORY_SEGMENT_RECORDS;
+    nextSeq = found ? newestEnd : segmentStart;
+    flushedSeq = nextSeq;
+    ready = true;
+    rotate(nextSeq / HISTORY_SEGMENT_RECORDS);
+
+    HistoryRecord newest;
+    if (nextSeq > firstSeq() && read(nextSeq - 1, &newest, 1) == 1) {
+        bootTimestamp = newest.timestamp + 1;
+        lastTimestamp = newest.timestamp;
+    }
+
+    // reservierte, aber nicht geschriebene Sequenznummern als Lücke speichern
+    if (seq > nextSeq) {
+        nextSeq += write(nextSeq, nullptr, seq - nextSeq);
+        flushedSeq = nextSeq;
+        if (nextSeq < seq) {
+            Serial.println("HistoryStore::begin --> FAILED TO WRITE GAP");
+            nextSeq = seq;  // Lücke beim nächsten Schreiben füllen
+            flushedSeq = seq;
+        }
+    }
+    reserve();
+}
+
+/**
+ * @brief Reads the reserved sequence number from the metadata file.
+ *
+ * @param seq Receives the reserved sequence number, 0 for a new history.
+ * @return false if the segments were written with another layout.
+ */
+bool HistoryStore::readMeta(uint32_t& seq) {
+    seq = 0;
+    File file = LittleFS.open(HISTORY_META_FILE, "r");
+    if (!file) {
+        return true;
+    }
+    uint8_t meta[HISTORY_META_SIZE];
+    bool complete = file.read(meta, sizeof(meta)) == sizeof(meta);
+    file.close();
+    if (!complete || getUint32(meta) != HISTORY_MAGIC) {
+        return true;
+    }
+    seq = getUint32(meta + 12);
+    return getUint32(meta + 4) == (HISTORY_VERSION | (HISTORY_RECORD_SIZE << 16)) &&
+           getUint32(meta + 8) == HISTORY_SEGMENT_RECORDS;
+}
+
+/**
+ * @brief Reserves the next HISTORY_RESERVE_RECORDS sequence numbers.
+ *
+ * The metadata is written to a temporary file, which then replaces the
+ * metadata file, so a power loss keeps the previous reservation. Sequence
+ * numbers are only handed out below a persisted reservation.
+ *
+ * @return true if the reservation is saved.
+ */
+bool HistoryStore::reserve() {
+    uint32_t seq = nextSeq + HISTORY_RESERVE_RECORDS;
+    uint8_t meta[HISTORY_META_SIZE];
+    putUint32(meta, HISTORY_MAGIC);
+    putUint32(meta + 4, HISTORY_VERSION | (HISTORY_RECORD_SIZE << 16));
+    putUint32(meta + 8, HISTORY_SEGMENT_RECORDS);
+    putUint32(meta + 12, seq);
+
+    File file = LittleFS.open(HISTORY_META_FILE_TMP, "w");
+    if (!file) {
+        Serial.println("HistoryStore::reserve --> FAILED TO OPEN " HISTORY_META_FILE_TMP);
+        return false;
+    }
+    bool complete = file.write(meta, sizeof(meta)) == sizeof(meta);
+    file.close();
+    metrics.countFlashWrite(FILE_HISTORY, sizeof(meta));
+    if (!complete || !LittleFS.rename(HISTORY_META_FILE_TMP, HISTORY_META_FILE)) {
+        Serial.println("HistoryStore::reserve --> FAILED TO WRITE " HISTORY_META_FILE);
+        return false;
+    }
+    reservedSeq = seq;
+    return true;
+}
+
+/**
+ * @brief Returns the timestamp for a new record.
+ *
+ * Uses the system time once it was set via NTP. Before that, the seconds
+ * since boot are added to the newest stored timestamp and the record is
+ * flagged with HISTORY_FLAG_UPTIME. Timestamps are never smaller than the
+ * previous one, so the history stays sorted and can be searched.
+ *
+ * @param flags Receives the record flags.
+ * @return The timestamp in seconds.
+ */
+uint32_t HistoryStore::timestamp(uint8_t& flags) {
+    uint32_t now = (uint32_t)time(nullptr);
+    flags = 0;
+    if (now < HISTORY_NTP_VALID) {
+        now = bootTimestamp + millis() / 1000;
+        flags |= HISTORY_FLAG_UPTIME;
+    }
+    if (now < lastTimestamp) {
+        now = lastTimestamp;
+    }
+    lastTimestamp = now;
+    return now;
+}
+
+/**
+ * @brief Appends a measurement to the history.
+ *
+ * The record is kept in RAM and written together with the following
+ * records once HISTORY_BLOCK_RECORDS are collected. If the RAM buffer is
+ * still full because writing failed, or no sequence number could be
+ * reserved, the measurement is dropped without using a sequence number.
+ *
+ * @param adc The averaged ADC value.
+ * @param level The displayed level.
+ */
+void HistoryStore::append(uint16_t adc, uint8_t level) {
+    if (!ready) {
+        return;
+    }
+    if (nextSeq - flushedSeq >= HISTORY_BLOCK_RECORDS) {
+        flush();  // nach einem Schreibfehler erneut versuchen
+    }
+    if (nextSeq - flushedSeq >= HISTORY_BLOCK_RECORDS || (nextSeq >= reservedSeq && !reserve())) {
+        Serial.println("HistoryStore::append --> DROPPED");
+        return;
+    }
+    HistoryRecord& record = pending[nextSeq - flushedSeq];
+    record.timestamp = timestamp(record.flags);
+    record.adc = adc;
+    record.level = level;
+    nextSeq++;
+
+    if (nextSeq - flushedSeq >= HISTORY_BLOCK_RECORDS) {
+        flush();
+    }
+}
+
+/**
+ * @brief Appends all records kept in RAM to the segment files.
+ *
+ * Records that could not be written stay in RAM and are written by the
+ * next call. Call this before a restart.
+ */
+void HistoryStore::flush() {
+    if (!ready || nextSeq == flushedSeq) {
+        return;
+    }
+    uint32_t count = nextSeq - flushedSeq;
+    uint32_t done = write(flushedSeq, pending, count);
+    if (done < count) {
+        memmove(pending, pending + done, (count - done) * sizeof(HistoryRecord));
+    }
+    flushedSeq += done;
+}
+
+/**
+ * @brief Appends records to the segment files.
+ *
+ * Every segment is only appended to, so LittleFS rewrites just its last
+ * block. Records the file already holds from an earlier, partly failed
+ * write are skipped, missing records before `seq` are filled with gap
+ * records. Starting a new segment removes the oldest one once the ring
+ * is full.
+ *
+ * @param seq The sequence number of the first record.
+ * @param records The records, nullptr to write gap records.
+ * @param count The number of records.
+ * @return The number of records that are stored, counted from `seq`.
+ */
+uint32_t HistoryStore::write(uint32_t seq, const HistoryRecord* records, uint32_t count) {
+    HistoryRecord gap = {lastTimestamp, 0, 0, HISTORY_FLAG_GAP};
+    uint8_t buffer[HISTORY_BLOCK_RECORDS * HISTORY_RECORD_SIZE];
+    size_t written = 0;
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t segment = (seq + done) / HISTORY_SEGMENT_RECORDS;
+        uint32_t offset = (seq + done) % HISTORY_SEGMENT_RECORDS;
+        uint32_t end = min(offset + (count - done), (uint32_t)HISTORY_SEGMENT_RECORDS);
+        rotate(segment);
+
+        char path[HISTORY_PATH_SIZE];
+        segmentPath(segment, path);
+        File file = LittleFS.open(path, "a");
+        if (!file) {
+            Serial.println("HistoryStore::write --> FAILED TO OPEN SEGMENT");
+            break;
+        }
+        // ein abgebrochenes Schreiben kann einen halben Messwert hinterlassen
+        uint32_t stored = file.size() / HISTORY_RECORD_SIZE;
+        bool ok = file.size() % HISTORY_RECORD_SIZE == 0 || file.truncate(stored * HISTORY_RECORD_SIZE);
+        while (ok && stored < end) {
+            uint32_t n = min(end - stored, (uint32_t)HISTORY_BLOCK_RECORDS);
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t position = stored + i;
+                bool isGap = position < offset || records == nullptr;
+                historyEncode(isGap ? gap : records[done + position - offset], buffer + i * HISTORY_RECORD_SIZE);
+            }
+            ok = file.write(buffer, n * HISTORY_RECORD_SIZE) == n * HISTORY_RECORD_SIZE;
+            if (ok) {
+                stored += n;
+                written += n * HISTORY_RECORD_SIZE;
+            }
+        }
+        file.close();
+        if (!ok) {
+            Serial.println("HistoryStore::write --> FAILED TO WRITE SEGMENT");
+        }
+        if (stored > offset) {
+            done += min(stored, end) - offset;
+        }
+        if (stored < end) {
+            break;
+        }
+    }
+    metrics.countFlashWrite(FILE_HISTORY, written);
+    return done;
+}
+
+/**
+ * @brief Removes the oldest segments before `segment` is started.
+ *
+ * Keeps HISTORY_SEGMENTS segments including the new one, so at least
+ * HISTORY_CAPACITY records stay available.
+ */
+void HistoryStore::rotate(uint32_t segment) {
+    while (segment >= oldestSegment + HISTORY_SEGMENTS) {
+        char path[HISTORY_PATH_SIZE];
+        segmentPath(oldestSegment, path);
+        if (LittleFS.exists(path) && !LittleFS.remove(path)) {
+            Serial.println("HistoryStore::rotate --> FAILED TO REMOVE SEGMENT");
+        }
+        oldestSegment++;
+    }
+}
+
+/**
+ * @brief Removes all segment files.
+ */
+void HistoryStore::removeSegments() {
+    bool removed = true;
+    while (removed) {
+        // Löschen während des Durchlaufs kann Einträge überspringen
+        removed = false;
+        Dir dir = LittleFS.openDir(HISTORY_DIR);
+        while (dir.next()) {
+            uint32_t segment;
+            char path[HISTORY_PATH_SIZE];
+            if (parseSegment(dir.fileName(), segment)) {
+                segmentPath(segment, path);
+                removed |= LittleFS.remove(path);
+            }
+        }
+    }
+}
+
+void HistoryStore::segmentPath(uint32_t segment, char* path) {
+    snprintf(path, HISTORY_PATH_SIZE, HISTORY_DIR "/%lu", (unsigned long)segment);
+}
+
+/**
+ * @brief Parses the segment number from a file name in HISTORY_DIR.
+ *
+ * @return false for files that are no segment, like the metadata.
+ */
+bool HistoryStore::parseSegment(const String& name, uint32_t& segment) {
+    const char* text = name.c_str();
+    char* end;
+    if (!isdigit((unsigned char)text[0])) {
+        return false;
+    }
+    segment = strtoul(text, &end, 10);
+    return *end == '\0';
+}
+
+/**
+ * @brief Returns the sequence number of the oldest stored record.
+ */
+uint32_t HistoryStore::firstSeq() {
+    return min(oldestSegment * HISTORY_SEGMENT_RECORDS, nextSeq);
+}
+
+/**
+ * @brief Returns the sequence number the next record will get.
+ */
+uint32_t HistoryStore::endSeq() {
+    return nextSeq;
+}
+
+/**
+ * @brief Reads consecutive records starting at a sequence number.
+ *
+ * Records still kept in RAM are included. Gap records are returned as
+ * well, so the n-th record has the sequence number seq + n. Sequence
+ * numbers that are already removed or not yet written are not returned.
+ *
+ * @param seq The sequence number of the first record.
+ * @param records Receives the records.
+ * @param maxRecords The maximum number of records to read.
+ * @return The number of records read.
+ */
+size_t HistoryStore::read(uint32_t seq, HistoryRecord* records, size_t maxRecords) {
+    HistoryReader reader(*this);
+    return reader.read(seq, records, maxRecords);
+}
+
+/**
+ * @brief Binary search for the first record at or after a timestamp.
+ *
+ * Gap records carry the timestamp of the record before them, so the
+ * history stays sorted.
+ *
+ * @return The sequence number in [lo, hi], hi if no record in the range matches.
+ */
+uint32_t HistoryStore::search(HistoryReader& reader, uint32_t timestamp, uint32_t lo, uint32_t hi) {
+    HistoryRecord record;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (!reader.readRecord(mid, record)) {
+            return hi;
+        }
+        if (record.timestamp < timestamp) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief Finds the first record at or after a timestamp.
+ *
+ * The records are sorted by timestamp, so a binary search over the
+ * sequence numbers only needs a few single-record reads.
+ *
+ * @param reader The reader for the search, its file stays open.
+ * @param timestamp The timestamp in seconds.
+ * @return The sequence number of the first matching record, or endSeq().
+ */
+uint32_t HistoryStore::lowerBound(HistoryReader& reader, uint32_t timestamp) {
+    return search(reader, timestamp, firstSeq(), nextSeq);
+}
+
+/**
+ * @brief Finds the first record at or after a timestamp, starting at a
+ * known position.
+ *
+ * Probes from `from` with doubling distance and then searches only the
+ * last gap, so a match close to `from` costs a few reads instead of a
+ * search over the whole history.
+ *
+ * @param reader The reader for the search, its file stays open.
+ * @param timestamp The timestamp in seconds.
+ * @param from The first sequence number to consider.
+ * @return The sequence number of the first matching record, or endSeq().
+ */
+uint32_t HistoryStore::lowerBound(HistoryReader& reader, uint32_t timestamp, uint32_t from) {
+    uint32_t lo = max(from, firstSeq());
+    uint32_t hi = nextSeq;
+    uint32_t distance = 1;
+    HistoryRecord record;
+    while (lo < hi) {
+        uint32_t probe = lo + min(distance, hi - lo) - 1;
+        if (!reader.readRecord(probe, record)) {
+            return hi;
+        }
+        if (record.timestamp >= timestamp) {
+            hi = probe;
+            break;
+        }
+        lo = probe + 1;
+        distance *= 2;
+    }
+    return search(reader, timestamp, lo, hi);
+}
+
+// ------------------- HistoryReader -------------------
+
+HistoryReader::HistoryReader(HistoryStore& store) : store(store) {}
+
+/**
+ * @brief Reads consecutive records, see HistoryStore::read().
+ *
+ * Records from flash are read through the segment file kept open from the
+ * previous call.
+ */
+size_t HistoryReader::read(uint32_t seq, HistoryRecord* records, size_t maxRecords) {
+    if (!store.ready || seq < store.firstSeq() || seq >= store.nextSeq) {
+        return 0;
+    }
+    size_t total = min((size_t)(store.nextSeq - seq), maxRecords);
+    size_t done = 0;
+    uint8_t buffer[HISTORY_BLOCK_RECORDS * HISTORY_RECORD_SIZE];
+    while (done < total && seq < store.flushedSeq) {
+        uint32_t count = min((uint32_t)(total - done), store.flushedSeq - seq);
+        count = min(count, (uint32_t)HISTORY_BLOCK_RECORDS);
+        count = min(count, (uint32_t)(HISTORY_SEGMENT_RECORDS - seq % HISTORY_SEGMENT_RECORDS));
+        if (!readSegment(seq, buffer, count)) {
+            return done;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            historyDecode(buffer + i * HISTORY_RECORD_SIZE, records[done++]);
+        }
+        this->records += count;
+        seq += count;
+    }
+    while (done < total) {
+        records[done++] = store.pending[seq - store.flushedSeq];
+        this->records++;
+        seq++;
+    }
+    return done;
+}
+
+/**
+ * @brief Reads a single record.
+ */
+bool HistoryReader::readRecord(uint32_t seq, HistoryRecord& record) {
+    return read(seq, &record, 1) == 1;
+}
+
+/**
+ * @brief Returns the number of records read so far, to limit the work per call.
+ */
+uint32_t HistoryReader::readCount() const {
+    return records;
+}
+
+/**
+ * @brief Reads records of one segment from flash.
+ *
+ * The file is reopened for another segment, and once more if the read
+ * comes up short, because records appended after opening may not be
+ * visible through the open file.
+ */
+bool HistoryReader::readSegment(uint32_t seq, uint8_t* buffer, uint32_t count) {
+    uint32_t index = seq / HISTORY_SEGMENT_RECORDS;
+    uint32_t offset = (seq % HISTORY_SEGMENT_RECORDS) * HISTORY_RECORD_SIZE;
+    size_t size = count * HISTORY_RECORD_SIZE;
+    if (file && segment == index && file.seek(offset, SeekSet) && file.read(buffer, size) == size) {
+        return true;
+    }
+    char path[HISTORY_PATH_SIZE];
+    HistoryStore::segmentPath(index, path);
+    file = LittleFS.open(path, "r");
+    segment = index;
+    return file && file.seek(offset, SeekSet) && file.read(buffer, size) == size;
+}
+
+// ------------------- HistoryStream -------------------
+
+uint8_t HistoryStream::activeStreams = 0;
+
+HistoryStream::HistoryStream(HistoryStore& store, uint32_t from, uint32_t to, uint32_t step, uint32_t points, HistoryFormat format)
+    : store(store), reader(store), to(to), step(step), format(format), points(points) {
+    activeStreams++;
+    seq = store.lowerBound(reader, from);
+    endSeq = store.endSeq();
+    if (points > 0) {
+        // LTTB braucht die Anzahl der Messwerte im Bereich vorab
+        if (to < UINT32_MAX) {
+            endSeq = store.lowerBound(reader, to + 1);
+        }
+        sampler.begin(&reader, seq, endSeq, points);
+    }
+}
+
+HistoryStream::~HistoryStream() {
+    activeStreams--;
+}
+
+/**
+ * @brief Checks whether another download may be started.
+ *
+ * Every stream holds a block buffer, so the number of parallel downloads
+ * is limited to keep the heap usage bounded.
+ */
+bool HistoryStream::available() {
+    return activeStreams < MAX_STREAMS;
+}
+
+/**
+ * @brief Returns the next record of the requested range.
+ *
+ * Reads one block at a time. With a step, the rest of the current block is
+ * scanned for the next due record; if none is found, the position is moved
+ * by a search forward from the current position instead of reading all
+ * skipped records. Gap records are skipped.
+ *
+ * @param record Receives the record.
+ * @return false when the range is exhausted.
+ */
+bool HistoryStream::nextRecord(HistoryRecord& record) {
+    if (points > 0) {
+        while (true) {
+            uint32_t work = reader.readCount() - fillStart;
+            uint32_t budget = work < RECORDS_PER_FILL ? RECORDS_PER_FILL - work : 0;
+            LttbResult result = sampler.next(record, budget);
+            if (result == LTTB_BUSY) {
+                busy = true;
+                return false;
+            }
+            if (result == LTTB_DONE) {
+                return false;
+            }
+            if (!(record.flags & HISTORY_FLAG_GAP)) {
+                return true;
+            }
+        }
+    }
+    while (true) {
+        while (blockPos < blockLen) {
+            record = block[blockPos++];
+            if (record.flags & HISTORY_FLAG_GAP) {
+                continue;
+            }
+            if (record.timestamp > to) {
+                seq = endSeq;
+                blockLen = 0;
+                return false;
+            }
+            if (step == 0 || first || record.timestamp >= nextTimestamp) {
+                return true;
+            }
+        }
+
+        if (step > 0 && !first) {
+            seq = store.lowerBound(reader, nextTimestamp, seq);
+        }
+        if (seq < store.firstSeq()) {
+            seq = store.firstSeq();  // während des Downloads überschrieben
+        }
+        if (seq >= endSeq) {
+            return false;
+        }
+        blockLen = reader.read(seq, block, min((uint32_t)HISTORY_BLOCK_RECORDS, endSeq - seq));
+        blockPos = 0;
+        if (blockLen == 0) {
+            return false;
+        }
+        seq += blockLen;
+    }
+}
+
+/**
+ * @brief Formats a record into the line buffer.
+ */
+void HistoryStream::formatRecord(const HistoryRecord& record) {
+    lineLen = historyFormatRecord(format, record, first, line, sizeof(line));
+}
+
+/**
+ * @brief Fills a response buffer with the next part of the download.
+ *
+ * Called by the chunked response whenever the TCP connection can take more
+ * data, so a slow client simply slows down the reading. Every record read
+ * counts against RECORDS_PER_FILL, including the searches for a step and the
+ * buckets of LTTB, which continue in the next call. So a large step or LTTB
+ * bucket does not block the network stack for long. Returns 0 when the
+ * download is complete, or when the budget ran out before anything was
+ * written; finished() tells the two apart.
+ *
+ * @param buffer The buffer to fill.
+ * @param maxLen The size of the buffer.
+ * @return The number of bytes written.
+ */
+size_t HistoryStream::fill(uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    fillStart = reader.readCount();
+    while (written < maxLen) {
+        if (written > 0 && reader.readCount() - fillStart >= RECORDS_PER_FILL) {
+            break;  // Rest beim nächsten Aufruf
+        }
+        if (linePos < lineLen) {
+            size_t count = min(lineLen - linePos, maxLen - written);
+            memcpy(buffer + written, line + linePos, count);
+            linePos += count;
+            written += count;
+            continue;
+        }
+        linePos = 0;
+        lineLen = 0;
+
+        if (!headerDone) {
+            headerDone = true;
+            if (format == HISTORY_CSV) {
+                lineLen = snprintf(line, sizeof(line), "timestamp,value,adcValue,flags\n");
+            } else if (format == HISTORY_JSON) {
+                lineLen = snprintf(line, sizeof(line), "[");
+            } else if (format == HISTORY_BIN) {
+                // "CLH1", Version, Größe eines Messwerts
+                uint32_t values[2] = {HISTORY_MAGIC, HISTORY_VERSION | (HISTORY_RECORD_SIZE << 16)};
+                for (int i = 0; i < 8; i++) {
+                    line[i] = (values[i / 4] >> (8 * (i % 4))) & 0xFF;
+                }
+                lineLen = 8;
+            }
+            continue;
+        }
+        if (footerDone) {
+            break;
+        }
+
+        HistoryRecord record;
+        if (nextRecord(record)) {
+            formatRecord(record);
+            nextTimestamp = record.timestamp + step;
+            first = false;
+        } else if (busy) {
+            busy = false;
+            break;  // Rest des Buckets beim nächsten Aufruf
+        } else {
+            footerDone = true;
+            if (format == HISTORY_JSON) {
+                lineLen = snprintf(line, sizeof(line), "]");
+            }
+        }
+    }
+    return written;
+}
+
+/**
+ * @brief Returns true once the whole download was written.
+ */
+bool HistoryStream::finished() const {
+    return footerDone && linePos >= lineLen;
+}
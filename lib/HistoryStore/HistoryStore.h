@@ -0,0 +1,160 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include "HistoryFormat.h"
+#include "HistoryRecord.h"
+#include "Lttb.h"
+
+// Anzahl der Messwerte im Ringspeicher (Standard: eine Woche bei 30 Sekunden)
+#ifndef HISTORY_CAPACITY
+#define HISTORY_CAPACITY 20160
+#endif
+
+#define HISTORY_DIR "/history"
+#define HISTORY_META_FILE HISTORY_DIR "/meta"
+#define HISTORY_PATH_SIZE 24
+#define HISTORY_MAGIC 0x31484C43UL  // "CLH1" little-endian
+#define HISTORY_VERSION 1
+#define HISTORY_META_SIZE 16
+#define HISTORY_BLOCK_RECORDS 16     // Messwerte im RAM, bevor in den Flash geschrieben wird
+#define HISTORY_SEGMENT_RECORDS 512  // Messwerte je Segmentdatei (4 KB, ein Flash-Block)
+#define HISTORY_RESERVE_RECORDS 64   // Sequenznummern, die mit einem Schreiben der Metadaten vergeben werden
+
+// Segmente, damit nach dem Löschen des ältesten noch HISTORY_CAPACITY Messwerte da sind
+#define HISTORY_SEGMENTS ((HISTORY_CAPACITY + HISTORY_SEGMENT_RECORDS - 1) / HISTORY_SEGMENT_RECORDS + 1)
+
+class HistoryReader;
+
+/**
+ * Ringspeicher für Messwerte in LittleFS.
+ *
+ * Jeder Messwert bekommt eine fortlaufende Sequenznummer, die auch über
+ * Neustarts erhalten bleibt. Die Messwerte liegen in Segmentdateien mit je
+ * HISTORY_SEGMENT_RECORDS Messwerten (`/history/<seq / 512>`), an die nur
+ * angehängt wird; ist der Ring voll, wird das älteste Segment gelöscht.
+ * LittleFS schreibt so nur den letzten Block einer Datei neu. Neue Messwerte
+ * werden im RAM gesammelt und blockweise geschrieben.
+ *
+ * Sequenznummern werden in `/history/meta` im Voraus reserviert und erst
+ * danach vergeben. Nach einem Reset geht es hinter der Reservierung weiter,
+ * eine Nummer, die MQTT oder der Uplink schon gesendet haben, wird also nie
+ * ein zweites Mal vergeben. Die übersprungenen Nummern werden als Lücke
+ * (HISTORY_FLAG_GAP) gespeichert, damit Position und Sequenznummer gleich
+ * bleiben; Leser überspringen sie.
+ */
+class HistoryStore {
+   public:
+    HistoryStore();
+
+    void begin();
+    void append(uint16_t adc, uint8_t level);
+    void flush();
+
+    uint32_t firstSeq();  // ältester vorhandener Messwert
+    uint32_t endSeq();    // Sequenznummer des nächsten Messwerts
+    size_t read(uint32_t seq, HistoryRecord* records, size_t maxRecords);
+    uint32_t lowerBound(HistoryReader& reader, uint32_t timestamp);  // erster Messwert mit Zeitstempel >= timestamp
+    uint32_t lowerBound(HistoryReader& reader, uint32_t timestamp, uint32_t from);  // dasselbe, gesucht ab from
+
+   private:
+    friend class HistoryReader;
+
+    uint32_t nextSeq = 0;        // Sequenznummer des nächsten Messwerts
+    uint32_t flushedSeq = 0;     // alles davor liegt im Flash
+    uint32_t reservedSeq = 0;    // bis hier in den Metadaten reserviert
+    uint32_t oldestSegment = 0;  // ältestes vorhandenes Segment
+    uint32_t bootTimestamp = 0;  // Basis für Zeitstempel ohne NTP-Zeit
+    uint32_t lastTimestamp = 0;
+    HistoryRecord pending[HISTORY_BLOCK_RECORDS];
+    bool ready = false;
+
+    uint32_t timestamp(uint8_t& flags);
+    bool readMeta(uint32_t& seq);
+    bool reserve();
+    uint32_t write(uint32_t seq, const HistoryRecord* records, uint32_t count);
+    void rotate(uint32_t segment);
+    void removeSegments();
+    static void segmentPath(uint32_t segment, char* path);
+    static bool parseSegment(const String& name, uint32_t& segment);
+    uint32_t search(HistoryReader& reader, uint32_t timestamp, uint32_t lo, uint32_t hi);
+};
+
+/**
+ * Liest Messwerte aus dem HistoryStore und hält dabei das zuletzt gelesene
+ * Segment offen, damit aufeinanderfolgende Lesezugriffe (Suche, Download)
+ * nicht jedes Mal die Datei öffnen.
+ */
+class HistoryReader {
+   public:
+    explicit HistoryReader(HistoryStore& store);
+
+    size_t read(uint32_t seq, HistoryRecord* records, size_t maxRecords);
+    bool readRecord(uint32_t seq, HistoryRecord& record);
+    uint32_t readCount() const;  // bisher gelesene Messwerte
+
+   private:
+    HistoryStore& store;
+    File file;
+    uint32_t segment = UINT32_MAX;  // Segment der offenen Datei
+    uint32_t records = 0;
+
+    bool readSegment(uint32_t seq, uint8_t* buffer, uint32_t count);
+};
+
+/**
+ * Liest einen Zeitbereich aus dem HistoryStore und formatiert ihn
+ * stückweise für eine Chunked-Response. Es wird immer nur ein Block
+ * Messwerte gelesen, der RAM-Bedarf ist also unabhängig vom Zeitbereich.
+ * Mit `points` wird der Bereich per LTTB auf diese Anzahl Punkte reduziert.
+ * Alle Lesezugriffe laufen über einen HistoryReader, die Segmentdatei
+ * bleibt also über alle Aufrufe von fill() offen.
+ */
+class HistoryStream {
+   public:
+    static const uint8_t MAX_STREAMS = 2;           // gleichzeitige Downloads
+    static const uint16_t RECORDS_PER_FILL = 512;   // max. gelesene Messwerte je Aufruf von fill(), inkl. Suche
+
+    HistoryStream(HistoryStore& store, uint32_t from, uint32_t to, uint32_t step, uint32_t points, HistoryFormat format);
+    ~HistoryStream();
+
+    static bool available();
+    size_t fill(uint8_t* buffer, size_t maxLen);
+    bool finished() const;  // fill() liefert 0 auch, wenn das Budget vor der ersten Zeile aufgebraucht ist
+
+   private:
+    static uint8_t activeStreams;
+
+    HistoryStore& store;
+    HistoryReader reader;
+    uint32_t to;
+    uint32_t step;
+    HistoryFormat format;
+
+    uint32_t seq;
+    uint32_t endSeq;
+    uint32_t nextTimestamp = 0;
+    uint32_t points;
+    uint32_t fillStart = 0;  // readCount() zu Beginn von fill()
+    bool busy = false;       // Budget in fill() aufgebraucht
+    bool first = true;
+    bool headerDone = false;
+    bool footerDone = false;
+
+    HistoryRecord block[HISTORY_BLOCK_RECORDS];
+    size_t blockLen = 0;
+    size_t blockPos = 0;
+
+    LttbSampler<HistoryReader> sampler;
+
+    char line[HISTORY_LINE_SIZE];
+    size_t lineLen = 0;
+    size_t linePos = 0;
+
+    bool nextRecord(HistoryRecord& record);
+    void formatRecord(const HistoryRecord& record);
+};
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef LTTB_H
+#define LTTB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "HistoryRecord.h"
+
+enum LttbResult : uint8_t {
+    LTTB_POINT,  // record enthält den nächsten Punkt
+    LTTB_BUSY,   // Budget aufgebraucht, mit neuem Budget erneut aufrufen
+    LTTB_DONE,   // alle Punkte geliefert
+};
+
+/**
+ * Largest-Triangle-Three-Buckets Downsampling über einen Bereich von
+ * Sequenznummern einer Messwert-Quelle.
+ *
+ * Die Quelle muss `size_t read(uint32_t seq, HistoryRecord* records, size_t max)`
+ * anbieten (z.B. HistoryReader). Es werden keine Messwerte zwischengespeichert:
+ * für jeden Ausgabepunkt wird der eigene Bucket und der Durchschnitt des
+ * nächsten Buckets direkt aus der Quelle gelesen. Der Zustand ist damit
+ * konstant, jeder Messwert wird höchstens zweimal gelesen.
+ *
+ * next() liest höchstens so viele Messwerte, wie das übergebene Budget
+ * erlaubt, und macht beim nächsten Aufruf mitten im Bucket weiter. Ein
+ * großer Bucket wird so über mehrere Aufrufe verteilt.
+ *
+ * x ist der Zeitstempel, y der ADC-Wert. Der erste und der letzte Messwert
+ * des Bereichs werden immer übernommen. Lücken (HISTORY_FLAG_GAP) zählen
+ * nicht zum Durchschnitt und werden nur ausgewählt, wenn der Bucket
+ * nichts anderes enthält; der Aufrufer überspringt sie. Enthält der Bereich
+ * nicht mehr Messwerte als angefordert, werden alle Messwerte unverändert
+ * geliefert.
+ */
+template <typename Source>
+class LttbSampler {
+   public:
+    void begin(Source* source, uint32_t first, uint32_t end, uint32_t points) {
+        this->source = source;
+        this->first = first;
+        this->count = end > first ? end - first : 0;
+        this->points = points;
+        emitted = 0;
+        phase = PHASE_IDLE;
+        previous = HistoryRecord();
+    }
+
+    /**
+     * @param record Erhält den nächsten Punkt bei LTTB_POINT.
+     * @param budget Anzahl Messwerte, die gelesen werden dürfen; die
+     *               gelesenen werden abgezogen.
+     */
+    LttbResult next(HistoryRecord& record, uint32_t& budget) {
+        if (count <= points || points < 3) {
+            if (emitted >= count) {
+                return LTTB_DONE;
+            }
+            if (budget == 0) {
+                return LTTB_BUSY;
+            }
+            budget--;
+            if (!readAt(first + emitted, record)) {
+                emitted = count;
+                return LTTB_DONE;
+            }
+            emitted++;
+            return LTTB_POINT;
+        }
+        if (emitted >= points) {
+            return LTTB_DONE;
+        }
+
+        LttbResult result;
+        if (emitted == 0 || emitted == points - 1) {
+            if (budget == 0) {
+                return LTTB_BUSY;
+            }
+            budget--;
+            result = readAt(emitted == 0 ? first : first + count - 1, record) ? LTTB_POINT : LTTB_DONE;
+        } else {
+            result = selectInBucket(emitted, record, budget);
+        }
+        if (result == LTTB_BUSY) {
+            return LTTB_BUSY;
+        }
+        if (result == LTTB_DONE) {
+            emitted = points;
+            return LTTB_DONE;
+        }
+        if (!(record.flags & HISTORY_FLAG_GAP)) {
+            previous = record;
+        }
+        emitted++;
+        return LTTB_POINT;
+    }
+
+   private:
+    static const uint8_t BLOCK = 16;
+
+    enum Phase : uint8_t {
+        PHASE_IDLE,     // nächster Bucket noch nicht begonnen
+        PHASE_AVERAGE,  // Durchschnitt des nächsten Buckets
+        PHASE_SELECT,   // Punkt im eigenen Bucket
+    };
+
+    Source* source = nullptr;
+    uint32_t first = 0;
+    uint32_t count = 0;
+    uint32_t points = 0;
+    uint32_t emitted = 0;
+    HistoryRecord previous;
+
+    // Zwischenstand eines Buckets zwischen zwei Aufrufen
+    Phase phase = PHASE_IDLE;
+    uint32_t seq = 0;
+    double avgX = 0;
+    double avgY = 0;
+    uint32_t values = 0;
+    double maxArea = -1;
+    HistoryRecord selected;
+
+    bool readAt(uint32_t seq, HistoryRecord& record) {
+        return source->read(seq, &record, 1) == 1;
+    }
+
+    // Bucket 1..points-2 teilen sich die Messwerte zwischen erstem und
+    // letztem Messwert, Bucket points-1 ist der letzte Messwert allein.
+    void bucket(uint32_t index, uint32_t& start, uint32_t& stop) {
+        if (index >= points - 1) {
+            start = first + count - 1;
+            stop = first + count;
+            return;
+        }
+        start = first + 1 + (uint32_t)((uint64_t)(index - 1) * (count - 2) / (points - 2));
+        stop = first + 1 + (uint32_t)((uint64_t)index * (count - 2) / (points - 2));
+    }
+
+    // Liest ab seq bis stop, höchstens budget Messwerte; 0 bei einem Lesefehler
+    size_t readBlock(HistoryRecord* block, uint32_t stop, uint32_t& budget) {
+        uint32_t wanted = stop - seq < BLOCK ? stop - seq : BLOCK;
+        wanted = wanted < budget ? wanted : budget;
+        size_t read = source->read(seq, block, wanted);
+        budget -= read;
+        seq += read;
+        return read;
+    }
+
+    LttbResult selectInBucket(uint32_t index, HistoryRecord& record, uint32_t& budget) {
+        HistoryRecord block[BLOCK];
+        uint32_t start, stop;
+
+        if (phase == PHASE_IDLE) {
+            bucket(index + 1, start, stop);
+            seq = start;
+            avgX = 0;
+            avgY = 0;
+            values = 0;
+            phase = PHASE_AVERAGE;
+        }
+
+        if (phase == PHASE_AVERAGE) {
+            // Durchschnitt des nächsten Buckets, x relativ zum vorherigen Punkt
+            bucket(index + 1, start, stop);
+            while (seq < stop) {
+                if (budget == 0) {
+                    return LTTB_BUSY;
+                }
+                size_t read = readBlock(block, stop, budget);
+                if (read == 0) {
+                    phase = PHASE_IDLE;
+                    return LTTB_DONE;
+                }
+                for (size_t i = 0; i < read; i++) {
+                    if (block[i].flags & HISTORY_FLAG_GAP) {
+                        continue;
+                    }
+                    avgX += (double)(int32_t)(block[i].timestamp - previous.timestamp);
+                    avgY += block[i].adc;
+                    values++;
+                }
+            }
+            if (values > 0) {
+                avgX /= values;
+                avgY /= values;
+            } else {
+                avgY = previous.adc;
+            }
+            bucket(index, start, stop);
+            seq = start;
+            maxArea = -1;
+            phase = PHASE_SELECT;
+        }
+
+        // Punkt mit der größten Dreiecksfläche im eigenen Bucket
+        bucket(index, start, stop);
+        double ay = previous.adc;
+        while (seq < stop) {
+            if (budget == 0) {
+                return LTTB_BUSY;
+            }
+            size_t read = readBlock(block, stop, budget);
+            if (read == 0) {
+                phase = PHASE_IDLE;
+                return LTTB_DONE;
+            }
+            for (size_t i = 0; i < read; i++) {
+                if (block[i].flags & HISTORY_FLAG_GAP) {
+                    if (maxArea < 0) {
+                        selected = block[i];  // Bucket bisher nur aus Lücken
+                    }
+                    continue;
+                }
+                double bx = (double)(int32_t)(block[i].timestamp - previous.timestamp);
+                double area = (0 - avgX) * (block[i].adc - ay) - (0 - bx) * (avgY - ay);
+                if (area < 0) {
+                    area = -area;
+                }
+                if (area > maxArea) {
+                    maxArea = area;
+                    selected = block[i];
+                }
+            }
+        }
+        phase = PHASE_IDLE;
+        record = selected;
+        return start < stop ? LTTB_POINT : LTTB_DONE;
+    }
+};
+
+#endif
@@ -1,8 +1,124 @@
 // LEDController.cpp
 #include "LEDController.h"
 
+#include "Metrics.h"
+
+// Lauflicht: die LEDs gehen nacheinander an und von oben wieder aus (100 ms je LED bei 8 LEDs)
+static constexpr Keyframe WIPE_FRAMES[] PROGMEM = {{0, 0, 255}, {800, 255, 255}, {1600, 0, 255}};
+// Alle LEDs leuchten, danach gehen sie von oben nacheinander aus
+static constexpr Keyframe SHUTDOWN_FRAMES[] PROGMEM = {{0, 255, 255}, {800, 255, 255}, {1600, 0, 255}};
+// Gewählter Menüpunkt: 500 ms an, 500 ms aus
+static constexpr Keyframe MENU_BLINK_FRAMES[] PROGMEM = {{0, 255, 255}, {500, 255, 255}, {500, 0, 255}, {1000, 0, 255}};
+// Pegel 0: 1 s an, 3 s aus
+static constexpr Keyframe ALARM_FRAMES[] PROGMEM = {{0, 255, 255}, {1000, 255, 255}, {1000, 0, 255}, {4000, 0, 255}};
+
+#define KEYFRAME_COUNT(frames) (sizeof(frames) / sizeof(Keyframe))
+
+static constexpr Animation WIPE = {WIPE_FRAMES, KEYFRAME_COUNT(WIPE_FRAMES), false};
+static constexpr Animation SHUTDOWN = {SHUTDOWN_FRAMES, KEYFRAME_COUNT(SHUTDOWN_FRAMES), false};
+static constexpr Animation MENU_BLINK = {MENU_BLINK_FRAMES, KEYFRAME_COUNT(MENU_BLINK_FRAMES), true};
+static constexpr Animation ALARM = {ALARM_FRAMES, KEYFRAME_COUNT(ALARM_FRAMES), true};
+
+// Gammakorrektur (2,6): wahrgenommene Helligkeit -> PWM-Wert der LED
+static const uint8_t GAMMA8[256] PROGMEM = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3,
+    3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 5, 6, 6, 6, 6, 7,
+    7, 7, 8, 8, 8, 9, 9, 9, 10, 10, 10, 11, 11, 11, 12, 12,
+    13, 13, 13, 14, 14, 15, 15, 16, 16, 17, 17, 18, 18, 19, 19, 20,
+    20, 21, 21, 22, 22, 23, 24, 24, 25, 25, 26, 27, 27, 28, 29, 29,
+    30, 31, 31, 32, 33, 34, 34, 35, 36, 37, 38, 38, 39, 40, 41, 42,
+    42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57,
+    58, 59, 60, 61, 62, 63, 64, 65, 66, 68, 69, 70, 71, 72, 73, 75,
+    76, 77, 78, 80, 81, 82, 84, 85, 86, 88, 89, 90, 92, 93, 94, 96,
+    97, 99, 100, 102, 103, 105, 106, 108, 109, 111, 112, 114, 115, 117, 119, 120,
+    122, 124, 125, 127, 129, 130, 132, 134, 136, 137, 139, 141, 143, 145, 146, 148,
+    150, 152, 154, 156, 158, 160, 162, 164, 166, 168, 170, 172, 174, 176, 178, 180,
+    182, 184, 186, 188, 191, 193, 195, 197, 199, 202, 204, 206, 209, 211, 213, 215,
+    218, 220, 223, 225, 227, 230, 232, 235, 237, 240, 242, 245, 247, 250, 252, 255,
+};
+
+/**
+ * Stützpunkt des Farbverlaufs der Füllstandsanzeige.
+ */
+struct ColorStop {
+    uint8_t at;  // Füllstand, 255 = voll
+    uint8_t r, g, b;
+};
+
+// Rot bis 1/4, Orange bis 1/2, darüber Grün, mit fließenden Übergängen
+static constexpr ColorStop LEVEL_GRADIENT[] PROGMEM = {
+    {0, 255, 0, 0}, {48, 255, 0, 0}, {80, 255, 165, 0}, {112, 255, 165, 0}, {144, 0, 255, 0}, {255, 0, 255, 0}};
+
+/**
+ * @brief Returns the gamma corrected value of a perceived brightness.
+ */
+static uint8_t gamma8(uint8_t value) {
+    return pgm_read_byte(&GAMMA8[value]);
+}
+
+/**
+ * @brief Returns the color of the level display for a fill of 0 to 255.
+ *
+ * Interpolates between the two neighbouring stops of LEVEL_GRADIENT.
+ */
+static uint32_t levelColor(uint8_t position) {
+    ColorStop from, to;
+    memcpy_P(&to, &LEVEL_GRADIENT[0], sizeof(to));
+    from = to;
+    for (size_t i = 1; i < sizeof(LEVEL_GRADIENT) / sizeof(ColorStop) && to.at < position; i++) {
+        from = to;
+        memcpy_P(&to, &LEVEL_GRADIENT[i], sizeof(to));
+    }
+    if (to.at <= from.at) {
+        return LedStrip::Color(to.r, to.g, to.b);
+    }
+    int32_t span = to.at - from.at;
+    int32_t pos = position - from.at;
+    uint8_t r = from.r + (to.r - from.r) * pos / span;
+    uint8_t g = from.g + (to.g - from.g) * pos / span;
+    uint8_t b = from.b + (to.b - from.b) * pos / span;
+    return LedStrip::Color(r, g, b);
+}
+
+/**
+ * @brief Returns the sum of the three channels of a color.
+ */
+static uint16_t channelTotal(uint32_t color) {
+    return ((color >> 16) & 0xFF) + ((color >> 8) & 0xFF) + (color & 0xFF);
+}
+
+/**
+ * @brief Reads a keyframe from flash.
+ */
+static Keyframe readKeyframe(const Animation& animation, uint8_t index) {
+    Keyframe keyframe;
+    memcpy_P(&keyframe, &animation.frames[index], sizeof(keyframe));
+    return keyframe;
+}
+
+/**
+ * @brief Scales each channel of a color by an intensity of 0 to 255.
+ */
+static uint32_t scaleColor(uint32_t color, uint8_t intensity) {
+    if (intensity == 255) {
+        return color;
+    }
+    uint32_t r = ((color >> 16) & 0xFF) * intensity / 255;
+    uint32_t g = ((color >> 8) & 0xFF) * intensity / 255;
+    uint32_t b = (color & 0xFF) * intensity / 255;
+    return (r << 16) | (g << 8) | b;
+}
+
 LEDController::LEDController(uint8_t pin, uint16_t numLEDs, int brightness)
-    : strip(numLEDs, pin, NEO_GRB + NEO_KHZ800), numLEDs(numLEDs), lastUpdateTime(0), animationActive(false), state(IDLE), currentLED(0) {
+    : strip(numLEDs, pin, NEO_GRB + NEO_KHZ800), numLEDs(numLEDs), frame(new uint32_t[numLEDs]()), pixelMap(new uint16_t[numLEDs]) {
+    for (Layer& layer : layers) {
+        layer.pixels = new uint32_t[numLEDs]();
+    }
+    segments[0] = {0, numLEDs, false};
+    updateMap();
+    targetBrightness = brightness;
     strip.setBrightness(brightness);
     strip.begin();
     strip.show();  // Initialisiert alle LEDs als ausgeschaltet
@@ -62,423 +178,420 @@ int calculateLogBrightness(int brightness) {
  */
 void LEDController::setBrightness(int value) {
     brightness = value;
-    strip.setBrightness(calculateLogBrightness(brightness));
+    uint8_t scaled = calculateLogBrightness(brightness);
+    if (scaled != targetBrightness) {
+        targetBrightness = scaled;
+        dirty = true;
+    }
 }
 
 /**
  * @brief Displays the LED menu indicator.
  *
- * This function clears the LED strip and lights up the first LED with the
- * menu indicator color. It then lights up additional LEDs based on the
- * specified step value, using the menu step color. Finally, it updates
- * the LED strip to show the changes.
+ * This function replaces the menu layer: the first LED is lit with the
+ * menu indicator color, followed by as many LEDs in the menu step color
+ * as the specified step value. A running effect stays on top until it
+ * has finished. In a submenu or on a further page of the menu, the first
+ * LED is white instead of yellow.
  *
  * @param step The menu step value to be represented on the LED strip.
+ * @param level 0 on the first page of the top level.
  */
-void LEDController::menuIndicator(int step) {
-    clear();
-    setPixel(0, colorMenuIndicator);
-    for (int i = 1; i <= step; i++) {
-        setPixel(i, colorMenuStep);
-    }
-    strip.show();
+void LEDController::menuIndicator(int step, uint8_t level) {
+    beginLayer(LAYER_MENU);
+    fillCells(LAYER_MENU, 0, 0, level == 0 ? colorMenuIndicator : colorMenuNested);
+    fillCells(LAYER_MENU, 1, step, colorMenuStep);
+    show();
 }
 
 /**
  * @brief Displays the LED menu value selection.
  *
- * This function clears the LED strip and lights up the first two LEDs with the
- * menu indicator color. It then lights up additional LEDs based on the
- * specified brightness value, using the menu step color. Finally, it updates
- * the LED strip to show the changes.
+ * This function replaces the menu layer: the first two LEDs are lit with
+ * the menu indicator color, followed by as many LEDs in the menu step color
+ * as the specified value.
  *
  * @param brightness The brightness level to be represented on the LED strip.
  */
-
 void LEDController::menuValueSelection(int brightness) {
-    clear();
-    for (int i = 0; i < 2; i++) {
-        setPixel(i, colorMenuIndicator);
-    }
-    for (int i = 1; i <= brightness; i++) {
-        setPixel(1 + i, colorMenuStep);
-    }
-    strip.show();
+    beginLayer(LAYER_MENU);
+    fillCells(LAYER_MENU, 0, 1, colorMenuIndicator);
+    fillCells(LAYER_MENU, 2, brightness + 1, colorMenuStep);
+    show();
 }
 
 /**
  * @brief Activates the menu animation on the LED strip.
  *
- * Sets the current menu step and clears the LEDs.
- * Updates the LED strip to indicate the active menu
- * state, initializing the animation with the specified
- * step. The animation state is set to active, and the
- * LEDs are prepared to visually represent the current
- * menu selection.
+ * Keeps the menu indicator on the first LED and lets the LEDs up to the
+ * current menu step blink until the menu layer is replaced.
  *
  * @param step The current step in the menu to be indicated
  * on the LED strip.
  */
 void LEDController::menuActiveAnimation(int step) {
-    menuStep = step;
-    for (int i = 1; i <= numLEDs; i++) {
-        setPixel(i, 0);
+    beginLayer(LAYER_MENU);
+    fillCells(LAYER_MENU, 0, 0, colorMenuIndicator);
+    play(LAYER_MENU, MENU_BLINK, colorMenuStep, 1, step);
+}
+
+/**
+ * @brief Shows the progress of a calibration.
+ *
+ * The first LED is lit in the menu indicator color, the others fill up in
+ * the apply color with the progress. It stays on top of the menu and the
+ * level display until the next effect or stopAnimation().
+ *
+ * @param percent The progress from 0 to 100.
+ */
+void LEDController::calibrationProgress(uint8_t percent) {
+    beginLayer(LAYER_EFFECT);
+    fillCells(LAYER_EFFECT, 0, 0, colorMenuIndicator);
+    uint8_t lit = min<uint8_t>(percent, 100) * (LED_CELLS - 1) / 100;
+    if (lit > 0) {
+        fillCells(LAYER_EFFECT, 1, lit, colorApply);
     }
-    strip.show();
-    state = MENU_ACTIVE;
-    color = colorMenuStep;
-    lastUpdateTime = millis();
-    animationActive = true;
+    show();
 }
 
 /**
  * @brief Initiates a shutdown animation on the LED strip.
  *
- * This function sets all LEDs to red, indicating a shutdown sequence.
- * It then begins a fade-up animation from the current state. The animation
- * runs in a loop until it is stopped. An optional callback can be provided,
- * which will be invoked when the animation completes.
+ * All LEDs light up red and then go out one after the other from the top.
+ * An optional callback is called once the animation has finished.
  *
  * @param callback An optional callback function that is called after the animation
- * ends. If a callback is provided, it is stored and invoked upon completion.
+ * ends.
  */
 void LEDController::shutdownAnimation(Callback callback) {
-    if (callback) {
-        animationCallback = callback;
-    }
-    uint32_t red = strip.Color(255, 0, 0);
-    currentLED = numLEDs - 1;
-    for (int i = 0; i < numLEDs; i++) {
-        setPixel(i, red);
-    }
-    strip.show();
-    state = FADE_UP;
-    initAnimation(red, std::bind(&LEDController::shutdownAnimation, this, callback));
+    play(LAYER_EFFECT, SHUTDOWN, colorFailure, 0, LED_CELLS, callback);
 }
 
 /**
  * @brief Initiates an apply animation on the LED strip.
  *
- * This function starts an animation that visually indicates an apply action
- * by fading the LEDs up from black to a predefined color and back down.
- * The animation is executed in a loop until it is stopped. An optional callback
- * can be provided, which will be invoked when the animation completes.
+ * The LEDs light up one after the other in the apply color and go out
+ * again from the top. Starting it while another effect runs replaces that
+ * effect without calling its callback.
  *
  * @param callback An optional callback function that is called after the animation
- * ends. If a callback is provided, it is stored and invoked upon completion.
+ * ends.
  */
 void LEDController::applyAnimation(Callback callback) {
-    if (callback) {
-        animationCallback = callback;
-    }
-    state = FADE_UP;
-    initAnimation(colorApply, std::bind(&LEDController::applyAnimation, this, callback));
+    play(LAYER_EFFECT, WIPE, colorApply, 0, LED_CELLS, callback);
 }
 
 /**
  * @brief Starts a success animation on the LED strip.
  *
- * This function is called when a success state is reached, and it initiates
- * an animation on the LED strip to visually indicate the success state to the
- * user. The animation is a fade from black to green and back to black.
+ * Same as the apply animation, but in green.
  *
  * @param callback An optional callback function that is called when the animation
  * is finished.
  */
 void LEDController::successAnimation(Callback callback) {
-    if (callback) {
-        animationCallback = callback;
-    }
-    state = FADE_UP;
-    initAnimation(colorSuccess, std::bind(&LEDController::applyAnimation, this, callback));
+    play(LAYER_EFFECT, WIPE, colorSuccess, 0, LED_CELLS, callback);
 }
 
 /**
- * @brief Starts the default animation loop.
- *
- * This function starts the default animation loop by calling initAnimation
- * with the default color and a callback to itself. This creates an infinite
- * animation loop that fades the LED strip up and down.
+ * @brief Plays the start animation once.
  */
 void LEDController::startAnimation() {
-    state = FADE_UP;
-    initAnimation(strip.Color(185, 50, 255), std::bind(&LEDController::startAnimation, this));
+    play(LAYER_EFFECT, WIPE, colorApply, 0, LED_CELLS);
 }
 
 /**
- * @brief Animates a red blinking animation to visually indicate a failure state.
- *
- * This function is called when a failure occurs, and it initiates
- * an animation on the LED strip to visually indicate a failure state
- * to the user.
+ * @brief Plays the apply animation in red to indicate a failure.
  */
 void LEDController::failureAnimation() {
-    state = FADE_UP;
-    initAnimation(strip.Color(255, 0, 0), std::bind(&LEDController::failureAnimation, this));
+    play(LAYER_EFFECT, WIPE, colorFailure, 0, LED_CELLS);
 }
 
 /**
- * @brief Initiates a red blinking animation for the first LED.
+ * @brief Lets the first LED blink red to indicate level 0.
  *
- * This function sets the first LED to red and begins a blinking animation.
- * It updates the animation state to BLINK_FIRST and sets the active color
- * to red, activating the animation sequence.
+ * The LED is on for 1 second and off for 3 seconds. Calling this again
+ * while it blinks does not restart the blinking.
  */
-
 void LEDController::blinkRed() {
-    setPixel(0, color);  // LED an
-    state = BLINK_FIRST;
-    color = strip.Color(255, 0, 0);
-    animationActive = true;
+    if (layers[LAYER_LEVEL].animation == &ALARM) {
+        return;
+    }
+    beginLayer(LAYER_LEVEL);
+    play(LAYER_LEVEL, ALARM, colorFailure, 0, 1);
 }
 
 /**
- * @brief Updates the LED animation state.
+ * @brief Stops the running effect without calling its callback.
  *
- * This function is responsible for updating the current animation
- * of the LED strip by calling the animation update routine. It
- * ensures that the LED animations are continuously refreshed
- * based on the current state.
+ * The menu or level display below becomes visible again.
  */
-void LEDController::updateAnimation() {
-    if (!animationActive) return;
+void LEDController::stopAnimation() {
+    clearLayer(LAYER_EFFECT);
+    show();
+}
 
-    currentTime = millis();
+/**
+ * @brief Removes the menu display.
+ *
+ * A running effect stays on top, the level display below becomes visible
+ * again.
+ */
+void LEDController::clearMenu() {
+    clearLayer(LAYER_MENU);
+    show();
+}
 
-    switch (state) {
-        case FADE_UP:
-            fadeUp();
-            break;
-        case FADE_DOWN:
-            fadeDown();
-            break;
-        case BLINK_FIRST:
-            blinkFirstLED();
-            break;
-        case MENU_ACTIVE:
-            blinkMenu();
-            break;
-        case BLINK_RED_2500:
-            blink(0, numLEDs, 100, 2500);
-            break;
-        case IDLE:
-            // Nichts tun, während IDLE
-            break;
+/**
+ * @brief Clears the LED strip.
+ *
+ * This function stops the running effect and removes the menu and level
+ * display, so all LEDs go out.
+ */
+void LEDController::clear() {
+    for (uint8_t id = 0; id < LAYER_COUNT; id++) {
+        clearLayer((LayerId)id);
     }
+    show();
 }
 
 /**
- * @brief Flashes the LEDs between `startLED` and `endLED` with the duration `time` and the total duration `timeTotal`.
+ * @brief Updates the LED strip based on the specified level.
  *
- * `time` specifies the duration for which the LEDs are to be on or off.
- * `timeTotal` specifies the total duration after which the animation is completed.
- * If `timeTotal` is greater than 0, the animation is ended after `timeTotal` milliseconds have elapsed and the `animationCallback` callback is called.
+ * This function replaces the level display; menus and effects stay on top
+ * of it. Only the LEDs that differ from the current display are changed,
+ * so an unchanged level does not update the strip at all. It sets the color
+ * of the LEDs up to the specified level, with different
+ * colors indicating different levels. The colors are defined as follows:
+ * - Level 0: Magenta
+ * - Level 1: Red
+ * - Level 2 and 3: Orange
+ * - Level 4 and above: Green
  *
- * Calling this function starts the animation and the LEDs flash until the animation ends.
+ * @param level The level up to which the LEDs should be lit, influencing the color.
  */
-void LEDController::blink(int startLED, int endLED, uint32_t time, uint32_t timeTotal) {
-    static bool blinkOn = true;  // LED-Zustand verfolgen
+void LEDController::updateLEDs(int level) {
+    uint32_t color = strip.Color(0, 255, 0);
 
-    if (blinkOn && (currentTime - lastUpdateTime >= time)) {
-        // Wenn die LED an ist und die Zeit für "an" abgelaufen ist
-        for (int i = startLED; i <= endLED; i++) {
-            setPixel(i, color);
-        }
-        strip.show();
-        lastUpdateTime = currentTime;  // Zeitstempel aktualisieren
-        blinkOn = false;               // Zustand wechseln
-    } else if (!blinkOn && (currentTime - lastUpdateTime >= time)) {
-        // Wenn die LED aus ist und die Zeit für "aus" abgelaufen ist
-        for (int i = startLED; i <= endLED; i++) {
-            setPixel(i, 0);
-        }
-        strip.show();
-        lastUpdateTime = currentTime;  // Zeitstempel aktualisieren
-        blinkOn = true;                // Zustand wechseln
-    }
-    if (timeTotal > 0) {
-        if (currentTime - animationStartTime >= timeTotal) {
-            stopAnimation();
-            if (animationCallback) {
-                animationCallback();
-            }
-        }
+    if (level == 0) {
+        color = strip.Color(255, 0, 255);
+    } else if (level < 2) {
+        color = strip.Color(255, 0, 0);
+    } else if (level < 4) {
+        color = strip.Color(255, 165, 0);
     }
+
+    beginLayer(LAYER_LEVEL);
+    fillCells(LAYER_LEVEL, 0, level, color);
+    show();
 }
 
 /**
- * @brief Blinks the LEDs representing the active menu.
+ * @brief Shows the fill level with a resolution finer than one LED.
+ *
+ * The first LED is always lit; the bar grows with the fill up to the whole
+ * strip. The LED at the end of the bar is lit with a gamma corrected part
+ * of the color, so the bar moves smoothly instead of in steps of one LED.
+ * The color follows a gradient from red (empty) over orange to green.
  *
- * This function triggers a blinking animation for the LEDs
- * from the second LED up to the current menu step, providing
- * a visual indicator for the active menu state.
+ * @param fill The fill level from 0 (empty) to 65535 (full).
  */
-void LEDController::blinkMenu() {
-    blink(1, menuStep, 500);
+void LEDController::updateFill(uint16_t fill) {
+    uint32_t color = levelColor(fill >> 8);
+    beginLayer(LAYER_LEVEL);
+    uint32_t* pixels = layers[LAYER_LEVEL].pixels;
+    for (uint8_t s = 0; s < segmentCount; s++) {
+        const Segment& segment = segments[s];
+        // Länge des Balkens in 1/256 LED
+        uint32_t length = 256 + (uint32_t)fill * (segment.count - 1) * 256 / 65535;
+        uint16_t full = length >> 8;
+        uint8_t part = length & 0xFF;
+        for (uint16_t i = 0; i < full; i++) {
+            pixels[segment.first + i] = color;
+        }
+        if (part > 0) {
+            pixels[segment.first + full] = scaleColor(color, gamma8(part));
+        }
+    }
+    show();
 }
 
 /**
- * Fades in the LEDs in the strip by turning them on one by one.
+ * @brief Starts an animation on a layer.
+ *
+ * Replaces a running animation of the layer without calling its callback;
+ * the fixed colors of the layer are kept.
  *
- * This function is part of the animation loop and is called repeatedly
- * by the LEDController. It checks if it is time to turn on the next LED
- * and if so, turns it on. The function also keeps track of the current
- * LED and checks if all LEDs have been turned on. If so, it switches to
- * the FADE_DOWN state.
+ * @param id The layer.
+ * @param animation The keyframe table to play.
+ * @param color The color at full intensity.
+ * @param first The first cell of the animated range.
+ * @param count The number of cells in the animated range.
+ * @param done Called from update() once a non-looping animation has ended.
  */
-void LEDController::fadeUp() {
-    // Überprüft, ob es Zeit ist, die nächste LED einzuschalten
-    if (currentTime - lastUpdateTime >= 100) {
-        setPixel(currentLED, color);  // Schaltet die aktuelle LED ein
-        strip.show();
-        currentLED++;
+void LEDController::play(LayerId id, const Animation& animation, uint32_t color, uint16_t first, uint16_t count, Callback done) {
+    Layer& layer = layers[id];
+    layer.animation = &animation;
+    layer.color = color;
+    layer.first = first;
+    layer.count = first < LED_CELLS ? min<uint16_t>(count, LED_CELLS - first) : 0;
+    layer.startedAt = millis();
+    layer.cursor = 0;
+    layer.done = done;
+    layer.active = true;
+    show();
+}
 
-        lastUpdateTime = currentTime;  // Setzt den Timer für den nächsten Schritt zurück
+/**
+ * @brief Clears a layer and activates it for drawing fixed colors.
+ */
+void LEDController::beginLayer(LayerId id) {
+    clearLayer(id);
+    layers[id].active = true;
+}
 
-        // Wenn alle LEDs eingeschaltet sind, wechselt zu TURN_OFF
-        if (currentLED >= numLEDs) {
-            state = FADE_DOWN;
-            currentLED = numLEDs - 1;   // Beginnt von der letzten LED zum Ausschalten
-            lastUpdateTime = millis();  // Setzt den Timer für das Ausschalten zurück
+/**
+ * @brief Sets the fixed color of the cells from `from` to `to` in every segment.
+ */
+void LEDController::fillCells(LayerId id, uint8_t from, uint8_t to, uint32_t color) {
+    for (uint8_t s = 0; s < segmentCount; s++) {
+        uint16_t end = cellStart(segments[s], to + 1);
+        for (uint16_t i = cellStart(segments[s], from); i < end; i++) {
+            layers[id].pixels[i] = color;
         }
     }
 }
 
 /**
- * Fades out the LEDs in the strip by turning them off one by one.
+ * @brief Returns the first LED of a cell of a segment.
  *
- * This function is part of the animation loop and is called repeatedly
- * by the LEDController. It checks if it is time to turn off the next LED
- * and if so, turns it off. The function also keeps track of the current
- * LED and checks if all LEDs have been turned off. If so, it stops the
- * animation and calls the callback function if provided.
+ * A segment is divided into LED_CELLS cells of (almost) equal length, so
+ * the menu and the level display scale with the segment.
  */
-void LEDController::fadeDown() {
-    // Überprüft, ob es Zeit ist, die nächste LED auszuschalten
-    if (currentTime - lastUpdateTime >= 100) {
-        setPixel(currentLED, 0);  // Schaltet die aktuelle LED aus
-        strip.show();
-        currentLED--;
-
-        lastUpdateTime = currentTime;  // Setzt den Timer für den nächsten Schritt zurück
-
-        // Wenn alle LEDs aus sind, wird die Animation beendet
-        if (currentLED < 0) {
-            stopAnimation();
-            if (animationCallback) {
-                animationCallback();
-            }
-        }
-    }
+uint16_t LEDController::cellStart(const Segment& segment, uint16_t cell) {
+    return segment.first + (uint32_t)min<uint16_t>(cell, LED_CELLS) * segment.count / LED_CELLS;
 }
 
 /**
- * @brief Initializes an animation with the given color and callback.
- *
- * This function starts a new animation with the given color and an optional callback.
- * If the animation is already active, it stops the current animation and calls the
- * given callback before starting the new animation.
- *
- * @param colorValue The color value to use for the animation. This is an RGB
- * value in the format 0x00RRGGBB.
- * @param callback A callback function to be called when the animation is started.
- * If no callback is given, the function does nothing.
+ * @brief Deactivates a layer without calling its callback.
  */
-void LEDController::initAnimation(uint32_t colorValue, Callback callback) {
-    if (!animationActive) {
-        color = colorValue;
-        animationActive = true;
-        currentLED = 0;             // Setzt den Startpunkt auf die erste LED
-        lastUpdateTime = millis();  // Setzt den Startzeitpunkt für die Animation
-    } else {
-        stopAnimation();
-        if (callback) callback();
+void LEDController::clearLayer(LayerId id) {
+    Layer& layer = layers[id];
+    for (uint16_t i = 0; i < numLEDs; i++) {
+        layer.pixels[i] = 0;
     }
+    layer.animation = nullptr;
+    layer.done = nullptr;
+    layer.active = false;
 }
 
 /**
- * @brief Stops the current animation and clears the LED strip.
+ * @brief Moves the animation of a layer to the keyframe for the given time.
  *
- * This function immediately stops the current animation and resets the
- * animation state to IDLE. It also clears the LED strip and turns off all LEDs.
+ * Looping animations start over, a finished animation deactivates its
+ * layer and queues its callback.
  */
-void LEDController::stopAnimation() {
-    animationActive = false;
-    state = IDLE;
-    strip.clear();
-    strip.show();  // Stellt sicher, dass alle LEDs ausgeschaltet sind
+void LEDController::advance(LayerId id, uint32_t now) {
+    Layer& layer = layers[id];
+    if (!layer.active || layer.animation == nullptr) {
+        return;
+    }
+    const Animation& animation = *layer.animation;
+    uint32_t elapsed = now - layer.startedAt;
+    uint16_t duration = readKeyframe(animation, animation.count - 1).at;
+    if (elapsed >= duration) {
+        if (!animation.loop || duration == 0) {
+            Callback done = layer.done;
+            clearLayer(id);
+            queueEvent(done);
+            return;
+        }
+        layer.startedAt += elapsed - elapsed % duration;
+        layer.cursor = 0;
+        elapsed %= duration;
+    }
+    while (layer.cursor + 1 < animation.count && readKeyframe(animation, layer.cursor + 1).at <= elapsed) {
+        layer.cursor++;
+    }
 }
 
 /**
- * @brief Clears the LED strip.
- *
- * This function deactivates any active animations and sets all LEDs to black, effectively clearing the strip.
+ * @brief Queues the callback of a finished animation for update().
  */
-void LEDController::clear() {
-    stopAnimation();
-    for (int i = 0; i <= numLEDs; i++) {
-        setPixel(i, 0);
+void LEDController::queueEvent(Callback callback) {
+    if (!callback) {
+        return;
     }
-    strip.show();
+    if (eventCount >= LED_EVENT_QUEUE_SIZE) {
+        Serial.println("LEDController::queueEvent --> QUEUE FULL");
+        return;
+    }
+    events[(eventHead + eventCount) % LED_EVENT_QUEUE_SIZE] = callback;
+    eventCount++;
 }
 
 /**
- * @brief Updates the LED strip based on the specified level.
- *
- * This function deactivates any active animations and clears the LED strip.
- * It sets the color of the LEDs up to the specified level, with different
- * colors indicating different levels. The colors are defined as follows:
- * - Level 0: Magenta
- * - Level 1: Red
- * - Level 2 and 3: Orange
- * - Level 4 and above: Green
+ * @brief Calls the callbacks of the finished animations in order.
  *
- * @param level The level up to which the LEDs should be lit, influencing the color.
+ * The callbacks may start new animations or draw menus; this is shown in
+ * the same update().
  */
-void LEDController::updateLEDs(int level) {
-    animationActive = false;
-    strip.clear();
-    int color = strip.Color(0, 255, 0);
-
-    if (level == 0) {
-        color = strip.Color(255, 0, 255);
-    } else if (level < 2) {
-        color = strip.Color(255, 0, 0);
-    } else if (level < 4) {
-        color = strip.Color(255, 165, 0);
-    }
-
-    for (int i = 0; i <= level; i++) {
-        setPixel(i, color);
+void LEDController::dispatchEvents() {
+    while (eventCount > 0) {
+        Callback callback = events[eventHead];
+        events[eventHead] = nullptr;
+        eventHead = (eventHead + 1) % LED_EVENT_QUEUE_SIZE;
+        eventCount--;
+        callback();
     }
-
-    strip.show();
 }
 
 /**
- * @brief Toggles the first LED on and off at specified intervals.
+ * @brief Draws the topmost active layer into the framebuffer.
  *
- * This function manages the blinking of the first LED in the strip. When
- * the LED is on, it remains lit for 1 second. When off, it stays off for
- * 3 seconds. The toggle is controlled by the elapsed time since the last
- * update. The function uses a static variable to keep track of the LED state
- * between calls.
+ * The fixed colors are drawn first, then the animated range: the fill and
+ * intensity are interpolated between the current and the next keyframe.
+ * The cost does not depend on the animation.
  */
-void LEDController::blinkFirstLED() {
-    static bool ledOn = true;  // LED-Zustand verfolgen
+void LEDController::render(uint32_t now) {
+    int top = LAYER_COUNT - 1;
+    while (top >= 0 && !layers[top].active) {
+        top--;
+    }
+    if (top < 0) {
+        clearFrame();
+        return;
+    }
+    const Layer& layer = layers[top];
+    for (uint16_t i = 0; i < numLEDs; i++) {
+        setPixel(i, layer.pixels[i]);
+    }
+    if (layer.animation == nullptr) {
+        return;
+    }
 
-    if (ledOn && (currentTime - lastUpdateTime >= 1000)) {
-        // Wenn die LED an ist und die Zeit für "an" abgelaufen ist
-        setPixel(0, 0);  // LED aus
-        strip.show();
-        lastUpdateTime = currentTime;  // Zeitstempel aktualisieren
-        ledOn = false;                 // Zustand wechseln
-    } else if (!ledOn && (currentTime - lastUpdateTime >= 3000)) {
-        // Wenn die LED aus ist und die Zeit für "aus" abgelaufen ist
-        setPixel(0, color);  // LED an
-        strip.show();
-        lastUpdateTime = currentTime;  // Zeitstempel aktualisieren
-        ledOn = true;                  // Zustand wechseln
+    const Animation& animation = *layer.animation;
+    Keyframe from = readKeyframe(animation, layer.cursor);
+    Keyframe to = layer.cursor + 1 < animation.count ? readKeyframe(animation, layer.cursor + 1) : from;
+    // Füllstand und Helligkeit in 1/256, damit das Lauflicht gleichmäßig weiterläuft
+    int32_t fill = from.fill * 256;
+    int32_t intensity = from.intensity * 256;
+    uint32_t elapsed = now - layer.startedAt;
+    if (to.at > from.at && elapsed > from.at) {
+        int32_t span = to.at - from.at;
+        int32_t pos = min<int32_t>(elapsed - from.at, span);
+        fill += (int64_t)(to.fill - from.fill) * 256 * pos / span;
+        intensity += (int64_t)(to.intensity - from.intensity) * 256 * pos / span;
+    }
+
+    uint32_t color = scaleColor(layer.color, gamma8(intensity / 256));
+    for (uint8_t s = 0; s < segmentCount; s++) {
+        uint16_t first = cellStart(segments[s], layer.first);
+        uint16_t count = cellStart(segments[s], layer.first + layer.count) - first;
+        uint16_t lit = (uint32_t)fill * count / (255 * 256);
+        for (uint16_t i = 0; i < count; i++) {
+            setPixel(first + i, i < lit ? color : 0);
+        }
     }
 }
 
@@ -492,20 +605,75 @@ void LEDController::blinkFirstLED() {
  */
 void LEDController::setUpsideDown(bool value) {
     upsideDown = value;
+    updateMap();
+}
+
+/**
+ * @brief Divides the strip into segments that each show the displays.
+ *
+ * The first call replaces the default segment covering the whole strip;
+ * each further segment follows the previous one. LEDs behind the last
+ * segment stay off.
+ *
+ * @param count The number of LEDs of the segment.
+ * @param reversed true if the segment is mounted the other way round.
+ * @return false if there are too many segments or LEDs.
+ */
+bool LEDController::addSegment(uint16_t count, bool reversed) {
+    if (!customSegments) {
+        segmentCount = 0;
+    }
+    uint16_t first = segmentCount > 0 ? segments[segmentCount - 1].first + segments[segmentCount - 1].count : 0;
+    if (segmentCount >= LED_MAX_SEGMENTS || count == 0 || count > numLEDs - first) {
+        if (segmentCount == 0) {
+            segmentCount = 1;  // die Standardaufteilung bleibt
+        }
+        return false;
+    }
+    customSegments = true;
+    segments[segmentCount++] = {first, count, reversed};
+    updateMap();
+    return true;
+}
+
+/**
+ * @brief Returns the heap used for the pixel buffers, including the strip.
+ */
+size_t LEDController::heapUsage() {
+    size_t perLED = sizeof(*frame) + sizeof(*pixelMap) + LAYER_COUNT * sizeof(*layers[0].pixels) + LED_STRIP_BYTES_PER_LED;
+    return numLEDs * perLED;
+}
+
+/**
+ * @brief Computes the LED on the strip for every LED of the segments.
+ *
+ * Done once when the segments or the orientation change, so drawing only
+ * needs a table lookup per LED.
+ */
+void LEDController::updateMap() {
+    for (uint16_t i = 0; i < numLEDs; i++) {
+        pixelMap[i] = i;
+    }
+    for (uint8_t s = 0; s < segmentCount; s++) {
+        const Segment& segment = segments[s];
+        bool flip = segment.reversed != upsideDown;
+        for (uint16_t i = 0; i < segment.count; i++) {
+            pixelMap[segment.first + i] = segment.first + (flip ? segment.count - 1 - i : i);
+        }
+    }
 }
 
 /**
  * @brief Maps an LED index to the actual index on the strip.
  *
- * Depending on the current upside-down state of the strip, this
- * function either returns the index as-is or calculates the mirrored
- * index on the strip.
+ * Looks the index up in the table built by updateMap() from the segments
+ * and the upside-down state.
  *
  * @param idx The index to be mapped.
  * @return The mapped index.
  */
 uint16_t LEDController::mapIndex(uint16_t idx) {
-    return upsideDown ? (numLEDs - 1 - idx) : idx;
+    return pixelMap[idx];
 }
 
 /**
@@ -519,7 +687,91 @@ uint16_t LEDController::mapIndex(uint16_t idx) {
  * @param c   The color to set the LED to.
  */
 void LEDController::setPixel(uint16_t idx, uint32_t c) {
-    strip.setPixelColor(mapIndex(idx), c);
+    if (idx >= numLEDs) {
+        return;
+    }
+    uint16_t pixel = mapIndex(idx);
+    if (frame[pixel] != c) {
+        channelSum = channelSum - channelTotal(frame[pixel]) + channelTotal(c);
+        frame[pixel] = c;
+        dirty = true;
+    }
+}
+
+/**
+ * @brief Turns all LEDs off in the framebuffer.
+ */
+void LEDController::clearFrame() {
+    for (uint16_t i = 0; i < numLEDs; i++) {
+        setPixel(i, 0);
+    }
+}
+
+/**
+ * @brief Requests the framebuffer to be shown.
+ *
+ * The strip itself is only written in commit(), at most once per update().
+ */
+void LEDController::show() {
+    showRequests++;
+}
+
+/**
+ * @brief Writes the framebuffer to the strip if it changed.
+ *
+ * Writing a WS2812 strip disables interrupts for the whole transfer, which
+ * disturbs WiFi and timers. Therefore the strip is only written once per
+ * update() and only if a pixel or the brightness changed since the last
+ * write; all other requests are counted as suppressed. While the strip is
+ * still busy with the previous frame, the write is postponed instead of
+ * waiting for it.
+ */
+void LEDController::commit() {
+    if (dirty && !strip.canShow()) {
+        return;  // der vorige Frame ist noch nicht übernommen, nächster Versuch im nächsten update()
+    }
+    if (dirty) {
+        strip.setBrightness(limitBrightness(targetBrightness));
+        for (uint16_t i = 0; i < numLEDs; i++) {
+            strip.setPixelColor(i, frame[i]);
+        }
+        strip.show();
+        dirty = false;
+        metrics.ledShows++;
+        if (showRequests > 0) {
+            showRequests--;
+        }
+    }
+    metrics.ledShowsSuppressed += showRequests;
+    showRequests = 0;
+}
+
+/**
+ * @brief Reduces the brightness so the frame stays within the current budget.
+ *
+ * The current is estimated from the sum of all color channels, which
+ * setPixel() keeps up to date, so this does not depend on the strip length.
+ * Each channel draws up to LED_MA_PER_CHANNEL at full brightness, and each
+ * LED LED_IDLE_MA in addition.
+ *
+ * @param value The brightness without the limit.
+ * @return The highest brightness up to `value` within LED_CURRENT_BUDGET_MA.
+ */
+uint8_t LEDController::limitBrightness(uint8_t value) {
+    uint32_t idle = (uint32_t)numLEDs * LED_IDLE_MA;
+    // Der Strip skaliert jeden Kanal mit (Helligkeit + 1) / 256
+    uint64_t perStep = (uint64_t)channelSum * LED_MA_PER_CHANNEL;
+    uint32_t current = idle + perStep * (value + 1) / (255 * 256);
+    uint8_t applied = value;
+    if (LED_CURRENT_BUDGET_MA > 0 && current > LED_CURRENT_BUDGET_MA) {
+        uint32_t steps = LED_CURRENT_BUDGET_MA > idle ? (uint64_t)(LED_CURRENT_BUDGET_MA - idle) * 255 * 256 / perStep : 0;
+        applied = steps > 0 ? min<uint32_t>(steps - 1, value) : 0;
+        current = idle + perStep * (applied + 1) / (255 * 256);
+        metrics.ledLimitedFrames++;
+    }
+    metrics.ledCurrentMilliAmps = current;
+    metrics.ledBrightnessApplied = applied;
+    return applied;
 }
 
 /**
@@ -537,11 +789,18 @@ bool LEDController::isUpsideDown() {
 /**
  * @brief Updates the LED animation state.
  *
- * This function is responsible for updating the current animation
- * of the LED strip by calling the animation update routine. It
- * ensures that the LED animations are continuously refreshed
- * based on the current state.
+ * Advances the animations of all layers, calls the callbacks of the
+ * animations that have finished and draws the topmost layer. All changes
+ * made since the last call are shown together at the end.
  */
 void LEDController::update() {
-    updateAnimation();
+    uint32_t now = millis();
+    metrics.ledHeapBytes = heapUsage();
+    metrics.ledCurrentBudgetMilliAmps = LED_CURRENT_BUDGET_MA;
+    for (uint8_t id = 0; id < LAYER_COUNT; id++) {
+        advance((LayerId)id, now);
+    }
+    dispatchEvents();
+    render(millis());  // die Callbacks können Animationen gestartet haben
+    commit();
 }
\ No newline at end of file
@@ -1,5 +1,64 @@
 #include <Adafruit_NeoPixel.h>
 
+// Mit -D LED_BACKEND_UART1 werden die LEDs über UART1 statt per Bit-Banging angesteuert
+#ifdef LED_BACKEND_UART1
+#include "Ws2812Uart1.h"
+using LedStrip = Ws2812Uart1;
+#define LED_STRIP_BYTES_PER_LED 15  // GRB und kodierter Frame
+#else
+using LedStrip = Adafruit_NeoPixel;
+#define LED_STRIP_BYTES_PER_LED 3
+#endif
+
+// Maximale Anzahl der Segmente, z. B. ein Segment je Tank
+#ifndef LED_MAX_SEGMENTS
+#define LED_MAX_SEGMENTS 4
+#endif
+// Zellen je Segment: Menü und Anzeigen sind für 8 LEDs entworfen und werden auf die Segmentlänge gestreckt
+#define LED_CELLS 8
+
+// Strombudget der LEDs in mA, darüber wird die Helligkeit reduziert (0 = keine Grenze)
+#ifndef LED_CURRENT_BUDGET_MA
+#define LED_CURRENT_BUDGET_MA 400
+#endif
+// Strom je Farbkanal bei voller Helligkeit und Ruhestrom je LED (WS2812B)
+#ifndef LED_MA_PER_CHANNEL
+#define LED_MA_PER_CHANNEL 20
+#endif
+#ifndef LED_IDLE_MA
+#define LED_IDLE_MA 1
+#endif
+
+// 1: Füllstand mit Teilhelligkeit der letzten LED und Farbverlauf (updateFill), 0: ganze LEDs (updateLEDs)
+#ifndef LED_FRACTIONAL_LEVEL
+#define LED_FRACTIONAL_LEVEL 1
+#endif
+
+// Anzahl der Abschluss-Ereignisse, die bis zum nächsten update() warten können
+#ifndef LED_EVENT_QUEUE_SIZE
+#define LED_EVENT_QUEUE_SIZE 4
+#endif
+
+/**
+ * Stützpunkt einer Animation. Zwischen zwei Stützpunkten wird linear
+ * interpoliert; zwei Stützpunkte mit derselben Zeit ergeben einen Sprung.
+ */
+struct Keyframe {
+    uint16_t at;        // ms seit Beginn der Animation
+    uint8_t fill;       // Anteil der leuchtenden LEDs im Bereich, 255 = alle
+    uint8_t intensity;  // Helligkeit der Farbe, 255 = volle Farbe
+};
+
+/**
+ * Animation aus einer Stützpunkt-Tabelle im Flash. Die Dauer ist die Zeit
+ * des letzten Stützpunkts.
+ */
+struct Animation {
+    const Keyframe* frames;
+    uint8_t count;
+    bool loop;
+};
+
 class LEDController {
    public:
     // Typdefinition für Callback-Funktionen
@@ -14,52 +73,97 @@ class LEDController {
     void failureAnimation();
     void update();
     void stopAnimation();
-	void shutdownAnimation(Callback callback = nullptr);
-	void menuIndicator(int step);			// indicating the current menu step
-	void menuValueSelection(int value);	// indicating the current brightness
-	void menuActiveAnimation(int step);		// indicating the current menu step
+    void shutdownAnimation(Callback callback = nullptr);
+    void menuIndicator(int step, uint8_t level = 0);  // indicating the current menu step, level > 0 in submenus and on further pages
+    void menuValueSelection(int value);  // indicating the current brightness
+    void menuActiveAnimation(int step);  // indicating the current menu step
+    void calibrationProgress(uint8_t percent);
     void clear();
+    void clearMenu();  // nur die Menü-Ebene, die Füllstandsanzeige bleibt
     void blinkRed();
     void updateLEDs(int level);
+    void updateFill(uint16_t fill);
 
     void setUpsideDown(bool u);
     bool isUpsideDown();
 
+    bool addSegment(uint16_t count, bool reversed = false);
+    size_t heapUsage();
+
    private:
-    Adafruit_NeoPixel strip;
+    // Ebenen nach Priorität, angezeigt wird die oberste aktive
+    enum LayerId { LAYER_LEVEL,
+                   LAYER_MENU,
+                   LAYER_EFFECT,
+                   LAYER_COUNT };
+
+    /**
+     * Zusammenhängender Abschnitt des Strips, der alle Anzeigen für sich
+     * zeigt. Die LEDs werden von first aus gezählt, bei reversed vom
+     * anderen Ende.
+     */
+    struct Segment {
+        uint16_t first;
+        uint16_t count;
+        bool reversed;
+    };
+
+    /**
+     * Inhalt einer Ebene: feste Farben je LED und darüber optional eine
+     * Animation in den Zellen first .. first + count - 1 jedes Segments.
+     */
+    struct Layer {
+        bool active = false;
+        uint32_t* pixels = nullptr;
+        const Animation* animation = nullptr;
+        uint32_t color = 0;
+        uint16_t first = 0;
+        uint16_t count = 0;
+        uint32_t startedAt = 0;
+        uint8_t cursor = 0;  // Stützpunkt, in dessen Abschnitt die Zeit gerade liegt
+        Callback done;
+    };
+
+    LedStrip strip;
     uint16_t numLEDs;
+    uint32_t* frame;          // Farben je LED (Index auf dem Strip), wird in commit() übertragen
+    uint16_t* pixelMap;       // LED in Anzeigereihenfolge -> LED auf dem Strip
+    bool dirty = false;       // frame oder Helligkeit seit dem letzten show() geändert
+    uint32_t channelSum = 0;  // Summe aller Farbkanäle in frame, für die Stromschätzung
+    uint8_t targetBrightness;  // Helligkeit des Strips ohne Strombegrenzung
+    uint16_t showRequests = 0;
     uint32_t colorApply = strip.Color(185, 50, 255);
     uint32_t colorSuccess = strip.Color(0, 255, 0);
+    uint32_t colorFailure = strip.Color(255, 0, 0);
     uint32_t colorMenuIndicator = strip.Color(255, 255, 0);
-	uint32_t colorMenuStep = strip.Color(0, 140, 255);
-    uint32_t color;
-    uint32_t lastUpdateTime;
-    uint32_t currentTime;
-    uint32_t animationStartTime;
+    uint32_t colorMenuNested = strip.Color(255, 255, 255);
+    uint32_t colorMenuStep = strip.Color(0, 140, 255);
     int brightness = 255;
-    bool animationActive;
     bool upsideDown = true;
-    enum AnimationState { IDLE,
-                          FADE_UP,
-                          FADE_DOWN,
-                          BLINK_FIRST,
-						  MENU_ACTIVE,
-						  BLINK_RED_2500 };
-    int state = 0;
-    int currentLED = 0;  // Verfolgt die aktuelle LED in der Sequenz
-	int menuStep = 1;
-	bool subMenuActive = false;
-    uint32_t animationColor = 0;
-    void updateAnimation();
-    void initAnimation(uint32_t colorValue, Callback callback = nullptr);
-    void fadeUp();
-    void fadeDown();
-    void blinkFirstLED();
-    void blink(int startLED, int endLED, uint32_t time, uint32_t timeTotal = 0);
-    void blinkMenu();
-
-   	uint16_t mapIndex(uint16_t idx);
-    void setPixel(uint16_t idx, uint32_t c);
+    Segment segments[LED_MAX_SEGMENTS];
+    uint8_t segmentCount = 1;
+    bool customSegments = false;
 
-	Callback animationCallback;
-};
\ No newline at end of file
+    Layer layers[LAYER_COUNT];
+    Callback events[LED_EVENT_QUEUE_SIZE];  // beendete Animationen, abgearbeitet in update()
+    uint8_t eventHead = 0;
+    uint8_t eventCount = 0;
+
+    void play(LayerId id, const Animation& animation, uint32_t color, uint16_t first, uint16_t count, Callback done = nullptr);
+    void beginLayer(LayerId id);
+    void fillCells(LayerId id, uint8_t from, uint8_t to, uint32_t color);
+    uint16_t cellStart(const Segment& segment, uint16_t cell);
+    void updateMap();
+    void clearLayer(LayerId id);
+    void advance(LayerId id, uint32_t now);
+    void queueEvent(Callback callback);
+    void dispatchEvents();
+    void render(uint32_t now);
+
+    uint16_t mapIndex(uint16_t idx);
+    void setPixel(uint16_t idx, uint32_t c);
+    void clearFrame();
+    void show();
+    void commit();
+    uint8_t limitBrightness(uint8_t value);
+};
@@ -0,0 +1,30 @@
+#include "Ws2812Encoding.h"
+
+// Zeichen für zwei WS2812-Bits, Index = erstes Bit * 2 + zweites Bit.
+// Auf der Leitung (invertiert, LSB zuerst) wird daraus Start, ~d0 .. ~d5, Stop.
+static const uint8_t SYMBOLS[4] = {
+    0b110111,  // 0 0: H L L L  H L L L
+    0b000111,  // 0 1: H L L L  H H H L
+    0b110100,  // 1 0: H H H L  H L L L
+    0b000100,  // 1 1: H H H L  H H H L
+};
+
+/**
+ * @brief Encodes pixel bytes into UART characters, two WS2812 bits each.
+ *
+ * @param data The pixel bytes in the order the strip expects (GRB).
+ * @param length The number of pixel bytes.
+ * @param out Receives length * WS2812_UART_BYTES_PER_BYTE characters.
+ * @return The number of characters written.
+ */
+size_t ws2812EncodeUart(const uint8_t* data, size_t length, uint8_t* out) {
+    uint8_t* pos = out;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t value = data[i];
+        *pos++ = SYMBOLS[(value >> 6) & 0x03];
+        *pos++ = SYMBOLS[(value >> 4) & 0x03];
+        *pos++ = SYMBOLS[(value >> 2) & 0x03];
+        *pos++ = SYMBOLS[value & 0x03];
+    }
+    return pos - out;
+}
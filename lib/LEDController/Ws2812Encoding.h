@@ -0,0 +1,24 @@
+#ifndef WS2812_ENCODING_H
+#define WS2812_ENCODING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// UART-Bytes je Datenbyte: jedes UART-Zeichen trägt zwei WS2812-Bits
+#define WS2812_UART_BYTES_PER_BYTE 4
+// 800 kHz * 4 UART-Bits je WS2812-Bit
+#define WS2812_UART_BAUD 3200000
+
+/**
+ * Kodiert Pixeldaten für die Ausgabe über einen UART mit 6N1 und
+ * invertiertem TX. Ein UART-Zeichen (Start, 6 Daten, Stop) dauert acht
+ * Bitzeiten zu 312,5 ns und ergibt zwei WS2812-Bits zu je vier Bitzeiten:
+ * 0 = H L L L, 1 = H H H L. Die Daten werden MSB zuerst gesendet.
+ *
+ * Hängt nicht vom Arduino-Core ab, damit es auch auf dem Host läuft.
+ *
+ * @return Anzahl der Bytes in out (length * WS2812_UART_BYTES_PER_BYTE).
+ */
+size_t ws2812EncodeUart(const uint8_t* data, size_t length, uint8_t* out);
+
+#endif
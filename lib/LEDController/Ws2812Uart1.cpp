@@ -0,0 +1,120 @@
+#ifdef LED_BACKEND_UART1
+
+#include "Ws2812Uart1.h"
+
+#include "Ws2812Encoding.h"
+
+// Sende-FIFO von UART1
+#define UART1_FIFO_SIZE 128
+
+Ws2812Uart1::Ws2812Uart1(uint16_t numLEDs, int16_t pin, uint16_t type)
+    : numLEDs(numLEDs), pin(pin), pixels(new uint8_t[numLEDs * 3]()), encoded(new uint8_t[numLEDs * 3 * WS2812_UART_BYTES_PER_BYTE]) {
+    (void)type;  // immer GRB mit 800 kHz
+}
+
+/**
+ * @brief Configures UART1 for the WS2812 bit stream.
+ *
+ * 6N1 with an inverted TX line: the line idles low and every start bit
+ * becomes the high phase of a WS2812 bit.
+ */
+void Ws2812Uart1::begin() {
+    if (pin != 2) {
+        Serial.println("Ws2812Uart1::begin --> UART1 TX IS GPIO2, LEDS MUST BE CONNECTED THERE");
+    }
+    Serial1.begin(WS2812_UART_BAUD, SERIAL_6N1, SERIAL_TX_ONLY, 2, true);
+    readyAt = micros();
+}
+
+/**
+ * @brief Checks whether the previous frame has been sent and latched.
+ */
+bool Ws2812Uart1::canShow() {
+    return (int32_t)(micros() - readyAt) >= 0;
+}
+
+/**
+ * @brief Sends the pixels.
+ *
+ * Waits for the previous frame to be latched if necessary, then writes the
+ * encoded frame into the UART FIFO. Interrupts stay enabled throughout.
+ * A frame longer than the FIFO is written while the FIFO drains, about
+ * 30 µs per LED; yield() runs in between. If the FIFO ran empty during
+ * yield(), the strip may have latched part of the frame, so the frame is
+ * sent again from the start without yielding.
+ */
+void Ws2812Uart1::show() {
+    size_t length = ws2812EncodeUart(pixels, numLEDs * 3, encoded);
+    while (!canShow()) {
+        yield();
+    }
+    bool yielding = true;
+    size_t sent = 0;
+    while (sent < length) {
+        size_t free = Serial1.availableForWrite();
+        if (free == 0) {
+            // nur bei Streifen, die nicht ganz in den FIFO passen
+            if (yielding) {
+                yield();
+                if (Serial1.availableForWrite() == UART1_FIFO_SIZE) {
+                    delayMicroseconds(WS2812_LATCH_US);  // halben Frame übernehmen lassen
+                    sent = 0;
+                    yielding = false;
+                }
+            }
+            continue;
+        }
+        size_t chunk = min(free, length - sent);
+        Serial1.write(encoded + sent, chunk);
+        sent += chunk;
+    }
+    // Ein Zeichen dauert 8 Bits zu 312,5 ns = 2,5 µs
+    size_t queued = UART1_FIFO_SIZE - Serial1.availableForWrite();
+    readyAt = micros() + queued * 5 / 2 + WS2812_LATCH_US;
+}
+
+/**
+ * @brief Sets the color of a pixel, scaled by the brightness.
+ *
+ * @param index The index on the strip.
+ * @param color The color as 0x00RRGGBB.
+ */
+void Ws2812Uart1::setPixelColor(uint16_t index, uint32_t color) {
+    if (index >= numLEDs) {
+        return;
+    }
+    uint8_t r = color >> 16;
+    uint8_t g = color >> 8;
+    uint8_t b = color;
+    if (brightness) {
+        r = (r * brightness) >> 8;
+        g = (g * brightness) >> 8;
+        b = (b * brightness) >> 8;
+    }
+    uint8_t* pixel = &pixels[index * 3];
+    pixel[0] = g;
+    pixel[1] = r;
+    pixel[2] = b;
+}
+
+/**
+ * @brief Sets the brightness for the following setPixelColor() calls.
+ *
+ * Unlike Adafruit_NeoPixel, the pixels already set are not rescaled;
+ * LEDController sets all pixels before every show().
+ *
+ * @param value 0 (off) to 255 (full).
+ */
+void Ws2812Uart1::setBrightness(uint8_t value) {
+    brightness = value + 1;
+}
+
+uint8_t Ws2812Uart1::getBrightness() const {
+    return brightness - 1;
+}
+
+uint32_t Ws2812Uart1::Color(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef WS2812_UART1_H
+#define WS2812_UART1_H
+
+#include <Arduino.h>
+
+// Mindestpause nach einem Frame, bis die LEDs ihn übernommen haben (WS2812B)
+#ifndef WS2812_LATCH_US
+#define WS2812_LATCH_US 300
+#endif
+
+/**
+ * Ausgabe an WS2812-LEDs über UART1 (TX = GPIO2) statt per Bit-Banging.
+ *
+ * Adafruit_NeoPixel sperrt während des ganzen Frames die Interrupts
+ * (ca. 30 µs je LED), was WLAN und TCP stört. Hier wird der Frame
+ * kodiert und in den Sende-FIFO des UART geschrieben, den die Hardware
+ * selbst ausgibt; die Interrupts bleiben an. Ein Frame mit bis zu
+ * 10 LEDs passt ganz in den FIFO (128 Bytes), show() kehrt dann sofort
+ * zurück. Bei längeren Streifen wartet show(), bis der Rest in den FIFO
+ * passt, je LED 30 µs (144 LEDs: ca. 4 ms). Nachfüllen aus loop() geht
+ * nicht: läuft der FIFO leer, übernehmen die LEDs nach WS2812_LATCH_US
+ * einen halben Frame. Während des Wartens wird yield() aufgerufen; war
+ * der FIFO danach leer, wird der Frame ohne yield() neu gesendet.
+ *
+ * Bietet die Methoden von Adafruit_NeoPixel, die LEDController benutzt.
+ * Serial1 darf daneben nicht benutzt werden.
+ */
+class Ws2812Uart1 {
+   public:
+    Ws2812Uart1(uint16_t numLEDs, int16_t pin, uint16_t type = 0);
+    void begin();
+    void show();
+    bool canShow();
+    void setPixelColor(uint16_t index, uint32_t color);
+    void setBrightness(uint8_t value);
+    uint8_t getBrightness() const;
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b);
+
+   private:
+    uint16_t numLEDs;
+    int16_t pin;
+    uint8_t* pixels;          // GRB, bereits mit der Helligkeit skaliert
+    uint8_t* encoded;         // UART-Zeichen des Frames
+    uint16_t brightness = 0;  // 1 .. 256, 0 = nicht skalieren
+    uint32_t readyAt = 0;     // micros(), ab dem der nächste Frame gesendet werden darf
+};
+
+#endif
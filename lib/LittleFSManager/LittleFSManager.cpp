@@ -1,5 +1,7 @@
 #include "LittleFSManager.h"
 
+#include "Metrics.h"
+
 LittleFSManager::LittleFSManager(bool debug) : debug(debug) {}
 
 void LittleFSManager::begin() {
@@ -35,8 +37,9 @@ bool LittleFSManager::save(const String& key, int value) {
         return false;
     }
 
-    file.print(value);
+    size_t written = file.print(value);
     file.close();
+    metrics.countFlashWrite(FILE_SETTINGS, written);
     println("Wert erfolgreich gespeichert: " + key + " -> " + String(value));
     return true;
 }
@@ -62,8 +65,9 @@ bool LittleFSManager::save(const String& key, const String& value) {
         return false;
     }
 
-    file.print(value);
+    size_t written = file.print(value);
     file.close();
+    metrics.countFlashWrite(FILE_SETTINGS, written);
     println("String erfolgreich gespeichert: " + key + " -> " + value);
     return true;
 }
@@ -1,166 +1,298 @@
 #include "Menu.h"
 
-Menu::Menu(int numSteps) : numSteps(numSteps) {}
+/**
+ * @brief Sets the top level of the menu tree.
+ *
+ * @param items The top-level entries, a table in flash.
+ * @param count The number of entries.
+ * @param renderNavigation Draws the selected entry while no entry is open.
+ */
+void Menu::begin(const MenuItem* items, uint8_t count, MenuNavigationRenderer renderNavigation) {
+    levels[0] = {items, count, 0};
+    depth = 0;
+    this->renderNavigation = renderNavigation;
+}
 
 void Menu::keepAlive() {
     resetTimer();
 }
-int Menu::nextStep() {
-    if (active == true) {
-        keepAlive();
-        if (selectedStep == 1) {
-            return nextBrightness();
-        }
-        if (selectedStep == 2) {
-            return nextInterval();
-        }
-        if (step > 0 && selectedStep == step) {
-            selectedStep = 0;
-        } else {
-            step = step + 1;
-            if (step > numSteps) {
-                step = 1;
-            }
-        }
-        if (nextStepCallback) {
-            nextStepCallback();
-        }
+
+/**
+ * @brief Handles the black button.
+ *
+ * Moves to the next entry, changes the value of an open entry or cancels
+ * an armed confirmation.
+ */
+void Menu::nextStep() {
+    if (!active) {
+        return;
     }
-    return step;
-}
-void Menu::setBrightness(int value) {
-    brightness = value;
-}
-void Menu::setInterval(int value) {
-    interval = value;
+    keepAlive();
+    if (opened) {
+        changeOption(1);
+        return;
+    }
+    Level& level = levels[depth];
+    level.index = level.index + 1 < level.count ? level.index + 1 : 0;
+    render();
 }
-int Menu::nextBrightness() {
+
+/**
+ * @brief Goes back to the previous entry or value.
+ */
+void Menu::previousStep() {
+    if (!active) {
+        return;
+    }
     keepAlive();
-    brightness = brightness + 1;
-    if (brightness > numSteps - 1) {
-        brightness = 1;
+    if (opened) {
+        changeOption(-1);
+        return;
     }
-    if (firstMenuChangeCallback) {
-        firstMenuChangeCallback();
+    Level& level = levels[depth];
+    level.index = level.index > 0 ? level.index - 1 : level.count - 1;
+    render();
+}
+
+/**
+ * @brief Opens the menu directly at a top-level entry.
+ *
+ * @param step The entry, counted from 1.
+ */
+void Menu::openStep(uint8_t step) {
+    if (step < 1 || step > levels[0].count) {
+        return;
     }
-    return brightness;
+    if (opened) {
+        close(false);
+    }
+    active = true;
+    keepAlive();
+    depth = 0;
+    levels[0].index = step - 1;
+    render();
 }
-int Menu::nextInterval() {
+
+/**
+ * @brief Handles the red button.
+ *
+ * Opens the menu, opens the selected entry or applies the open entry.
+ */
+void Menu::accept() {
     keepAlive();
-    interval = interval + 1;
-    if (interval > numSteps - 1) {
-        interval = 1;
+    if (!active) {
+        active = true;
+        depth = 0;
+        levels[0].index = 0;
+        render();
+        return;
     }
-    if (secondMenuChangeCallback) {
-        secondMenuChangeCallback();
+    if (!opened) {
+        open();
+        return;
+    }
+    MenuItem item = current();
+    uint8_t value = optionValue(item);
+    close(true);
+    render();
+    if (item.apply) {
+        item.apply(value);
     }
-    return interval;
 }
-int Menu::accept() {
+
+/**
+ * @brief Closes the open entry, leaves a submenu or exits the menu.
+ */
+void Menu::back() {
     if (!active) {
-        active = true;
-        return nextStep();
+        return;
+    }
+    keepAlive();
+    if (opened) {
+        close(false);
+        render();
+    } else if (depth > 0) {
+        depth--;
+        render();
     } else {
-        resetTimer();
-        if (step != 1 && step != 2 && selectedStep != 0) {
-			if (applyCallback) {
-				applyCallback();
-			}
-            selectedStep = 0;
-        } else {
-            if (step == 1 && selectedStep != step) {
-                selectedStep = 1;
-                if (firstMenuEnterCallback) {
-                    firstMenuEnterCallback();
-                }
-            } else if (step == 2 && selectedStep != step) {
-                selectedStep = 2;
-                if (secondMenuEnterCallback) {
-                    secondMenuEnterCallback();
-                }
-            } else {
-				selectedStep = step;
-                if (selectCallback) {
-                    selectCallback();
-                }
-            }
-        }
-        return step;
+        exit();
     }
 }
-int Menu::currentStep() {
-    return step;
-}
-unsigned int Menu::currentBrightness() {
-    return brightness;
-}
-unsigned int Menu::currentInterval() {
-    return interval;
-}
-bool Menu::isFirstMenuActive() {
-	return selectedStep == 1;
-}
-bool Menu::isSecondMenuActive() {
-	return selectedStep == 2;
+
+/**
+ * @brief Draws the current state of the menu.
+ *
+ * An open entry is drawn by its own renderer, otherwise the navigation
+ * renderer shows the selected entry with its depth and page.
+ */
+void Menu::render() {
+    if (!active) {
+        return;
+    }
+    const Level& level = levels[depth];
+    uint8_t position = level.index % MENU_ITEMS_PER_PAGE + 1;
+    if (opened) {
+        MenuItem item = current();
+        if (item.render) {
+            item.render(position, item.type == MENU_CONFIRM ? 0 : option + 1);
+        }
+    } else if (renderNavigation) {
+        renderNavigation(depth, level.index / MENU_ITEMS_PER_PAGE, position);
+    }
 }
+
 bool Menu::isMenuActive() {
     return active;
 }
-void Menu::exitSubMenu() {
-    keepAlive();
-    selectedStep = 0;
-}
+
 void Menu::exit() {
-    step = 0;
-    selectedStep = 0;
+    if (opened) {
+        close(false);
+    }
+    depth = 0;
     active = false;
     if (exitMenuCallback) {
         exitMenuCallback();
     }
 }
+
+/**
+ * @brief Copies the selected entry of the current level from flash.
+ */
+MenuItem Menu::current() {
+    MenuItem item;
+    memcpy_P(&item, &levels[depth].items[levels[depth].index], sizeof(MenuItem));
+    return item;
+}
+
+uint8_t Menu::optionCount(const MenuItem& item) {
+    if (item.type == MENU_RANGE) {
+        return item.max - item.min + 1;
+    }
+    return item.type == MENU_CHOICE ? item.count : 0;
+}
+
+/**
+ * @brief Returns the value behind the selected option.
+ */
+uint8_t Menu::optionValue(const MenuItem& item) {
+    if (item.type == MENU_RANGE) {
+        return item.min + option;
+    }
+    if (item.type == MENU_CHOICE) {
+        return pgm_read_byte(&item.choices[option]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Opens the selected entry according to its type.
+ *
+ * Actions are applied at once and submenus entered; value entries start at
+ * the bound value.
+ */
+void Menu::open() {
+    MenuItem item = current();
+    switch (item.type) {
+        case MENU_ACTION:
+            render();
+            if (item.apply) {
+                item.apply(0);
+            }
+            return;
+        case MENU_SUBMENU:
+            if (depth + 1 < MENU_MAX_DEPTH && item.count > 0) {
+                depth++;
+                levels[depth] = {item.children, item.count, 0};
+            }
+            render();
+            return;
+        case MENU_RANGE: {
+            uint8_t value = item.get ? item.get() : item.min;
+            option = constrain(value, item.min, item.max) - item.min;
+            break;
+        }
+        case MENU_CHOICE: {
+            uint8_t value = item.get ? item.get() : 0;
+            option = 0;
+            for (uint8_t i = 0; i < item.count; i++) {
+                if (pgm_read_byte(&item.choices[i]) == value) {
+                    option = i;
+                    break;
+                }
+            }
+            break;
+        }
+        case MENU_CONFIRM:
+            option = 0;
+            break;
+    }
+    opened = true;
+    render();
+}
+
+/**
+ * @brief Closes the open entry.
+ *
+ * A value that was only previewed is set back to the bound value.
+ *
+ * @param applied true if the value is applied afterwards.
+ */
+void Menu::close(bool applied) {
+    MenuItem item = current();
+    opened = false;
+    if (!applied && item.preview && item.get) {
+        item.preview(item.get());
+    }
+}
+
+/**
+ * @brief Steps through the options of the open entry.
+ *
+ * The options wrap around; an armed confirmation is cancelled instead.
+ *
+ * @param delta 1 for the next option, -1 for the previous one.
+ */
+void Menu::changeOption(int8_t delta) {
+    MenuItem item = current();
+    uint8_t count = optionCount(item);
+    if (count == 0) {
+        close(false);
+        render();
+        return;
+    }
+    option = (option + count + delta) % count;
+    if (item.preview) {
+        item.preview(optionValue(item));
+    }
+    render();
+}
+
 void Menu::resetTimer() {
     lastUpdateTime = millis();  // Zeit des Resets
 }
+
 void Menu::checkTimer() {
     if (!active) {
         return;  // Timer läuft nicht
     }
 
-    currentTime = millis();
-    unsigned long wait = selectedStep == 0 ? keepMenuOpenDelay : keepMenuSelectedOpenDelay;
-    if (currentTime - lastUpdateTime >= wait) {
-        if (selectedStep == 0) {
-            exit();
-        } else {
+    unsigned long wait = opened ? keepMenuSelectedOpenDelay : keepMenuOpenDelay;
+    if (millis() - lastUpdateTime >= wait) {
+        if (opened) {
             resetTimer();
-            selectedStep = 0;
+            close(false);
+            render();
+        } else {
+            exit();
         }
     }
 }
-void Menu::onSelect(Callback callback) {
-    selectCallback = callback;
-}
-void Menu::onApply(Callback callback) {
-    applyCallback = callback;
-}
-void Menu::onNextStep(Callback callback) {
-    nextStepCallback = callback;
-}
+
 void Menu::onMenuExit(Callback callback) {
     exitMenuCallback = callback;
 }
-void Menu::onMenuFirstEnter(Callback callback) {
-    firstMenuEnterCallback = callback;
-}
-void Menu::onMenuFirstChange(Callback callback) {
-    firstMenuChangeCallback = callback;
-}
-void Menu::onMenuSecondEnter(Callback callback) {
-    secondMenuEnterCallback = callback;
-}
-void Menu::onMenuSecondChange(Callback callback) {
-    secondMenuChangeCallback = callback;
-}
+
 void Menu::update() {
     checkTimer();
-}
\ No newline at end of file
+}
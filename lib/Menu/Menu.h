@@ -1,92 +1,141 @@
 #include <Arduino.h>
 #include <functional>
 
+// Einträge je Seite: LED 0 zeigt Menü und Seite, die übrigen 7 den Eintrag
+#ifndef MENU_ITEMS_PER_PAGE
+#define MENU_ITEMS_PER_PAGE 7
+#endif
+// Maximale Verschachtelungstiefe von Untermenüs
+#ifndef MENU_MAX_DEPTH
+#define MENU_MAX_DEPTH 3
+#endif
+
+enum MenuItemType : uint8_t {
+    MENU_ACTION,   // Rot löst sofort apply() aus
+    MENU_CHOICE,   // Auswahl aus einer Werte-Tabelle
+    MENU_RANGE,    // Zahl von min bis max
+    MENU_CONFIRM,  // Rot aktiviert, zweites Rot löst apply() aus, Schwarz bricht ab
+    MENU_SUBMENU   // öffnet die Einträge in children
+};
+
+// Bindungen als einfache Funktionszeiger, damit die Tabelle im Flash liegen kann
+using MenuGetter = uint8_t (*)();
+using MenuSetter = void (*)(uint8_t value);
+using MenuRenderer = void (*)(uint8_t position, uint8_t option);      // Position des Eintrags und gewählte Option, ab 1
+using MenuNavigationRenderer = void (*)(uint8_t depth, uint8_t page, uint8_t position);  // position ab 1
+
+/**
+ * Eintrag im Menübaum. Die Bäume sind constexpr-Tabellen im Flash (PROGMEM)
+ * und werden mit den menu*()-Funktionen unten gebaut.
+ *
+ * * get:     aktueller Wert (CHOICE, RANGE)
+ * * preview: Wert beim Durchblättern, z. B. Helligkeit sofort anzeigen (optional)
+ * * apply:   übernimmt den Wert oder führt die Aktion aus
+ * * render:  Anzeige des geöffneten Eintrags (CHOICE, RANGE, CONFIRM)
+ */
+struct MenuItem {
+    MenuItemType type;
+    uint8_t min;
+    uint8_t max;
+    uint8_t count;                // Anzahl in choices bzw. children
+    const uint8_t* choices;       // CHOICE: Werte im Flash
+    const MenuItem* children;     // SUBMENU: Einträge im Flash
+    MenuGetter get;
+    MenuSetter preview;
+    MenuSetter apply;
+    MenuRenderer render;
+};
+
+constexpr MenuItem menuAction(MenuSetter apply) {
+    return {MENU_ACTION, 0, 0, 0, nullptr, nullptr, nullptr, nullptr, apply, nullptr};
+}
+
+constexpr MenuItem menuConfirm(MenuSetter apply, MenuRenderer render) {
+    return {MENU_CONFIRM, 0, 0, 0, nullptr, nullptr, nullptr, nullptr, apply, render};
+}
+
+constexpr MenuItem menuRange(uint8_t min, uint8_t max, MenuGetter get, MenuSetter preview, MenuSetter apply,
+                             MenuRenderer render) {
+    return {MENU_RANGE, min, max, 0, nullptr, nullptr, get, preview, apply, render};
+}
+
+template <size_t N>
+constexpr MenuItem menuChoice(const uint8_t (&choices)[N], MenuGetter get, MenuSetter preview, MenuSetter apply,
+                              MenuRenderer render) {
+    return {MENU_CHOICE, 0, 0, N, choices, nullptr, get, preview, apply, render};
+}
+
+template <size_t N>
+constexpr MenuItem menuSubmenu(const MenuItem (&children)[N]) {
+    return {MENU_SUBMENU, 0, 0, N, nullptr, children, nullptr, nullptr, nullptr, nullptr};
+}
+
 /**
  * Das Menü ist im Anzeige-Controller und Steuert eigenschaften des Sensors.
- * 
+ *
  * * Schwarzer Knopf:	Option
  * * Roter Knopf:		Accept
- * 
- * Drücken von Rot/Accept steigt in das Menü ein. LED 0 & 7 leuchten.
- * Nachdem es der erste Register im Menü ist, leuchtet LED 1 auch.
- * 
- * Schwarz/Option wechselt das nächste Register. Es gibt max. 6 Register (nur 8 LED, zwei belegt für Menü Indikation).
- * Rot/Accept aktiviert einen Register, oder dessen Funktion.
- * 
- * In einem aktivierten Register löst Rot die Aktion aus, wärend Schwarz den Register wieder verlässt.
- * 
- * Wird innerhalb von 10 Sekunden nichtmehr im Menü navigiert, wird dieses beendet.
- * 
- * 1. Register: Erneuter Verbindungsversuch zum Sensor (Falls nötig)
- * 2. Register: Reset des Sensors
- * 3. Register: Einstellung von Sensor-MIN
- * 4. Register: Einstellung von Sensor-MAX
+ *
+ * Drücken von Rot/Accept steigt in das Menü ein, der erste Eintrag ist gewählt.
+ * Schwarz/Option wechselt zum nächsten Eintrag, Rot/Accept öffnet ihn.
+ * In einem geöffneten Eintrag wechselt Schwarz den Wert und Rot übernimmt ihn
+ * (CHOICE, RANGE) bzw. löst die Aktion aus, während Schwarz abbricht (CONFIRM).
+ *
+ * Hat eine Ebene mehr Einträge als auf die LEDs passen, wird sie in Seiten zu
+ * MENU_ITEMS_PER_PAGE geteilt; Tiefe und Seite bekommt der Navigations-Renderer
+ * mit übergeben.
+ *
+ * Wird 8 Sekunden nicht navigiert, wird das Menü beendet; ein geöffneter
+ * Eintrag wird nach 20 Sekunden wieder geschlossen.
  */
-
-
 class Menu {
    public:
     using Callback = std::function<void()>;
 
-    Menu(int numSteps);
-
+    void begin(const MenuItem* items, uint8_t count, MenuNavigationRenderer renderNavigation);
     void update();
 
-    int nextBrightness();     		// returns step
-    int nextInterval();     		// returns step
-	void setBrightness(int value);
-	void setInterval(int value);
-
-    int nextStep();     		// returns step
-    int accept();    			// returns step
-    int currentStep();  		// returns step
-    unsigned int currentBrightness();  		// returns brightness
-    unsigned int currentInterval();  		// returns brightness
-    bool isFirstMenuActive();
-    bool isSecondMenuActive();
-	bool isMenuActive();
-
-	void exit();
-    void exitSubMenu();
+    void nextStep();
+    void previousStep();
+    void openStep(uint8_t step);  // Eintrag der obersten Ebene, ab 1
+    void accept();
+    void back();
+    void render();
+    bool isMenuActive();
 
-	void keepAlive();
+    void exit();
+    void keepAlive();
 
-	// Callback functions
-	void onSelect(Callback callback);
-	void onApply(Callback callback);
-	void onNextStep(Callback callback);
-	void onMenuExit(Callback callback);
-
-	void onMenuFirstEnter(Callback callback);
-	void onMenuFirstChange(Callback callback);
-	void onMenuSecondEnter(Callback callback);
-	void onMenuSecondChange(Callback callback);
+    void onMenuExit(Callback callback);
 
    private:
-    unsigned int step = 0;				// Menu not active 
-    unsigned int selectedStep = 0;		// Selected step to apply
-    unsigned int numSteps = 0;			// Number of menu steps. Max. 6
+    struct Level {
+        const MenuItem* items;
+        uint8_t count;
+        uint8_t index;
+    };
+
     unsigned long keepMenuOpenDelay = 8000;
     unsigned long keepMenuSelectedOpenDelay = 20000;
-	bool active = false;
+    bool active = false;
+    bool opened = false;  // Eintrag geöffnet: Wert wird gewählt oder Aktion ist scharf
+    uint8_t option = 0;   // gewählte Option im geöffneten Eintrag, ab 0
 
-	uint32_t lastUpdateTime;
-	uint32_t currentTime;
+    Level levels[MENU_MAX_DEPTH] = {};
+    uint8_t depth = 0;
+    MenuNavigationRenderer renderNavigation = nullptr;
 
-	void resetTimer();
-	void checkTimer();
-	void waitingForInputOrCancelMenu();
+    uint32_t lastUpdateTime;
 
-	Callback selectCallback;
-	Callback applyCallback;
-	Callback nextStepCallback;
-	Callback exitMenuCallback;
+    void resetTimer();
+    void checkTimer();
 
-	unsigned int brightness = 1;			// Current brightness
-	unsigned int interval = 1;			// Current interval
-	Callback firstMenuEnterCallback;
-	Callback firstMenuChangeCallback;
-	Callback secondMenuEnterCallback;
-	Callback secondMenuChangeCallback;
+    MenuItem current();
+    uint8_t optionCount(const MenuItem& item);
+    uint8_t optionValue(const MenuItem& item);
+    void open();
+    void close(bool applied);
+    void changeOption(int8_t delta);
 
-};
\ No newline at end of file
+    Callback exitMenuCallback;
+};
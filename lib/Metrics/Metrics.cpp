@@ -0,0 +1,269 @@
+#include "Metrics.h"
+
+#include <ESP8266WiFi.h>
+
+#include "CommandQueue.h"
+
+Metrics metrics;
+
+static const char* const ROUTE_NAMES[ROUTE_COUNT] = {"root", "sensor", "status", "events", "history", "config", "scan", "connect", "disconnect", "metrics", "captive", "networks", "calibration"};
+static const char* const FILE_NAMES[FILE_COUNT] = {"settings", "config", "history", "wifi", "networks"};
+static const char* const CALIBRATION_RESULT_NAMES[METRICS_CALIBRATION_RESULTS] = {"committed", "noisy", "out_of_range", "cancelled"};
+
+// Obergrenzen der Histogramm-Buckets für loop() in Mikrosekunden und als Text
+static const uint32_t LOOP_BUCKET_MICROS[METRICS_LOOP_BUCKETS] = {100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000};
+static const char* const LOOP_BUCKET_LABELS[METRICS_LOOP_BUCKETS] = {"0.0001", "0.0005", "0.001", "0.005", "0.01", "0.05", "0.1", "0.5", "1"};
+
+/**
+ * Eine Familie der Exposition. Familien mit genau einem ganzzahligen Wert
+ * liefern ihn über value(), alle anderen schreiben ihre Zeilen mit format().
+ */
+struct MetricsFamily {
+    const char* name;
+    const char* type;
+    const char* help;
+    uint32_t (*value)();
+    size_t (*format)(char* line, size_t size, const char* name, int16_t index);  // 0 = keine weitere Zeile
+};
+
+/**
+ * @brief Formats a duration in microseconds as seconds without floats.
+ */
+static size_t formatSeconds(char* line, size_t size, const char* name, const char* suffix, uint64_t micros) {
+    return snprintf(line, size, "%s%s %lu.%06lu\n", name, suffix, (unsigned long)(micros / 1000000), (unsigned long)(micros % 1000000));
+}
+
+/**
+ * @brief Formats the _sum and _count line of a summary.
+ */
+static size_t formatSummary(char* line, size_t size, const char* name, int16_t index, uint64_t micros, uint32_t count) {
+    if (index == 0) {
+        return formatSeconds(line, size, name, "_sum", micros);
+    }
+    return index == 1 ? snprintf(line, size, "%s_count %lu\n", name, (unsigned long)count) : 0;
+}
+
+static size_t formatLoopCurrent(char* line, size_t size, const char* name, int16_t index) {
+    uint32_t microAmps = metrics.loopCurrentMicroAmps;
+    return index == 0 ? snprintf(line, size, "%s %lu.%03lu\n", name, (unsigned long)(microAmps / 1000), (unsigned long)(microAmps % 1000)) : 0;
+}
+
+static size_t formatMeasurementDuration(char* line, size_t size, const char* name, int16_t index) {
+    return formatSummary(line, size, name, index, metrics.measurementMicros, metrics.measurements);
+}
+
+static size_t formatWifiRssi(char* line, size_t size, const char* name, int16_t index) {
+    if (index != 0 || WiFi.status() != WL_CONNECTED) {
+        return 0;
+    }
+    return snprintf(line, size, "%s %d\n", name, (int)WiFi.RSSI());
+}
+
+static size_t formatUplinkLatency(char* line, size_t size, const char* name, int16_t index) {
+    return formatSummary(line, size, name, index, metrics.uplinkLatencyMillis * 1000, metrics.uplinkBatches);
+}
+
+static size_t formatWifiBootToConnected(char* line, size_t size, const char* name, int16_t index) {
+    if (index != 0 || metrics.wifiBootToConnectedMillis == 0) {
+        return 0;
+    }
+    return formatSeconds(line, size, name, "", (uint64_t)metrics.wifiBootToConnectedMillis * 1000);
+}
+
+static size_t formatCommandLatency(char* line, size_t size, const char* name, int16_t index) {
+    return formatSummary(line, size, name, index, metrics.commandLatencyMicros, metrics.commandsApplied);
+}
+
+static size_t formatCalibrations(char* line, size_t size, const char* name, int16_t index) {
+    if (index >= METRICS_CALIBRATION_RESULTS) {
+        return 0;
+    }
+    return snprintf(line, size, "%s{result=\"%s\"} %lu\n", name, CALIBRATION_RESULT_NAMES[index], (unsigned long)metrics.calibrations[index]);
+}
+
+/**
+ * @brief Formats the loop() histogram with cumulative buckets.
+ */
+size_t MetricsStream::formatLoopDuration(char* line, size_t size, const char* name, int16_t index) {
+    if (index < METRICS_LOOP_BUCKETS) {
+        uint32_t cumulative = 0;
+        for (int16_t i = 0; i <= index; i++) {
+            cumulative += metrics.loopBuckets[i];
+        }
+        return snprintf(line, size, "%s_bucket{le=\"%s\"} %lu\n", name, LOOP_BUCKET_LABELS[index], (unsigned long)cumulative);
+    }
+    if (index == METRICS_LOOP_BUCKETS) {
+        return snprintf(line, size, "%s_bucket{le=\"+Inf\"} %lu\n", name, (unsigned long)metrics.loopCount);
+    }
+    if (index == METRICS_LOOP_BUCKETS + 1) {
+        return formatSeconds(line, size, name, "_sum", metrics.loopMicros);
+    }
+    return index == METRICS_LOOP_BUCKETS + 2 ? snprintf(line, size, "%s_count %lu\n", name, (unsigned long)metrics.loopCount) : 0;
+}
+
+size_t MetricsStream::formatRequests(char* line, size_t size, const char* name, int16_t index) {
+    return index < ROUTE_COUNT ? snprintf(line, size, "%s{route=\"%s\"} %lu\n", name, ROUTE_NAMES[index], (unsigned long)metrics.requests[index]) : 0;
+}
+
+size_t MetricsStream::formatFlashWrites(char* line, size_t size, const char* name, int16_t index) {
+    return index < FILE_COUNT ? snprintf(line, size, "%s{file=\"%s\"} %lu\n", name, FILE_NAMES[index], (unsigned long)metrics.flashWrites[index]) : 0;
+}
+
+size_t MetricsStream::formatFlashBytes(char* line, size_t size, const char* name, int16_t index) {
+    return index < FILE_COUNT ? snprintf(line, size, "%s{file=\"%s\"} %lu\n", name, FILE_NAMES[index], (unsigned long)metrics.flashBytes[index]) : 0;
+}
+
+const MetricsFamily MetricsStream::FAMILIES[] = {
+    {"sensor_level", "gauge", "Displayed level of the last measurement.", []() -> uint32_t { return metrics.level; }, nullptr},
+    {"sensor_adc", "gauge", "Averaged ADC value of the last measurement.", []() -> uint32_t { return metrics.adc; }, nullptr},
+    {"sensor_loop_current_milliamperes", "gauge", "Current of the 4-20 mA loop at the last measurement.", nullptr, formatLoopCurrent},
+    {"sensor_measurements_total", "counter", "Number of completed measurements.", []() -> uint32_t { return metrics.measurements; }, nullptr},
+    {"sensor_measurement_duration_seconds", "summary", "Time spent reading the sensor.", nullptr, formatMeasurementDuration},
+    {"sensor_loop_duration_seconds", "histogram", "Duration of one loop() iteration.", nullptr, formatLoopDuration},
+    {"sensor_heap_free_bytes", "gauge", "Free heap.", []() -> uint32_t { return ESP.getFreeHeap(); }, nullptr},
+    {"sensor_heap_max_free_block_bytes", "gauge", "Largest free heap block.", []() -> uint32_t { return ESP.getMaxFreeBlockSize(); }, nullptr},
+    {"sensor_wifi_rssi_dbm", "gauge", "Signal strength of the WiFi connection.", nullptr, formatWifiRssi},
+    {"sensor_wifi_reconnects_total", "counter", "Number of WiFi reconnects since boot.", []() -> uint32_t { return metrics.wifiReconnects; }, nullptr},
+    {"sensor_http_requests_total", "counter", "HTTP requests per route.", nullptr, formatRequests},
+    {"sensor_flash_writes_total", "counter", "Write operations to the flash file system per file.", nullptr, formatFlashWrites},
+    {"sensor_flash_written_bytes_total", "counter", "Bytes written to the flash file system per file.", nullptr, formatFlashBytes},
+    {"sensor_uplink_batches_total", "counter", "Batches delivered to the collector.", []() -> uint32_t { return metrics.uplinkBatches; }, nullptr},
+    {"sensor_uplink_records_total", "counter", "Readings delivered to the collector.", []() -> uint32_t { return metrics.uplinkRecords; }, nullptr},
+    {"sensor_uplink_last_batch_records", "gauge", "Readings in the last delivered batch.", []() -> uint32_t { return metrics.uplinkLastBatch; }, nullptr},
+    {"sensor_uplink_failures_total", "counter", "Failed uploads to the collector.", []() -> uint32_t { return metrics.uplinkFailures; }, nullptr},
+    {"sensor_uplink_backlog_records", "gauge", "Readings waiting for upload.", []() -> uint32_t { return metrics.uplinkBacklog; }, nullptr},
+    {"sensor_uplink_latency_seconds", "summary", "Time from connect to response of delivered batches.", nullptr, formatUplinkLatency},
+    {"sensor_wifi_boot_to_connected_seconds", "gauge", "Time from boot to the first WiFi connection.", nullptr, formatWifiBootToConnected},
+    {"sensor_command_queue_depth", "gauge", "Commands waiting for loop().", []() -> uint32_t { return commands.depth(); }, nullptr},
+    {"sensor_command_queue_depth_max", "gauge", "Highest number of waiting commands since boot.", []() -> uint32_t { return metrics.commandQueueHighWater; }, nullptr},
+    {"sensor_commands_total", "counter", "Commands applied by loop().", []() -> uint32_t { return metrics.commandsApplied; }, nullptr},
+    {"sensor_commands_dropped_total", "counter", "Commands rejected because the queue was full.", []() -> uint32_t { return metrics.commandsDropped; }, nullptr},
+    {"sensor_commands_invalid_total", "counter", "Config changes dropped by loop() because an earlier change made them invalid.", []() -> uint32_t { return metrics.commandsInvalid; }, nullptr},
+    {"sensor_command_latency_seconds", "summary", "Time from queueing a command to applying it.", nullptr, formatCommandLatency},
+    {"sensor_led_shows_total", "counter", "Writes of the LED strip.", []() -> uint32_t { return metrics.ledShows; }, nullptr},
+    {"sensor_led_shows_suppressed_total", "counter", "Requested LED strip writes skipped because nothing changed.", []() -> uint32_t { return metrics.ledShowsSuppressed; }, nullptr},
+    {"sensor_led_heap_bytes", "gauge", "Heap used for the LED pixel buffers.", []() -> uint32_t { return metrics.ledHeapBytes; }, nullptr},
+    {"sensor_led_current_milliamperes", "gauge", "Estimated current of the LED frame last written.", []() -> uint32_t { return metrics.ledCurrentMilliAmps; }, nullptr},
+    {"sensor_led_current_budget_milliamperes", "gauge", "Current budget of the LEDs, 0 without limit.", []() -> uint32_t { return metrics.ledCurrentBudgetMilliAmps; }, nullptr},
+    {"sensor_led_brightness_applied", "gauge", "Strip brightness (0-255) of the frame last written, after the current limit.", []() -> uint32_t { return metrics.ledBrightnessApplied; }, nullptr},
+    {"sensor_led_limited_frames_total", "counter", "LED frames dimmed to stay within the current budget.", []() -> uint32_t { return metrics.ledLimitedFrames; }, nullptr},
+    {"sensor_button_edge_overflows_total", "counter", "Times the button edge buffer was full and the pins were read again.", []() -> uint32_t { return metrics.buttonEdgeOverflows; }, nullptr},
+    {"sensor_calibrations_total", "counter", "Finished calibrations of the sensor limits by result.", nullptr, formatCalibrations},
+};
+
+const uint8_t MetricsStream::FAMILY_COUNT = sizeof(FAMILIES) / sizeof(FAMILIES[0]);
+
+/**
+ * @brief Records the duration of one loop() iteration.
+ *
+ * @param micros The duration in microseconds.
+ */
+void Metrics::recordLoop(uint32_t micros) {
+    loopCount++;
+    loopMicros += micros;
+    for (uint8_t i = 0; i < METRICS_LOOP_BUCKETS; i++) {
+        if (micros <= LOOP_BUCKET_MICROS[i]) {
+            loopBuckets[i]++;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Records a completed measurement.
+ *
+ * @param level The displayed level.
+ * @param adc The averaged ADC value.
+ * @param currentMicroAmps The loop current in microamperes.
+ * @param durationMicros The time spent reading the sensor in microseconds.
+ */
+void Metrics::recordMeasurement(unsigned int level, unsigned int adc, uint32_t currentMicroAmps, uint32_t durationMicros) {
+    this->level = level;
+    this->adc = adc;
+    loopCurrentMicroAmps = currentMicroAmps;
+    measurements++;
+    measurementMicros += durationMicros;
+}
+
+/**
+ * @brief Counts an HTTP request.
+ *
+ * @param route The requested route.
+ */
+void Metrics::countRequest(MetricsRoute route) {
+    requests[route]++;
+}
+
+/**
+ * @brief Counts a write operation to the flash file system.
+ *
+ * @param file The written file.
+ * @param bytes The number of bytes written.
+ */
+void Metrics::countFlashWrite(MetricsFile file, size_t bytes) {
+    flashWrites[file]++;
+    flashBytes[file] += bytes;
+}
+
+/**
+ * @brief Records a command applied by loop().
+ *
+ * @param latencyMicros The time from queueing to applying in microseconds.
+ */
+void Metrics::recordCommand(uint32_t latencyMicros) {
+    commandsApplied++;
+    commandLatencyMicros += latencyMicros;
+}
+
+/**
+ * @brief Formats the next line of the exposition into the line buffer.
+ *
+ * Each family starts with its HELP and TYPE line, followed by its samples.
+ *
+ * @return false when all families are written.
+ */
+bool MetricsStream::nextLine() {
+    while (family < FAMILY_COUNT) {
+        const MetricsFamily& current = FAMILIES[family];
+        if (sample == -2) {
+            lineLen = snprintf(line, sizeof(line), "# HELP %s %s\n", current.name, current.help);
+        } else if (sample == -1) {
+            lineLen = snprintf(line, sizeof(line), "# TYPE %s %s\n", current.name, current.type);
+        } else if (current.value) {
+            lineLen = sample == 0 ? snprintf(line, sizeof(line), "%s %lu\n", current.name, (unsigned long)current.value()) : 0;
+        } else {
+            lineLen = current.format(line, sizeof(line), current.name, sample);
+        }
+        if (lineLen == 0) {
+            family++;
+            sample = -2;
+            continue;
+        }
+        lineLen = min(lineLen, sizeof(line) - 1);
+        sample++;
+        linePos = 0;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Fills a response buffer with the next part of the exposition.
+ *
+ * @param buffer The buffer to fill.
+ * @param maxLen The size of the buffer.
+ * @return The number of bytes written, 0 when complete.
+ */
+size_t MetricsStream::fill(uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+        if (linePos >= lineLen && !nextLine()) {
+            break;
+        }
+        size_t count = min(lineLen - linePos, maxLen - written);
+        memcpy(buffer + written, line + linePos, count);
+        linePos += count;
+        written += count;
+    }
+    return written;
+}
@@ -0,0 +1,131 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+
+// Routen für die Zählung der HTTP-Anfragen
+enum MetricsRoute { ROUTE_ROOT,
+                    ROUTE_SENSOR,
+                    ROUTE_STATUS,
+                    ROUTE_EVENTS,
+                    ROUTE_HISTORY,
+                    ROUTE_CONFIG,
+                    ROUTE_SCAN,
+                    ROUTE_CONNECT,
+                    ROUTE_DISCONNECT,
+                    ROUTE_METRICS,
+                    ROUTE_CAPTIVE,
+                    ROUTE_NETWORKS,
+                    ROUTE_CALIBRATION,
+                    ROUTE_COUNT };
+
+// Dateien für die Zählung der Flash-Schreibvorgänge
+enum MetricsFile { FILE_SETTINGS,
+                   FILE_CONFIG,
+                   FILE_HISTORY,
+                   FILE_WIFI,
+                   FILE_NETWORKS,
+                   FILE_COUNT };
+
+#define METRICS_LOOP_BUCKETS 9
+#define METRICS_CALIBRATION_RESULTS 4  // je CalibrationError
+
+/**
+ * Laufzeit-Kennzahlen des Sensors für den /metrics-Endpunkt.
+ *
+ * Die Zähler werden an den jeweiligen Stellen direkt hochgezählt und kosten
+ * dort nur eine Addition. Der Text im Prometheus-Format wird erst bei einer
+ * Anfrage erzeugt, zeilenweise in den Puffer der Chunked-Response.
+ */
+class Metrics {
+   public:
+    // Messung
+    unsigned int level = 0;
+    unsigned int adc = 0;
+    uint32_t loopCurrentMicroAmps = 0;
+    uint32_t measurements = 0;
+    uint64_t measurementMicros = 0;
+
+    // WLAN
+    uint32_t wifiReconnects = 0;
+    uint32_t wifiBootToConnectedMillis = 0;  // 0 = noch nicht verbunden
+
+    // HTTP-Upload
+    uint32_t uplinkBatches = 0;
+    uint32_t uplinkRecords = 0;
+    uint32_t uplinkLastBatch = 0;
+    uint32_t uplinkFailures = 0;
+    uint32_t uplinkBacklog = 0;
+    uint64_t uplinkLatencyMillis = 0;
+
+    // Befehle an loop()
+    uint32_t commandsApplied = 0;
+    uint32_t commandsDropped = 0;
+    uint32_t commandsInvalid = 0;
+    uint32_t commandQueueHighWater = 0;
+    uint64_t commandLatencyMicros = 0;
+
+    // LED-Streifen
+    uint32_t ledShows = 0;
+    uint32_t ledShowsSuppressed = 0;
+    uint32_t ledHeapBytes = 0;
+    uint32_t ledCurrentMilliAmps = 0;
+    uint32_t ledCurrentBudgetMilliAmps = 0;
+    uint32_t ledBrightnessApplied = 0;
+    uint32_t ledLimitedFrames = 0;
+
+    // Buttons
+    uint32_t buttonEdgeOverflows = 0;
+
+    // Kalibrierung, nach Ergebnis (CalibrationError)
+    uint32_t calibrations[METRICS_CALIBRATION_RESULTS] = {};
+
+    void recordLoop(uint32_t micros);
+    void recordMeasurement(unsigned int level, unsigned int adc, uint32_t currentMicroAmps, uint32_t durationMicros);
+    void countRequest(MetricsRoute route);
+    void countFlashWrite(MetricsFile file, size_t bytes);
+    void recordCommand(uint32_t latencyMicros);
+
+   private:
+    friend class MetricsStream;
+
+    uint32_t loopBuckets[METRICS_LOOP_BUCKETS] = {};
+    uint32_t loopCount = 0;
+    uint64_t loopMicros = 0;
+    uint32_t requests[ROUTE_COUNT] = {};
+    uint32_t flashWrites[FILE_COUNT] = {};
+    uint32_t flashBytes[FILE_COUNT] = {};
+};
+
+extern Metrics metrics;
+
+struct MetricsFamily;
+
+/**
+ * Erzeugt den Text des /metrics-Endpunkts stückweise. Es wird immer nur
+ * eine Zeile im RAM gehalten.
+ */
+class MetricsStream {
+   public:
+    size_t fill(uint8_t* buffer, size_t maxLen);
+
+   private:
+    static const MetricsFamily FAMILIES[];
+    static const uint8_t FAMILY_COUNT;
+
+    uint8_t family = 0;
+    int16_t sample = -2;  // -2: HELP, -1: TYPE, ab 0: Werte
+    char line[128];
+    size_t lineLen = 0;
+    size_t linePos = 0;
+
+    bool nextLine();
+
+    // Familien mit Zugriff auf die privaten Zähler von Metrics
+    static size_t formatLoopDuration(char* line, size_t size, const char* name, int16_t index);
+    static size_t formatRequests(char* line, size_t size, const char* name, int16_t index);
+    static size_t formatFlashWrites(char* line, size_t size, const char* name, int16_t index);
+    static size_t formatFlashBytes(char* line, size_t size, const char* name, int16_t index);
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include "MqttPublisher.h"
+
+#define MQTT_SEQ_KEY "mqtt_seq"
+
+MqttPublisher::MqttPublisher(LittleFSManager& store) : store(store) {}
+
+/**
+ * @brief Starts the MQTT client.
+ *
+ * Does nothing if no broker is configured (MQTT_HOST). Continues with the
+ * first reading that was not acknowledged before the restart; on the very
+ * first start only readings taken from now on are published. A saved
+ * position beyond the end of the history is moved back to the end.
+ *
+ * @param historyStore The history that holds the readings to publish.
+ */
+void MqttPublisher::begin(HistoryStore* historyStore) {
+    history = historyStore;
+    if (strlen(MQTT_HOST) == 0 || !history) {
+        return;
+    }
+    enabled = true;
+    ackedSeq = min((uint32_t)store.read(MQTT_SEQ_KEY, (int)history->endSeq()), history->endSeq());
+    lastSave = millis();
+    waitingSeq = ackedSeq;
+
+    clientId = "sensor-" + String(ESP.getChipId(), HEX);
+    baseTopic = String(MQTT_PREFIX) + "/" + clientId;
+    willTopic = topic("status");
+
+    // AsyncMqttClient speichert nur die Zeiger, die Strings müssen bestehen bleiben
+    client.setServer(MQTT_HOST, MQTT_PORT);
+    if (strlen(MQTT_USER) > 0) {
+        client.setCredentials(MQTT_USER, MQTT_PASSWORD);
+    }
+    client.setClientId(clientId.c_str());
+    client.setWill(willTopic.c_str(), 1, true, "{\"online\":false}");
+    client.setKeepAlive(30);
+
+    client.onConnect([this](bool sessionPresent) { handleConnect(); });
+    client.onDisconnect([this](AsyncMqttClientDisconnectReason reason) { handleDisconnect(); });
+    client.onPublish([this](uint16_t packetId) { handlePublish(packetId); });
+    client.onMessage([this](char* topic, char* payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total) {
+        if (index == 0 && len == total) {
+            handleMessage(topic, payload, len);
+        }
+    });
+}
+
+/**
+ * @brief Connects to the broker and publishes pending data.
+ *
+ * Call this in every loop. Reconnects with increasing delay while the broker
+ * is unreachable. Once connected, the retained topics are updated and the
+ * readings are sent in order, one acknowledged publish at a time.
+ */
+void MqttPublisher::update() {
+    if (!enabled) {
+        return;
+    }
+    unsigned long now = millis();
+    saveProgress();
+
+    if (!connected) {
+        if (!connecting && WiFi.status() == WL_CONNECTED && now - lastAttempt >= reconnectDelay) {
+            lastAttempt = now;
+            reconnectDelay = reconnectDelay * 2 > RECONNECT_MAX_MS ? RECONNECT_MAX_MS : reconnectDelay * 2;
+            connect();
+        }
+        return;
+    }
+
+    if (configPending) {
+        publishConfig();
+    }
+    if (statusPending || now - lastStatus >= STATUS_INTERVAL_MS) {
+        publishStatus();
+    }
+    publishReadings();
+}
+
+/**
+ * @brief Sets the settings published on the config topic.
+ *
+ * @param value The saved settings.
+ */
+void MqttPublisher::setConfig(const SensorConfig& value) {
+    config = value;
+    configPending = true;
+}
+
+bool MqttPublisher::isConnected() {
+    return connected;
+}
+
+void MqttPublisher::connect() {
+    Serial.println("MqttPublisher::connect --> " MQTT_HOST);
+    connecting = true;
+    client.connect();
+}
+
+void MqttPublisher::handleConnect() {
+    Serial.println("MqttPublisher::handleConnect --> CONNECTED");
+    connecting = false;
+    connected = true;
+    reconnectDelay = RECONNECT_MIN_MS;
+    configPending = true;
+    statusPending = true;
+    client.subscribe(topic("+/set").c_str(), 1);
+}
+
+void MqttPublisher::handleDisconnect() {
+    if (connected) {
+        Serial.println("MqttPublisher::handleDisconnect --> DISCONNECTED");
+    }
+    connecting = false;
+    connected = false;
+    inFlightPacket = 0;  // nach dem Reconnect ab ackedSeq erneut senden
+    lastAttempt = millis();
+}
+
+/**
+ * @brief Handles the PUBACK of a publish.
+ *
+ * @param packetId The id of the acknowledged packet.
+ */
+void MqttPublisher::handlePublish(uint16_t packetId) {
+    if (inFlightPacket != 0 && packetId == inFlightPacket) {
+        published += inFlightEnd - ackedSeq;
+        ackedSeq = inFlightEnd;
+        unsaved = true;
+        inFlightPacket = 0;
+    }
+}
+
+/**
+ * @brief Saves the acknowledged position, at most every SAVE_INTERVAL_MS.
+ *
+ * Readings acknowledged after the last save are sent again after a restart;
+ * the receiver drops them by their sequence number.
+ */
+void MqttPublisher::saveProgress() {
+    if (!unsaved || millis() - lastSave < SAVE_INTERVAL_MS) {
+        return;
+    }
+    store.save(MQTT_SEQ_KEY, (int)ackedSeq);
+    unsaved = false;
+    lastSave = millis();
+}
+
+/**
+ * @brief Handles a command message.
+ *
+ * The value is validated with the current settings and then queued for
+ * loop(), the same way as changes via the captive portal; loop() validates
+ * it again before it is applied.
+ *
+ * @param topic The topic of the message.
+ * @param payload The payload, not null-terminated.
+ * @param len The length of the payload.
+ */
+void MqttPublisher::handleMessage(const char* topic, const char* payload, size_t len) {
+    char value[16];
+    if (len >= sizeof(value)) {
+        return;
+    }
+    memcpy(value, payload, len);
+    value[len] = '\0';
+
+    String name = String(topic).substring(baseTopic.length() + 1);
+    ConfigPatch patch;
+    String error;
+    if (name == "upsideDown/set") {
+        bool upsideDown = strcmp(value, "true") == 0 || strcmp(value, "1") == 0;
+        if (!upsideDown && strcmp(value, "false") != 0 && strcmp(value, "0") != 0) {
+            return;
+        }
+        patch.setUpsideDown(upsideDown);
+    } else {
+        char* end;
+        long number = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || number < 0 || number > 1023) {
+            return;
+        }
+        if (name == "interval/set") {
+            patch.setInterval(number);
+        } else if (name == "adcMin/set") {
+            patch.setMinAdc(number);
+        } else if (name == "adcMax/set") {
+            patch.setMaxAdc(number);
+        } else {
+            return;
+        }
+    }
+    if (!patch.validate(config, error)) {
+        Serial.println("MqttPublisher::handleMessage --> " + error);
+        return;
+    }
+
+    // Übernommen wird in loop(), nicht im Callback des MQTT-Clients
+    Command command;
+    command.type = COMMAND_CONFIG;
+    command.source = SOURCE_MQTT;
+    command.patch = patch;
+    if (!commands.push(command)) {
+        Serial.println("MqttPublisher::handleMessage --> COMMAND QUEUE FULL");
+    }
+}
+
+/**
+ * @brief Publishes the next block of readings.
+ *
+ * Readings are collected until MQTT_BATCH_READINGS are waiting or the
+ * oldest has waited MQTT_BATCH_MAX_DELAY_MS, so fast intervals do not cause
+ * one publish per second and slow intervals still send several readings in
+ * one publish. After a reconnect the backlog is sent in blocks of up to
+ * MQTT_BATCH_MAX. Readings that were overwritten in the history before they
+ * could be sent are counted as dropped, gap records are skipped.
+ */
+void MqttPublisher::publishReadings() {
+    unsigned long now = millis();
+    if (inFlightPacket != 0) {
+        if (now - inFlightSince < ACK_TIMEOUT_MS) {
+            return;
+        }
+        inFlightPacket = 0;  // kein PUBACK, Block erneut senden
+    }
+
+    uint32_t first = history->firstSeq();
+    if (ackedSeq < first) {
+        dropped += first - ackedSeq;
+        ackedSeq = first;
+        unsaved = true;
+    }
+    uint32_t end = history->endSeq();
+    if (ackedSeq >= end) {
+        // nichts wartet, die Wartezeit beginnt mit dem nächsten Messwert
+        waitingSeq = end;
+        waitingSince = now;
+        return;
+    }
+    if (waitingSeq != ackedSeq) {
+        // erster wartender Messwert seit dem letzten Publish
+        waitingSeq = ackedSeq;
+        waitingSince = now;
+    }
+    if (end - ackedSeq < MQTT_BATCH_READINGS && now - waitingSince < MQTT_BATCH_MAX_DELAY_MS) {
+        return;
+    }
+
+    HistoryRecord records[MQTT_BATCH_MAX];
+    size_t count = history->read(ackedSeq, records, MQTT_BATCH_MAX);
+    if (count == 0) {
+        return;
+    }
+
+    String payload;
+    payload.reserve(count * 64 + 2);
+    payload += '[';
+    char line[80];
+    size_t values = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (records[i].flags & HISTORY_FLAG_GAP) {
+            continue;
+        }
+        snprintf(line, sizeof(line), "%s{\"seq\":%lu,\"ts\":%lu,\"level\":%u,\"adc\":%u,\"flags\":%u}", values == 0 ? "" : ",",
+                 (unsigned long)(ackedSeq + i), (unsigned long)records[i].timestamp, records[i].level, records[i].adc, records[i].flags);
+        payload += line;
+        values++;
+    }
+    payload += ']';
+    if (values == 0) {
+        ackedSeq += count;  // nur Lücken, nichts zu senden
+        unsaved = true;
+        return;
+    }
+
+    uint16_t packetId = client.publish(topic("readings").c_str(), 1, false, payload.c_str(), payload.length());
+    if (packetId == 0) {
+        return;  // Sendepuffer voll, im nächsten Loop erneut versuchen
+    }
+    inFlightPacket = packetId;
+    inFlightEnd = ackedSeq + count;
+    inFlightSince = now;
+    waitingSeq = inFlightEnd;
+    waitingSince = now;
+}
+
+void MqttPublisher::publishConfig() {
+    JsonDocument doc;
+    ConfigStore::toJson(config, doc.to<JsonObject>());
+    String payload;
+    serializeJson(doc, payload);
+    if (client.publish(topic("config").c_str(), 1, true, payload.c_str(), payload.length()) != 0) {
+        configPending = false;
+    }
+}
+
+void MqttPublisher::publishStatus() {
+    JsonDocument doc;
+    doc["online"] = true;
+    doc["ip"] = WiFi.localIP().toString();
+    doc["rssi"] = WiFi.RSSI();
+    doc["uptime"] = millis() / 1000;
+    doc["published"] = published;
+    doc["dropped"] = dropped;
+    String payload;
+    serializeJson(doc, payload);
+    if (client.publish(topic("status").c_str(), 1, true, payload.c_str(), payload.length()) != 0) {
+        statusPending = false;
+        lastStatus = millis();
+    }
+}
+
+String MqttPublisher::topic(const char* name) {
+    return baseTopic + "/" + name;
+}
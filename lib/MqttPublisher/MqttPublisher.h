@@ -0,0 +1,120 @@
+#ifndef MQTT_PUBLISHER_H
+#define MQTT_PUBLISHER_H
+
+#include <Arduino.h>
+#include <AsyncMqttClient.h>
+#include <ESP8266WiFi.h>
+
+#include "CommandQueue.h"
+#include "ConfigStore.h"
+#include "HistoryStore.h"
+#include "LittleFSManager.h"
+
+// Broker, per build_flags in platformio.ini setzen. Ohne MQTT_HOST ist MQTT aus.
+#ifndef MQTT_HOST
+#define MQTT_HOST ""
+#endif
+#ifndef MQTT_PORT
+#define MQTT_PORT 1883
+#endif
+#ifndef MQTT_USER
+#define MQTT_USER ""
+#endif
+#ifndef MQTT_PASSWORD
+#define MQTT_PASSWORD ""
+#endif
+#ifndef MQTT_PREFIX
+#define MQTT_PREFIX "sensor"
+#endif
+
+#define MQTT_BATCH_MAX 16  // max. Messwerte je Publish
+
+// Messwerte, die für einen Publish gesammelt werden, in jedem Intervall
+#ifndef MQTT_BATCH_READINGS
+#define MQTT_BATCH_READINGS 4
+#endif
+// Längste Wartezeit des ältesten gesammelten Messwerts, begrenzt die Verzögerung in langsamen Intervallen
+#ifndef MQTT_BATCH_MAX_DELAY_MS
+#define MQTT_BATCH_MAX_DELAY_MS 21600000UL  // 6 Stunden
+#endif
+
+/**
+ * Veröffentlicht die Messwerte per MQTT (QoS 1).
+ *
+ * Topics unter `<MQTT_PREFIX>/<Geräte-ID>/`:
+ * - `readings`  JSON-Array der Messwerte, mit Sequenznummer
+ * - `config`    Einstellungen (retained)
+ * - `status`    Online-Status, IP und Signal (retained, Last Will: offline)
+ * - `interval/set`, `adcMin/set`, `adcMax/set`, `upsideDown/set` Befehle
+ *
+ * Die Warteschlange ist der HistoryStore: es wird nur die Sequenznummer des
+ * ersten noch nicht bestätigten Messwerts gehalten und höchstens alle
+ * SAVE_INTERVAL_MS gespeichert, wie beim Uplink. Ist der Broker nicht
+ * erreichbar, bleiben die Messwerte im Ringspeicher und werden nach dem
+ * Reconnect, auch nach einem Neustart, der Reihe nach gesendet. Es ist immer
+ * nur ein Publish unterwegs, erst nach dem PUBACK geht es weiter.
+ *
+ * Gesendet wird, sobald MQTT_BATCH_READINGS Messwerte warten oder der
+ * älteste MQTT_BATCH_MAX_DELAY_MS wartet, in jedem Intervall.
+ */
+class MqttPublisher {
+   public:
+    static const unsigned long ACK_TIMEOUT_MS = 15000;      // erneut senden ohne PUBACK
+    static const unsigned long STATUS_INTERVAL_MS = 60000;  // Status aktualisieren
+    static const unsigned long RECONNECT_MIN_MS = 2000;
+    static const unsigned long RECONNECT_MAX_MS = 60000;
+    static const unsigned long SAVE_INTERVAL_MS = 300000;  // bestätigte Position höchstens so oft speichern
+
+    MqttPublisher(LittleFSManager& store);
+
+    void begin(HistoryStore* history);
+    void update();
+    void setConfig(const SensorConfig& value);
+    bool isConnected();
+
+    // Statistik
+    uint32_t published = 0;
+    uint32_t dropped = 0;  // Messwerte, die vor dem Senden überschrieben wurden
+
+   private:
+    AsyncMqttClient client;
+    LittleFSManager& store;
+    HistoryStore* history = nullptr;
+    SensorConfig config;
+
+    String baseTopic;
+    String clientId;
+    String willTopic;
+
+    bool enabled = false;
+    bool connecting = false;
+    bool connected = false;
+    bool configPending = true;
+    bool statusPending = true;
+    unsigned long lastAttempt = 0;
+    unsigned long reconnectDelay = RECONNECT_MIN_MS;
+    unsigned long lastStatus = 0;
+
+    uint32_t ackedSeq = 0;        // erster noch nicht bestätigter Messwert
+    bool unsaved = false;         // ackedSeq noch nicht gespeichert
+    unsigned long lastSave = 0;
+    uint32_t inFlightEnd = 0;     // Ende des gesendeten Blocks
+    uint16_t inFlightPacket = 0;  // 0 = nichts unterwegs
+    unsigned long inFlightSince = 0;
+    uint32_t waitingSeq = 0;  // ab hier wird gesammelt
+    unsigned long waitingSince = 0;
+
+    void connect();
+    void handleConnect();
+    void handleDisconnect();
+    void handlePublish(uint16_t packetId);
+    void handleMessage(const char* topic, const char* payload, size_t len);
+
+    void saveProgress();
+    void publishReadings();
+    void publishConfig();
+    void publishStatus();
+    String topic(const char* name);
+};
+
+#endif
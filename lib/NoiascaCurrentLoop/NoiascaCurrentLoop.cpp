@@ -74,6 +74,30 @@ int CurrentLoopSensor::getAdc() {
     return adc;
 }
 
+/*
+   return the loop current of the previous measurement in uA
+ */
+uint32_t CurrentLoopSensor::getCurrentMicroAmps() {
+    // U = adc / 1023 * vref / 10, I = U / resistor
+    return (uint64_t)adc * vref * 100000UL / (1023UL * resistor);
+}
+
+/*
+   return the previous measurement between the MIN and MAX Adc value,
+   with a finer resolution than getValue()
+ */
+uint16_t CurrentLoopSensor::getFill() {
+    if (maxAdcValue <= minAdcValue) {
+        return 0;
+    }
+    int32_t fill = (int32_t)(adc - minAdcValue) * 65535 / (maxAdcValue - minAdcValue);
+    if (fill > 65535)
+        fill = 65535;
+    else if (fill < 0)
+        fill = 0;
+    return fill;
+}
+
 int CurrentLoopSensor::getMinAdcValue() {
 	return minAdcValue;
 }
@@ -31,14 +31,17 @@
 
 #include <Arduino.h>
 
+#define CURRENT_LOOP_DEFAULT_MIN_ADC 192  // ADC-Wert bei 4 mA, solange nichts eingestellt ist
+#define CURRENT_LOOP_DEFAULT_MAX_ADC 960  // ADC-Wert bei 20 mA
+
 class CurrentLoopSensor {
    protected:
     const byte pin;            // the pin
     const uint16_t resistor;   // Ohm of pulldown resistor
     const uint16_t vref;       // Reference Voltage * 10
     const byte measures = 10;  // keep in mind 1023 * measures has to fit in an int
-	int minAdcValue = 192; // minimal Sensor value
-	int maxAdcValue = 960; // maximal Sensor value
+	int minAdcValue = CURRENT_LOOP_DEFAULT_MIN_ADC; // minimal Sensor value
+	int maxAdcValue = CURRENT_LOOP_DEFAULT_MAX_ADC; // maximal Sensor value
     const int maxDisplayValue;        // the maximum value the sensor can measure
     const int minAdc;          // precalculation of minimum value of ADC
     const int maxAdc;          // precalculation of maximum value of ADC
@@ -49,7 +52,9 @@ class CurrentLoopSensor {
     int begin();     // begin method - call in setup()
     void check();    // checks if the resistor value fit to the other parameters
     int getAdc();    // return the previous measured raw ADC value
+    uint32_t getCurrentMicroAmps();  // return the loop current of the previous measurement in uA
     int getValue();  // do the measurement and return the result
+    uint16_t getFill();  // return the previous measurement between MIN (0) and MAX (65535) Adc value
 	void setMinAdcValue(int value);
 	void setMaxAdcValue(int value);
 	int getMinAdcValue(); // return the MIN Adc value
@@ -0,0 +1,173 @@
+#include "ScanService.h"
+
+/**
+ * @brief Evaluates a running scan.
+ *
+ * Call this in every loop. Copies the results once the scan is done and
+ * notifies the waiting users.
+ */
+void ScanService::update() {
+    if (!scanning) {
+        return;
+    }
+    int8_t found = WiFi.scanComplete();
+    if (found == WIFI_SCAN_RUNNING) {
+        if (millis() - startedAt >= SCAN_TIMEOUT_MS) {
+            Serial.println("ScanService::update --> SCAN TIMEOUT");
+            finish(false);
+        }
+        return;
+    }
+    if (found < 0) {
+        finish(false);
+        return;
+    }
+    collect(found);
+    finish(true);
+}
+
+/**
+ * @brief Starts a scan unless one is running already.
+ *
+ * @return true if a scan is running afterwards.
+ */
+bool ScanService::start() {
+    if (scanning) {
+        return true;
+    }
+    WiFi.scanDelete();
+    if (WiFi.scanNetworks(true, false) == WIFI_SCAN_FAILED) {
+        finish(false);
+        return false;
+    }
+    scanning = true;
+    startedAt = millis();
+    return true;
+}
+
+/**
+ * @brief Copies the strongest networks into the result array.
+ *
+ * Hidden networks are skipped. The SDK's memory is released right away.
+ */
+void ScanService::collect(int found) {
+    count = 0;
+    for (int i = 0; i < found; i++) {
+        String ssid = WiFi.SSID(i);
+        if (ssid.isEmpty()) {
+            continue;
+        }
+        int8_t rssi = WiFi.RSSI(i);
+        // Einfügen nach Signalstärke, bei vollem Array fällt das schwächste weg
+        size_t pos = count < SCAN_MAX_RESULTS ? count : SCAN_MAX_RESULTS;
+        while (pos > 0 && results[pos - 1].rssi < rssi) {
+            if (pos < SCAN_MAX_RESULTS) {
+                results[pos] = results[pos - 1];
+            }
+            pos--;
+        }
+        if (pos >= SCAN_MAX_RESULTS) {
+            continue;
+        }
+        ScanResult& result = results[pos];
+        strlcpy(result.ssid, ssid.c_str(), sizeof(result.ssid));
+        memcpy(result.bssid, WiFi.BSSID(i), sizeof(result.bssid));
+        result.rssi = rssi;
+        result.channel = WiFi.channel(i);
+        result.secured = WiFi.encryptionType(i) != ENC_TYPE_NONE;
+        if (count < SCAN_MAX_RESULTS) {
+            count++;
+        }
+    }
+    WiFi.scanDelete();
+}
+
+void ScanService::finish(bool ok) {
+    scanning = false;
+    lastFailed = !ok;
+    if (!ok) {
+        count = 0;
+        WiFi.scanDelete();
+    }
+    completedAt = millis();
+    completed++;
+    if (onCompleteCallback) {
+        onCompleteCallback();
+    }
+}
+
+/**
+ * @brief Checks whether the last scan is recent enough to be reused.
+ *
+ * @param maxAge The maximum age in milliseconds.
+ */
+bool ScanService::fresh(unsigned long maxAge) {
+    return completed != 0 && !lastFailed && millis() - completedAt < maxAge;
+}
+
+bool ScanService::running() {
+    return scanning;
+}
+
+bool ScanService::failed() {
+    return lastFailed;
+}
+
+uint32_t ScanService::generation() {
+    return completed;
+}
+
+/**
+ * @brief Registers a callback for finished scans, successful or not.
+ *
+ * @param callback The function to call.
+ */
+void ScanService::onComplete(std::function<void()> callback) {
+    onCompleteCallback = callback;
+}
+
+size_t ScanService::size() {
+    return count;
+}
+
+const ScanResult& ScanService::at(size_t index) {
+    return results[index];
+}
+
+/**
+ * @brief Returns the results of the last scan as JSON for /scan.
+ *
+ * The JSON is serialised once per scan. The number of networks is limited
+ * to SCAN_MAX_RESULTS, so the body always fits into the fixed buffer; should
+ * it not (SSIDs full of escaped characters), the weakest networks are left
+ * out.
+ */
+const char* ScanService::json() {
+    if (bodyGeneration == completed && completed != 0) {
+        return body;
+    }
+    JsonDocument doc;
+    JsonArray networks = doc.to<JsonArray>();
+    toJson(networks);
+    while (measureJson(doc) >= sizeof(body)) {
+        networks.remove(networks.size() - 1);
+    }
+    serializeJson(doc, body, sizeof(body));
+    bodyGeneration = completed;
+    return body;
+}
+
+/**
+ * @brief Writes the results of the last scan into a JSON array.
+ *
+ * @param networks The JSON array to fill.
+ */
+void ScanService::toJson(JsonArray networks) {
+    for (size_t i = 0; i < count; i++) {
+        JsonObject net = networks.add<JsonObject>();
+        net["ssid"] = results[i].ssid;
+        net["signal"] = map(results[i].rssi, -100, -50, 0, 100);
+        net["channel"] = results[i].channel;
+        net["secured"] = results[i].secured;
+    }
+}
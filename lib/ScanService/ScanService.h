@@ -0,0 +1,69 @@
+#ifndef SCAN_SERVICE_H
+#define SCAN_SERVICE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESP8266WiFi.h>
+
+// Anzahl der gemerkten Netze je Scan, die stärksten werden behalten
+#ifndef SCAN_MAX_RESULTS
+#define SCAN_MAX_RESULTS 20
+#endif
+// Wie lange ein Scan für /scan wiederverwendet wird
+#ifndef SCAN_TTL_MS
+#define SCAN_TTL_MS 10000
+#endif
+
+struct ScanResult {
+    char ssid[33];
+    uint8_t bssid[6];
+    int8_t rssi;
+    uint8_t channel;
+    bool secured;
+};
+
+/**
+ * Führt WLAN-Scans aus, von denen immer höchstens einer läuft.
+ *
+ * Wer einen Scan braucht, ruft start() auf; läuft schon einer, wird dessen
+ * Ergebnis mitbenutzt. Die Ergebnisse werden in ein festes Array kopiert und
+ * der Speicher des SDK sofort freigegeben. Die JSON-Antwort für /scan wird
+ * je Scan nur einmal in einen festen Puffer serialisiert.
+ */
+class ScanService {
+   public:
+    static const unsigned long SCAN_TIMEOUT_MS = 10000;
+    static const size_t JSON_SIZE = SCAN_MAX_RESULTS * 96 + 2;
+
+    void update();
+    bool start();
+    bool fresh(unsigned long maxAge);
+    bool running();
+    bool failed();
+    uint32_t generation();  // zählt mit jedem beendeten Scan hoch
+    void onComplete(std::function<void()> callback);
+
+    size_t size();
+    const ScanResult& at(size_t index);
+    const char* json();
+    void toJson(JsonArray networks);
+
+   private:
+    ScanResult results[SCAN_MAX_RESULTS];
+    size_t count = 0;
+    bool scanning = false;
+    bool lastFailed = false;
+    unsigned long startedAt = 0;
+    unsigned long completedAt = 0;
+    uint32_t completed = 0;
+
+    char body[JSON_SIZE];
+    uint32_t bodyGeneration = 0;
+
+    std::function<void()> onCompleteCallback;
+
+    void collect(int found);
+    void finish(bool ok);
+};
+
+#endif
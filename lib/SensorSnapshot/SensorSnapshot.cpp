@@ -0,0 +1,58 @@
+#include "SensorSnapshot.h"
+
+/**
+ * @brief Compares the values without the version.
+ */
+bool SensorState::sameValues(const SensorState& other) const {
+    return level == other.level && adc == other.adc && adcMin == other.adcMin && adcMax == other.adcMax &&
+           timestamp == other.timestamp && interval == other.interval && upsideDown == other.upsideDown &&
+           calibration.equals(other.calibration);
+}
+
+/**
+ * @brief Publishes a new state.
+ *
+ * Only call this from loop(). Nothing is published if the values did not
+ * change, so readers can rely on the version to detect changes.
+ *
+ * @param state The new state, its version is ignored.
+ * @return true if a new version was published.
+ */
+bool SensorSnapshot::publish(const SensorState& state) {
+    uint32_t current = sequence.load(std::memory_order_relaxed);
+    if (current != 0 && state.sameValues(buffers[current & 1])) {
+        return false;
+    }
+    uint32_t next = current + 1;
+    SensorState& target = buffers[next & 1];
+    target = state;
+    target.version = next;
+    sequence.store(next, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Returns a consistent copy of the current state.
+ *
+ * Can be called from any context. Before the first publish, the state is
+ * all zero with version 0.
+ */
+SensorState SensorSnapshot::read() const {
+    while (true) {
+        uint32_t before = sequence.load(std::memory_order_acquire);
+        SensorState copy = buffers[before & 1];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // loop() schreibt erst nach einer weiteren Version in den kopierten
+        // Puffer; ist keine dazugekommen, ist die Kopie vollständig
+        if (sequence.load(std::memory_order_relaxed) == before) {
+            return copy;
+        }
+    }
+}
+
+/**
+ * @brief Returns the version of the current state, 0 before the first publish.
+ */
+uint32_t SensorSnapshot::version() const {
+    return sequence.load(std::memory_order_acquire);
+}
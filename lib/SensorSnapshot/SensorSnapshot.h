@@ -0,0 +1,50 @@
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+#include <Arduino.h>
+
+#include <atomic>
+
+#include "CalibrationStatus.h"
+
+/**
+ * Stand des Sensors: letzte Messung, die dazu angezeigten Einstellungen und
+ * die laufende oder letzte Kalibrierung.
+ * `version` wird beim Veröffentlichen vergeben.
+ */
+struct SensorState {
+    uint16_t level = 0;
+    uint16_t adc = 0;
+    uint16_t adcMin = 0;
+    uint16_t adcMax = 0;
+    uint32_t timestamp = 0;  // millis() der Messung
+    uint8_t interval = 0;
+    bool upsideDown = false;
+    CalibrationStatus calibration;
+    uint32_t version = 0;
+
+    bool sameValues(const SensorState& other) const;
+};
+
+/**
+ * Gibt den Stand des Sensors von loop() an andere Kontexte weiter
+ * (Webserver, MQTT), ohne dass ein Leser Werte aus zwei Messungen mischt.
+ *
+ * Doppelpuffer mit Versionszähler: loop() schreibt immer in den Puffer, den
+ * gerade niemand liest, und schaltet danach mit der neuen Version um. Ein
+ * Leser kopiert den aktuellen Puffer und prüft danach die Version; hat sie
+ * sich während des Kopierens geändert, liest er erneut. Der Schreiber
+ * wartet nie auf einen Leser.
+ */
+class SensorSnapshot {
+   public:
+    bool publish(const SensorState& state);
+    SensorState read() const;
+    uint32_t version() const;
+
+   private:
+    SensorState buffers[2];
+    std::atomic<uint32_t> sequence{0};  // Puffer der aktuellen Version: sequence & 1
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "Uplink.h"
+
+#include "Metrics.h"
+
+#define UPLINK_SEQ_KEY "uplink_seq"
+
+Uplink::Uplink(LittleFSManager& store) : store(store) {}
+
+/**
+ * @brief Starts the uplink.
+ *
+ * Does nothing if no collector is configured (UPLINK_URL). Continues with
+ * the first reading that was not confirmed before the restart; on the very
+ * first start the whole history is sent. A saved position beyond the end
+ * of the history is moved back to the end.
+ *
+ * @param historyStore The history that holds the readings to send.
+ */
+void Uplink::begin(HistoryStore* historyStore) {
+    history = historyStore;
+    if (!history || !parseUrl(UPLINK_URL)) {
+        return;
+    }
+    enabled = true;
+    deviceId = "sensor-" + String(ESP.getChipId(), HEX);
+    ackedSeq = min((uint32_t)store.read(UPLINK_SEQ_KEY, (int)history->firstSeq()), history->endSeq());
+    nextUpload = millis();
+}
+
+/**
+ * @brief Splits the collector URL into host, port and path.
+ *
+ * @param url The URL in the form http://host[:port][/path].
+ * @return true if the URL is valid.
+ */
+bool Uplink::parseUrl(const char* url) {
+    UplinkUrl parts;
+    if (!uplinkParseUrl(url, parts)) {
+        if (strlen(url) > 0) {
+            Serial.println("Uplink::parseUrl --> ONLY http://host[:port][/path] IS SUPPORTED");
+        }
+        return false;
+    }
+    String value = url;
+    host = value.substring(parts.hostStart, parts.hostEnd);
+    port = parts.port;
+    path = parts.pathStart < value.length() ? value.substring(parts.pathStart) : "/";
+    return true;
+}
+
+/**
+ * @brief Drives the upload.
+ *
+ * Call this in every loop. Starts a POST when the upload window is due and
+ * WiFi is connected, sends the request as fast as the TCP buffer allows and
+ * evaluates the response.
+ */
+void Uplink::update() {
+    if (!enabled) {
+        return;
+    }
+    unsigned long now = millis();
+    uint32_t sent = max(ackedSeq, history->firstSeq());
+    metrics.uplinkBacklog = history->endSeq() > sent ? history->endSeq() - sent : 0;
+
+    if (!busy) {
+        if ((long)(now - nextUpload) < 0 || WiFi.status() != WL_CONNECTED) {
+            return;
+        }
+        if (!startBatch()) {
+            // Rückstand gesendet, Position einmal je Fenster speichern
+            if (unsaved) {
+                store.save(UPLINK_SEQ_KEY, (int)ackedSeq);
+                unsaved = false;
+            }
+            nextUpload = now + UPLINK_WINDOW_MS;
+        }
+        return;
+    }
+
+    if (status != 0) {
+        finishBatch();
+    } else if (closed) {
+        fail("CONNECTION CLOSED");
+    } else if (now - startedAt >= TIMEOUT_MS) {
+        fail("TIMEOUT");
+    } else if (connected) {
+        sendPending();
+    }
+}
+
+/**
+ * @brief Builds the next batch and opens the connection.
+ *
+ * @return false if there is nothing to send.
+ */
+bool Uplink::startBatch() {
+    uint32_t first = history->firstSeq();
+    if (ackedSeq < first) {
+        ackedSeq = first;  // im Ringspeicher überschrieben
+    }
+    uint32_t end = history->endSeq();
+    if (ackedSeq >= end) {
+        return false;
+    }
+
+    String body;
+    body.reserve(UPLINK_BATCH_MAX * 64);
+    uint32_t seq = uplinkAppendBatch(*history, ackedSeq, end, body);
+    if (seq == ackedSeq) {
+        return false;
+    }
+    if (body.length() == 0) {
+        ackedSeq = seq;  // nur Lücken, nichts zu senden
+        unsaved = true;
+        return startBatch();
+    }
+    batchEnd = seq;
+
+    request = "";
+    request.reserve(body.length() + 192);
+    request += "POST " + path + " HTTP/1.1\r\n";
+    request += "Host: " + host + "\r\n";
+    request += "Content-Type: application/x-ndjson\r\n";
+    request += "Content-Length: " + String(body.length()) + "\r\n";
+    request += "X-Device-Id: " + deviceId + "\r\n";
+    request += "Connection: close\r\n\r\n";
+    request += body;
+    requestPos = 0;
+
+    connected = false;
+    closed = false;
+    status = 0;
+    responseLen = 0;
+    startedAt = millis();
+    busy = true;
+
+    client = new AsyncClient();
+    client->onConnect([](void* arg, AsyncClient* c) { static_cast<Uplink*>(arg)->connected = true; }, this);
+    client->onDisconnect([](void* arg, AsyncClient* c) { static_cast<Uplink*>(arg)->closed = true; }, this);
+    client->onData([](void* arg, AsyncClient* c, void* data, size_t len) { static_cast<Uplink*>(arg)->handleData((const char*)data, len); }, this);
+    if (!client->connect(host.c_str(), port)) {
+        fail("CONNECT FAILED");
+    }
+    return true;
+}
+
+/**
+ * @brief Writes as much of the request as fits into the TCP send buffer.
+ *
+ * The request stays in RAM until the connection is closed, so it is not
+ * copied again by the TCP stack.
+ */
+void Uplink::sendPending() {
+    while (requestPos < request.length()) {
+        size_t space = client->space();
+        if (space == 0) {
+            return;
+        }
+        size_t added = client->add(request.c_str() + requestPos, min(space, request.length() - requestPos));
+        if (added == 0) {
+            return;
+        }
+        requestPos += added;
+        client->send();
+    }
+}
+
+/**
+ * @brief Reads the status line of the response.
+ *
+ * Called by AsyncClient. Only the status code is needed, the rest of the
+ * response is ignored.
+ */
+void Uplink::handleData(const char* data, size_t len) {
+    while (len > 0 && responseLen < sizeof(response) - 1) {
+        response[responseLen++] = *data++;
+        len--;
+    }
+    if (status == 0) {
+        status = uplinkParseStatus(response, responseLen);
+    }
+}
+
+/**
+ * @brief Evaluates the response of a POST.
+ *
+ * On success the batch counts as delivered. If more readings are waiting,
+ * the next batch is started right away, still within the same window.
+ */
+void Uplink::finishBatch() {
+    if (status < 200 || status >= 300) {
+        fail("HTTP ERROR");
+        return;
+    }
+    unsigned long latency = millis() - startedAt;
+    closeClient();
+
+    metrics.uplinkBatches++;
+    metrics.uplinkRecords += batchEnd - ackedSeq;
+    metrics.uplinkLastBatch = batchEnd - ackedSeq;
+    metrics.uplinkLatencyMillis += latency;
+
+    ackedSeq = batchEnd;
+    unsaved = true;
+    backoff = 0;
+    nextUpload = millis();
+}
+
+/**
+ * @brief Handles a failed POST.
+ *
+ * The batch is sent again after the backoff. The backoff doubles with each
+ * failure, and a random part of it is added so that many sensors do not
+ * retry at the same time after the collector comes back.
+ *
+ * @param reason The reason for the log.
+ */
+void Uplink::fail(const char* reason) {
+    Serial.println(String("Uplink::fail --> ") + reason);
+    closeClient();
+    metrics.uplinkFailures++;
+
+    backoff = uplinkNextBackoff(backoff, BACKOFF_MIN_MS, BACKOFF_MAX_MS);
+    nextUpload = millis() + uplinkRetryDelay(backoff, ESP.random());
+    if (unsaved) {
+        store.save(UPLINK_SEQ_KEY, (int)ackedSeq);
+        unsaved = false;
+    }
+}
+
+void Uplink::closeClient() {
+    if (client) {
+        client->close(true);
+        delete client;
+        client = nullptr;
+    }
+    request = "";
+    busy = false;
+}
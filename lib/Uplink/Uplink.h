@@ -0,0 +1,84 @@
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESPAsyncTCP.h>
+
+#include "HistoryStore.h"
+#include "LittleFSManager.h"
+#include "UplinkProtocol.h"
+
+// Collector, per build_flags setzen, z.B. '-D UPLINK_URL="http://192.168.1.10:8080/readings"'
+// Ohne UPLINK_URL ist der Upload aus. Nur http, kein https.
+#ifndef UPLINK_URL
+#define UPLINK_URL ""
+#endif
+#ifndef UPLINK_WINDOW_MS
+#define UPLINK_WINDOW_MS 300000UL  // Upload-Fenster: alle 5 Minuten
+#endif
+
+/**
+ * Sendet die Messwerte per HTTP POST an einen Collector (Store-and-forward).
+ *
+ * Die Messwerte kommen aus dem HistoryStore. Einmal je Upload-Fenster wird
+ * der gesamte Rückstand in Blöcken von UPLINK_BATCH_MAX Messwerten gesendet,
+ * danach bleibt die Verbindung bis zum nächsten Fenster zu. Der Body ist
+ * NDJSON, eine Zeile je Messwert mit der persistenten Sequenznummer, damit
+ * der Server doppelte Messwerte verwerfen kann. Die Sequenznummer des ersten
+ * noch nicht bestätigten Messwerts wird nach jedem erfolgreichen POST
+ * gespeichert. Bei Fehlern wird mit exponentiellem Backoff und Jitter
+ * erneut versucht.
+ *
+ * Die TCP-Verbindung ist asynchron, update() blockiert nie.
+ */
+class Uplink {
+   public:
+    static const unsigned long TIMEOUT_MS = 10000;
+    static const unsigned long BACKOFF_MIN_MS = 5000;
+    static const unsigned long BACKOFF_MAX_MS = 600000;
+
+    Uplink(LittleFSManager& store);
+
+    void begin(HistoryStore* history);
+    void update();
+
+   private:
+    LittleFSManager& store;
+    HistoryStore* history = nullptr;
+    AsyncClient* client = nullptr;
+
+    String host;
+    uint16_t port = 80;
+    String path;
+    String deviceId;
+
+    bool enabled = false;
+    bool busy = false;  // POST läuft
+    uint32_t ackedSeq = 0;  // erster noch nicht bestätigter Messwert
+    uint32_t batchEnd = 0;
+    bool unsaved = false;  // ackedSeq noch nicht gespeichert
+    unsigned long nextUpload = 0;
+    unsigned long backoff = 0;
+    unsigned long startedAt = 0;
+
+    String request;
+    size_t requestPos = 0;
+
+    // aus den Callbacks von AsyncClient gesetzt
+    bool connected = false;
+    bool closed = false;
+    int status = 0;
+    char response[13];
+    size_t responseLen = 0;
+
+    bool parseUrl(const char* url);
+    bool startBatch();
+    void sendPending();
+    void finishBatch();
+    void fail(const char* reason);
+    void closeClient();
+    void handleData(const char* data, size_t len);
+};
+
+#endif
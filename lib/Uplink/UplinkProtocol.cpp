@@ -0,0 +1,108 @@
+#include "UplinkProtocol.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Splits a collector URL into host, port and path.
+ *
+ * @param url The URL in the form http://host[:port][/path].
+ * @param parts Receives the positions of the parts.
+ * @return false for other schemes, an empty host or an invalid port.
+ */
+bool uplinkParseUrl(const char* url, UplinkUrl& parts) {
+    if (strncmp(url, "http://", 7) != 0) {
+        return false;
+    }
+    size_t length = strlen(url);
+    const char* slash = strchr(url + 7, '/');
+    parts.pathStart = slash ? slash - url : length;
+    parts.hostStart = 7;
+    parts.hostEnd = parts.pathStart;
+    parts.port = 80;
+
+    const char* colon = (const char*)memchr(url + 7, ':', parts.pathStart - 7);
+    if (colon) {
+        parts.hostEnd = colon - url;
+        uint32_t port = 0;
+        const char* digit = colon + 1;
+        if (digit == url + parts.pathStart) {
+            return false;
+        }
+        for (; digit < url + parts.pathStart; digit++) {
+            if (*digit < '0' || *digit > '9') {
+                return false;
+            }
+            port = port * 10 + (*digit - '0');
+            if (port > 65535) {
+                return false;
+            }
+        }
+        parts.port = port;
+    }
+    return parts.hostEnd > parts.hostStart && parts.port != 0;
+}
+
+/**
+ * @brief Reads the status code from the start of an HTTP response.
+ *
+ * @param response The bytes received so far.
+ * @param length The number of bytes.
+ * @return 0 while the status line is incomplete, -1 if it is not HTTP/1.x,
+ *         otherwise the status code.
+ */
+int uplinkParseStatus(const char* response, size_t length) {
+    // "HTTP/1.1 200"
+    if (length < 12) {
+        return 0;
+    }
+    if (strncmp(response, "HTTP/1.", 7) != 0 || response[8] != ' ') {
+        return -1;
+    }
+    int status = 0;
+    for (size_t i = 9; i < 12; i++) {
+        if (response[i] < '0' || response[i] > '9') {
+            return -1;
+        }
+        status = status * 10 + (response[i] - '0');
+    }
+    return status;
+}
+
+/**
+ * @brief Formats one reading as an NDJSON line.
+ *
+ * @return The length of the line.
+ */
+size_t uplinkFormatRecord(char* line, size_t size, uint32_t seq, const HistoryRecord& record) {
+    int length = snprintf(line, size, "{\"seq\":%lu,\"ts\":%lu,\"level\":%u,\"adc\":%u,\"flags\":%u}\n",
+                          (unsigned long)seq, (unsigned long)record.timestamp, record.level, record.adc, record.flags);
+    return length < 0 ? 0 : (size_t)length < size ? length : size - 1;
+}
+
+/**
+ * @brief Doubles the backoff after a failure.
+ *
+ * @param backoff The current backoff, 0 after a success.
+ * @return The new backoff between minimum and maximum.
+ */
+unsigned long uplinkNextBackoff(unsigned long backoff, unsigned long minimum, unsigned long maximum) {
+    if (backoff == 0) {
+        return minimum;
+    }
+    return backoff * 2 > maximum ? maximum : backoff * 2;
+}
+
+/**
+ * @brief Picks the delay before the next attempt.
+ *
+ * Half of the backoff is fixed, the other half random, so that many sensors
+ * do not retry at the same time after the collector comes back.
+ *
+ * @param backoff The current backoff.
+ * @param random A random number.
+ * @return A delay between backoff / 2 and backoff.
+ */
+unsigned long uplinkRetryDelay(unsigned long backoff, uint32_t random) {
+    return backoff / 2 + random % (backoff - backoff / 2 + 1);
+}
@@ -0,0 +1,63 @@
+#ifndef UPLINK_PROTOCOL_H
+#define UPLINK_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "HistoryRecord.h"
+
+#define UPLINK_BATCH_MAX 64  // max. Messwerte je POST
+
+/**
+ * Teile einer Collector-URL http://host[:port][/path] als Positionen in der
+ * URL. Ohne Pfad ist pathStart die Länge der URL, gesendet wird dann "/".
+ */
+struct UplinkUrl {
+    size_t hostStart;
+    size_t hostEnd;
+    uint16_t port;
+    size_t pathStart;
+};
+
+// Protokoll des Uploads ohne Netzwerk und Arduino-Core, damit es auch auf dem Host läuft
+bool uplinkParseUrl(const char* url, UplinkUrl& parts);
+int uplinkParseStatus(const char* response, size_t length);
+size_t uplinkFormatRecord(char* line, size_t size, uint32_t seq, const HistoryRecord& record);
+unsigned long uplinkNextBackoff(unsigned long backoff, unsigned long minimum, unsigned long maximum);
+unsigned long uplinkRetryDelay(unsigned long backoff, uint32_t random);
+
+/**
+ * Hängt den nächsten Batch ab `from` als NDJSON an `body` an, höchstens
+ * UPLINK_BATCH_MAX Messwerte und nicht über `end` hinaus. Lücken
+ * (HISTORY_FLAG_GAP) zählen mit, werden aber nicht angehängt.
+ *
+ * Die Quelle muss `size_t read(uint32_t seq, HistoryRecord* records, size_t max)`
+ * anbieten (z.B. HistoryStore), `body` muss `+= const char*` können.
+ *
+ * @return Sequenznummer nach dem letzten angehängten Messwert, `from` wenn nichts zu lesen war.
+ */
+template <typename Source, typename Body>
+uint32_t uplinkAppendBatch(Source& source, uint32_t from, uint32_t end, Body& body) {
+    const size_t BLOCK = 16;
+    HistoryRecord records[BLOCK];
+    char line[80];
+    uint32_t seq = from;
+    while (seq < end && seq - from < UPLINK_BATCH_MAX) {
+        uint32_t wanted = end - seq < UPLINK_BATCH_MAX - (seq - from) ? end - seq : UPLINK_BATCH_MAX - (seq - from);
+        size_t count = source.read(seq, records, wanted < BLOCK ? wanted : BLOCK);
+        if (count == 0) {
+            break;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (records[i].flags & HISTORY_FLAG_GAP) {
+                continue;
+            }
+            uplinkFormatRecord(line, sizeof(line), seq + i, records[i]);
+            body += line;
+        }
+        seq += count;
+    }
+    return seq;
+}
+
+#endif
@@ -0,0 +1,197 @@
+#include "NetworkList.h"
+
+#include "Metrics.h"
+
+/**
+ * @brief Reads the list from the networks file.
+ */
+void NetworkList::load() {
+    count = 0;
+    File file = LittleFS.open(NETWORKS_FILE, "r");
+    if (!file) {
+        return;
+    }
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        Serial.println("NetworkList::load --> INVALID " NETWORKS_FILE);
+        return;
+    }
+    for (JsonObjectConst entry : doc.as<JsonArrayConst>()) {
+        if (count >= WIFI_MAX_NETWORKS) {
+            break;
+        }
+        WifiNetwork& network = networks[count++];
+        network.ssid = entry["ssid"] | "";
+        network.password = entry["password"] | "";
+        network.priority = entry["priority"] | 0;
+        network.lastSuccess = entry["lastSuccess"] | 0;
+        successCounter = max(successCounter, network.lastSuccess);
+    }
+    sort();
+}
+
+/**
+ * @brief Writes the list to the networks file.
+ *
+ * Like the config file, the list is written to a temporary file first,
+ * which then replaces the networks file.
+ *
+ * @return true if the list is saved.
+ */
+bool NetworkList::save() {
+    JsonDocument doc;
+    JsonArray json = doc.to<JsonArray>();
+    for (size_t i = 0; i < count; i++) {
+        JsonObject entry = json.add<JsonObject>();
+        entry["ssid"] = networks[i].ssid;
+        entry["password"] = networks[i].password;
+        entry["priority"] = networks[i].priority;
+        entry["lastSuccess"] = networks[i].lastSuccess;
+    }
+
+    File file = LittleFS.open(NETWORKS_FILE_TMP, "w");
+    if (!file) {
+        Serial.println("NetworkList::save --> FAILED TO OPEN " NETWORKS_FILE_TMP);
+        return false;
+    }
+    size_t written = serializeJson(doc, file);
+    file.close();
+    metrics.countFlashWrite(FILE_NETWORKS, written);
+    return LittleFS.rename(NETWORKS_FILE_TMP, NETWORKS_FILE);
+}
+
+/**
+ * @brief Adds a network or updates its password and priority.
+ *
+ * @param ssid The network's SSID.
+ * @param password The network's password.
+ * @param priority The priority, higher values are preferred.
+ * @return true if the list changed.
+ */
+bool NetworkList::add(const String& ssid, const String& password, uint8_t priority) {
+    if (ssid.isEmpty()) {
+        return false;
+    }
+    int index = indexOf(ssid);
+    if (index < 0) {
+        // voll: das letzte Netz ist das unwichtigste
+        index = count < WIFI_MAX_NETWORKS ? count++ : WIFI_MAX_NETWORKS - 1;
+        networks[index].ssid = ssid;
+        networks[index].lastSuccess = 0;
+    } else if (networks[index].password == password && networks[index].priority == priority) {
+        return false;
+    }
+    networks[index].password = password;
+    networks[index].priority = priority;
+    sort();
+    changes++;
+    return true;
+}
+
+/**
+ * @brief Removes a network.
+ *
+ * @param ssid The network's SSID.
+ * @return true if the network was in the list.
+ */
+bool NetworkList::remove(const String& ssid) {
+    int index = indexOf(ssid);
+    if (index < 0) {
+        return false;
+    }
+    for (size_t i = index; i + 1 < count; i++) {
+        networks[i] = networks[i + 1];
+    }
+    networks[--count] = WifiNetwork();
+    changes++;
+    return true;
+}
+
+/**
+ * @brief Removes all networks.
+ */
+void NetworkList::clear() {
+    for (size_t i = 0; i < count; i++) {
+        networks[i] = WifiNetwork();
+    }
+    count = 0;
+    changes++;
+}
+
+/**
+ * @brief Marks a network as the last one connected successfully.
+ *
+ * Saves the list only if the network was not the last one already, so
+ * reconnects to the same network do not write to the flash.
+ *
+ * @param ssid The network's SSID.
+ */
+void NetworkList::markSuccess(const String& ssid) {
+    int index = indexOf(ssid);
+    if (index < 0 || (networks[index].lastSuccess == successCounter && successCounter != 0)) {
+        return;
+    }
+    networks[index].lastSuccess = ++successCounter;
+    sort();
+    changes++;
+    save();
+}
+
+const WifiNetwork* NetworkList::find(const String& ssid) const {
+    int index = indexOf(ssid);
+    return index < 0 ? nullptr : &networks[index];
+}
+
+const WifiNetwork& NetworkList::at(size_t index) const {
+    return networks[index];
+}
+
+size_t NetworkList::size() const {
+    return count;
+}
+
+uint32_t NetworkList::version() const {
+    return changes;
+}
+
+/**
+ * @brief Writes the list without passwords into a JSON array.
+ *
+ * @param json The JSON array to fill.
+ * @param connectedSsid The SSID of the current connection, empty if none.
+ */
+void NetworkList::toJson(JsonArray json, const String& connectedSsid) const {
+    for (size_t i = 0; i < count; i++) {
+        JsonObject entry = json.add<JsonObject>();
+        entry["ssid"] = networks[i].ssid;
+        entry["priority"] = networks[i].priority;
+        entry["secured"] = !networks[i].password.isEmpty();
+        entry["lastUsed"] = networks[i].lastSuccess == successCounter && successCounter != 0;
+        entry["connected"] = networks[i].ssid == connectedSsid;
+    }
+}
+
+int NetworkList::indexOf(const String& ssid) const {
+    for (size_t i = 0; i < count; i++) {
+        if (networks[i].ssid == ssid) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Insertion Sort, die Liste ist klein und fast immer schon sortiert
+void NetworkList::sort() {
+    for (size_t i = 1; i < count; i++) {
+        WifiNetwork network = networks[i];
+        size_t j = i;
+        while (j > 0 && (networks[j - 1].priority < network.priority ||
+                         (networks[j - 1].priority == network.priority && networks[j - 1].lastSuccess < network.lastSuccess))) {
+            networks[j] = networks[j - 1];
+            j--;
+        }
+        networks[j] = network;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef NETWORK_LIST_H
+#define NETWORK_LIST_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+#define NETWORKS_FILE "/networks.json"
+#define NETWORKS_FILE_TMP "/networks.json.tmp"
+
+// Anzahl der gespeicherten WLAN-Netze
+#ifndef WIFI_MAX_NETWORKS
+#define WIFI_MAX_NETWORKS 5
+#endif
+
+/**
+ * Ein bekanntes WLAN-Netz. `lastSuccess` ist eine fortlaufende Nummer der
+ * erfolgreichen Verbindungen, das zuletzt genutzte Netz hat die höchste.
+ */
+struct WifiNetwork {
+    String ssid;
+    String password;
+    uint8_t priority = 0;  // höher = bevorzugt
+    uint32_t lastSuccess = 0;
+};
+
+/**
+ * Liste der bekannten WLAN-Netze, sortiert nach Priorität und danach nach
+ * der letzten erfolgreichen Verbindung. Ist die Liste voll, ersetzt ein
+ * neues Netz das am längsten nicht genutzte mit der niedrigsten Priorität.
+ */
+class NetworkList {
+   public:
+    void load();
+    bool save();
+
+    bool add(const String& ssid, const String& password, uint8_t priority);
+    bool remove(const String& ssid);
+    void clear();
+    void markSuccess(const String& ssid);
+
+    const WifiNetwork* find(const String& ssid) const;
+    const WifiNetwork& at(size_t index) const;
+    size_t size() const;
+    uint32_t version() const;  // ändert sich mit jeder Änderung der Liste
+
+    void toJson(JsonArray json, const String& connectedSsid) const;
+
+   private:
+    WifiNetwork networks[WIFI_MAX_NETWORKS];
+    size_t count = 0;
+    uint32_t successCounter = 0;
+    uint32_t changes = 0;
+
+    int indexOf(const String& ssid) const;
+    void sort();
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include "WifiConnection.h"
+
+#include "Metrics.h"
+
+/**
+ * @brief Starts connecting to the known networks.
+ *
+ * Returns immediately; the connection is built up by update(). The SDK is
+ * told not to store the credentials and not to reconnect on its own, so
+ * retries do not write to the flash and follow the backoff.
+ *
+ * @param list The known networks, may be empty.
+ * @param scanService The scan service shared with the portal.
+ */
+void WifiConnection::begin(NetworkList* list, ScanService* scanService) {
+    networks = list;
+    scans = scanService;
+    WiFi.persistent(false);
+    WiFi.setAutoReconnect(false);
+    backoff = 0;
+    fastPathFailed = false;
+    if (staticIp.fromString(WIFI_STATIC_IP)) {
+        staticGateway.fromString(WIFI_GATEWAY);
+        staticSubnet.fromString(WIFI_SUBNET);
+        if (!staticDns.fromString(WIFI_DNS)) {
+            staticDns = staticGateway;
+        }
+    }
+    if (!hasCredentials()) {
+        setState(WIFI_NO_CREDENTIALS);
+        return;
+    }
+    connect();
+}
+
+/**
+ * @brief Advances the connection state.
+ *
+ * Call this in every loop. Evaluates the scan, detects a finished or failed
+ * attempt, a lost connection and the end of the backoff pause.
+ */
+void WifiConnection::update() {
+    unsigned long now = millis();
+    wl_status_t status = WiFi.status();
+
+    switch (current) {
+        case WIFI_SCANNING:
+            handleScan(now);
+            break;
+        case WIFI_CONNECTING:
+            if (status == WL_CONNECTED) {
+                connected(now);
+            } else if (fastPath && (status == WL_NO_SSID_AVAIL || status == WL_CONNECT_FAILED || now - attemptStart >= FAST_CONNECT_TIMEOUT_MS)) {
+                // AP hat Kanal oder BSSID gewechselt: sofort mit Scan verbinden
+                Serial.println("WifiConnection::update --> FAST CONNECT FAILED");
+                fastPathFailed = true;
+                WiFi.disconnect(false);
+                connect();
+            } else if (status == WL_NO_SSID_AVAIL || status == WL_CONNECT_FAILED || now - attemptStart >= CONNECT_TIMEOUT_MS) {
+                fail(now, "FAILED TO CONNECT");
+            }
+            break;
+        case WIFI_CONNECTED:
+            if (status != WL_CONNECTED) {
+                Serial.println("WifiConnection::update --> CONNECTION LOST");
+                connect();
+            }
+            break;
+        case WIFI_WAITING:
+            if ((long)(now - retryAt) >= 0) {
+                connect();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Connects to a network now, e.g. after it was added.
+ *
+ * The network is preferred in the next scan if it is in range.
+ *
+ * @param ssid The network's SSID, empty to pick the best known network.
+ */
+void WifiConnection::connectTo(const String& ssid) {
+    preferred = ssid;
+    backoff = 0;
+    if (!hasCredentials()) {
+        WiFi.disconnect(false);
+        setState(WIFI_NO_CREDENTIALS);
+        return;
+    }
+    WiFi.disconnect(false);
+    connect();
+}
+
+/**
+ * @brief Starts a connection attempt.
+ *
+ * Connects directly to the cached access point if it belongs to a known
+ * network and the fast path did not fail before. Otherwise one scan is
+ * started, and the best known network in range is chosen from its results.
+ */
+void WifiConnection::connect() {
+    attemptStart = millis();
+    const WifiNetwork* network = nullptr;
+    if (!fastPathFailed && preferred.isEmpty() && cache.valid()) {
+        network = networks->find(cache.ssid);
+    }
+    if (network) {
+        startAttempt(*network, cache.channel, cache.bssid, true);
+        return;
+    }
+    scanGeneration = scans->generation();
+    scans->start();
+    setState(WIFI_SCANNING);
+}
+
+/**
+ * @brief Picks the network to connect to from the scan results.
+ *
+ * A preferred network wins if it is in range. Otherwise the network with
+ * the highest priority is chosen, and among equal priorities the one with
+ * the strongest signal. The attempt uses channel and BSSID of the scan
+ * result, so the SDK does not scan again. A scan the portal started just
+ * before is used as well.
+ */
+void WifiConnection::handleScan(unsigned long now) {
+    if (scans->generation() == scanGeneration) {
+        return;
+    }
+    if (scans->failed()) {
+        fail(now, "SCAN FAILED");
+        return;
+    }
+
+    // Die Ergebnisse sind nach Signalstärke sortiert
+    const WifiNetwork* best = nullptr;
+    const ScanResult* bestResult = nullptr;
+    for (size_t i = 0; i < scans->size(); i++) {
+        const ScanResult& result = scans->at(i);
+        const WifiNetwork* network = networks->find(result.ssid);
+        if (!network) {
+            continue;
+        }
+        if (!preferred.isEmpty() && network->ssid == preferred) {
+            best = network;
+            bestResult = &result;
+            break;
+        }
+        if (!best || network->priority > best->priority) {
+            best = network;
+            bestResult = &result;
+        }
+    }
+    if (!best) {
+        fail(now, "NO KNOWN NETWORK IN RANGE");
+        return;
+    }
+    startAttempt(*best, bestResult->channel, bestResult->bssid, false);
+}
+
+/**
+ * @brief Connects to a network.
+ *
+ * The IP configuration is a static address, the cached lease
+ * (WIFI_REUSE_LEASE, fast path only) or DHCP.
+ */
+void WifiConnection::startAttempt(const WifiNetwork& network, int32_t channel, const uint8_t* bssid, bool fast) {
+    attempts++;
+    attemptStart = millis();
+    fastPath = fast;
+    ssid = network.ssid;
+
+    if (staticIp.isSet()) {
+        WiFi.config(staticIp, staticGateway, staticSubnet, staticDns);
+    } else if (fastPath && WIFI_REUSE_LEASE && cache.ip != 0) {
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+    } else {
+        WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));  // DHCP
+    }
+
+    WiFi.begin(network.ssid.c_str(), network.password.c_str(), channel, bssid, true);
+    setState(WIFI_CONNECTING);
+}
+
+/**
+ * @brief Handles a failed attempt and schedules the next one.
+ */
+void WifiConnection::fail(unsigned long now, const char* reason) {
+    lastAttemptMillis = now - attemptStart;
+    failures++;
+    WiFi.disconnect(false);
+    // Pause verdoppeln, die Hälfte davon zufällig, damit nach einem
+    // Router-Neustart nicht alle Sensoren gleichzeitig verbinden
+    backoff = backoff == 0 ? BACKOFF_MIN_MS : (backoff * 2 > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : backoff * 2);
+    retryAt = now + backoff / 2 + ESP.random() % (backoff / 2 + 1);
+    Serial.println(String("WifiConnection::update --> ") + reason + ", RETRY IN " + String((retryAt - now) / 1000) + "s");
+    setState(WIFI_WAITING);
+}
+
+/**
+ * @brief Handles a successful connection attempt.
+ *
+ * Records the time since boot for the first connection, marks the network
+ * as last used and updates the cache; both are only saved if something
+ * changed.
+ */
+void WifiConnection::connected(unsigned long now) {
+    lastAttemptMillis = now - attemptStart;
+    connectedSince = now;
+    backoff = 0;
+    fastConnected = fastPath;
+    fastPathFailed = false;
+    preferred = "";
+    if (bootToConnectedMillis == 0) {
+        bootToConnectedMillis = now;
+        metrics.wifiBootToConnectedMillis = now;
+    }
+    Serial.println("WifiConnection::update --> CONNECTED: " + ssid + " " + WiFi.localIP().toString() + (fastPath ? " (FAST)" : "") + " after " + String(now) + "ms");
+    networks->markSuccess(ssid);
+
+    WifiCache current;
+    current.ssid = ssid;
+    memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+    current.channel = WiFi.channel();
+    current.ip = WiFi.localIP();
+    current.gateway = WiFi.gatewayIP();
+    current.subnet = WiFi.subnetMask();
+    current.dns = WiFi.dnsIP(0);
+    if (!current.equals(cache)) {
+        cache = current;
+        if (onCacheChangedCallback) {
+            onCacheChangedCallback(cache);
+        }
+    }
+    setState(WIFI_CONNECTED);
+}
+
+/**
+ * @brief Sets the data of the last connection, loaded after a restart.
+ *
+ * @param value The cached connection data.
+ */
+void WifiConnection::setCache(const WifiCache& value) {
+    cache = value;
+}
+
+/**
+ * @brief Registers a callback for changed connection data.
+ *
+ * @param callback The function that saves the cache.
+ */
+void WifiConnection::onCacheChanged(std::function<void(const WifiCache&)> callback) {
+    onCacheChangedCallback = callback;
+}
+
+void WifiConnection::setState(WifiState state) {
+    current = state;
+    changes++;
+}
+
+WifiState WifiConnection::state() {
+    return current;
+}
+
+/**
+ * @brief Returns the state as shown in /status.
+ */
+const char* WifiConnection::stateName() {
+    switch (current) {
+        case WIFI_SCANNING:
+            return "scanning";
+        case WIFI_CONNECTING:
+            return "connecting";
+        case WIFI_CONNECTED:
+            return "connected";
+        case WIFI_WAITING:
+            return "waiting";
+        default:
+            return "unconfigured";
+    }
+}
+
+/**
+ * @brief Returns the SSID of the current or last attempted network.
+ */
+const String& WifiConnection::currentSsid() {
+    return ssid;
+}
+
+bool WifiConnection::hasCredentials() {
+    return networks && networks->size() > 0;
+}
+
+uint32_t WifiConnection::version() {
+    return changes;
+}
@@ -0,0 +1,110 @@
+#ifndef WIFI_CONNECTION_H
+#define WIFI_CONNECTION_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "ConfigStore.h"
+#include "NetworkList.h"
+#include "ScanService.h"
+
+// Feste IP-Adresse per build_flags, z.B. '-D WIFI_STATIC_IP="192.168.1.50"'
+#ifndef WIFI_STATIC_IP
+#define WIFI_STATIC_IP ""
+#endif
+#ifndef WIFI_GATEWAY
+#define WIFI_GATEWAY ""
+#endif
+#ifndef WIFI_SUBNET
+#define WIFI_SUBNET "255.255.255.0"
+#endif
+#ifndef WIFI_DNS
+#define WIFI_DNS ""
+#endif
+// 1 = zwischengespeicherte DHCP-Adresse beim schnellen Verbinden wiederverwenden.
+// Nur mit einer DHCP-Reservierung im Router nutzen, sonst droht ein Adresskonflikt.
+#ifndef WIFI_REUSE_LEASE
+#define WIFI_REUSE_LEASE 0
+#endif
+
+enum WifiState { WIFI_NO_CREDENTIALS,
+                 WIFI_SCANNING,
+                 WIFI_CONNECTING,
+                 WIFI_CONNECTED,
+                 WIFI_WAITING };
+
+/**
+ * Baut die WLAN-Verbindung im Hintergrund auf, ohne loop() zu blockieren.
+ *
+ * Schlägt ein Versuch fehl, wird nach einer mit jedem Fehlschlag
+ * wachsenden Pause (mit Jitter) erneut verbunden. Die Zugangsdaten bleiben
+ * dabei erhalten, ein Neustart des Routers führt also nicht mehr dazu,
+ * dass der Sensor neu eingerichtet werden muss. Versuche und ihre Dauer
+ * werden für /status mitgezählt.
+ *
+ * Nach einem Neustart wird zuerst direkt der zuletzt genutzte Access Point
+ * auf seinem Kanal angesprochen (ohne Scan). Klappt das nicht, folgt sofort
+ * ein normaler Verbindungsaufbau mit Scan.
+ *
+ * Es können mehrere Netze bekannt sein (NetworkList). Ein einziger Scan
+ * entscheidet, welches davon verbunden wird: zuerst nach Priorität, dann
+ * nach Signalstärke.
+ */
+class WifiConnection {
+   public:
+    static const unsigned long CONNECT_TIMEOUT_MS = 15000;
+    static const unsigned long FAST_CONNECT_TIMEOUT_MS = 5000;
+    static const unsigned long BACKOFF_MIN_MS = 5000;
+    static const unsigned long BACKOFF_MAX_MS = 300000;
+
+    void begin(NetworkList* list, ScanService* scanService);
+    void update();
+    void connectTo(const String& ssid);
+    void setCache(const WifiCache& value);
+    void onCacheChanged(std::function<void(const WifiCache&)> callback);
+
+    WifiState state();
+    const char* stateName();
+    const String& currentSsid();
+    bool hasCredentials();
+    uint32_t version();  // ändert sich mit jedem Zustandswechsel
+
+    // Statistik
+    uint32_t attempts = 0;
+    uint32_t failures = 0;
+    unsigned long lastAttemptMillis = 0;  // Dauer des letzten abgeschlossenen Versuchs
+    unsigned long connectedSince = 0;
+    unsigned long bootToConnectedMillis = 0;  // 0 = noch nicht verbunden
+    bool fastConnected = false;               // letzte Verbindung ohne Scan
+
+   private:
+    NetworkList* networks = nullptr;
+    ScanService* scans = nullptr;
+    uint32_t scanGeneration = 0;  // Stand des Scans beim Start des Versuchs
+    String ssid;       // Netz des laufenden bzw. letzten Versuchs
+    String preferred;  // bei connectTo() gewähltes Netz
+    WifiState current = WIFI_NO_CREDENTIALS;
+    uint32_t changes = 0;
+    unsigned long attemptStart = 0;
+    unsigned long retryAt = 0;
+    unsigned long backoff = 0;
+
+    WifiCache cache;
+    bool fastPath = false;        // laufender Versuch nutzt den Cache
+    bool fastPathFailed = false;  // bis zur nächsten Verbindung normal verbinden
+    IPAddress staticIp;
+    IPAddress staticGateway;
+    IPAddress staticSubnet;
+    IPAddress staticDns;
+
+    std::function<void(const WifiCache&)> onCacheChangedCallback;
+
+    void connect();
+    void handleScan(unsigned long now);
+    void startAttempt(const WifiNetwork& network, int32_t channel, const uint8_t* bssid, bool fast);
+    void fail(unsigned long now, const char* reason);
+    void connected(unsigned long now);
+    void setState(WifiState state);
+};
+
+#endif
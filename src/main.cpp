@@ -1,9 +1,17 @@
 #include "ButtonController.h"
 #include "CPortal.h"
+#include "Calibration.h"
+#include "CommandQueue.h"
+#include "ConfigStore.h"
+#include "HistoryStore.h"
 #include "LEDController.h"
 #include "LittleFSManager.h"
 #include "Menu.h"
+#include "Metrics.h"
+#include "MqttPublisher.h"
 #include "NoiascaCurrentLoop.h"
+#include "SensorSnapshot.h"
+#include "Uplink.h"
 
 // Current Loop Sensor Definitionen START
 #define STEP_UP_PIN D5          // Pin der den Step-Up über die Transistoren schaltet
@@ -19,16 +27,21 @@ const uint16_t maxDisplayValue = 8;  // max value of sensor at 20mA
 static unsigned int sensorLevel = 0;
 static unsigned int sensorAdc = 0;
 static unsigned long measureInterval = 6;  // 1 Second
-bool changingMeasureAdc = false;
 
 static unsigned int measureTimestamp = millis();
+static bool restartMeasureCycle = false;  // nach einer Kalibrierung ist der Step-Up aus
 
 CurrentLoopSensor pressureSensor(sensorPin, resistor, vref, maxDisplayValue);
+Calibration calibration(pressureSensor, STEP_UP_PIN);
 // Current Loop Sensor Definitionen END
 
 // LED Definitionen START
 #define LED_PIN 2
+// Anzahl der LEDs am Strip, z. B. -D NUM_LEDS=60
+#ifndef NUM_LEDS
 #define NUM_LEDS 8
+#endif
+// Optional: Aufteilung in Segmente, z. B. -D LED_SEGMENTS="30,-30" (negativ = umgekehrt montiert)
 #define LED_BRIGHTNESS 50
 // LED Definitionen END
 
@@ -40,6 +53,12 @@ const int PIN_BUTTON_RED = D7;
 // Erzeuge eine Instanz des LittleFSManagers mit debug option
 LittleFSManager store(false);
 
+// Erzeuge eine Instanz des Einstellungs-Speichers
+ConfigStore config;
+
+// Erzeuge eine Instanz des Messwert-Speichers
+HistoryStore history;
+
 // Erzeuge eine Instanz des LEDControllers
 LEDController ledController(LED_PIN, NUM_LEDS, LED_BRIGHTNESS);
 
@@ -47,11 +66,21 @@ LEDController ledController(LED_PIN, NUM_LEDS, LED_BRIGHTNESS);
 ButtonController buttons(PIN_BUTTON_BLACK, PIN_BUTTON_RED);
 
 // Erstellen einer Instanz der Menu-Klasse
-Menu menu(7);
+Menu menu;
+#define MENU_STEP_MIN_ADC 3  // Eintrag "Minimum setzen", für die Tastenkombination
 
 // Erstellen einer Instanz der CaptivePortal-Klasse
 CPortal portal;
 
+// Stand des Sensors für Webserver und MQTT
+SensorSnapshot snapshot;
+
+// Erstellen einer Instanz des MQTT-Publishers
+MqttPublisher mqtt(store);
+
+// Erstellen einer Instanz des HTTP-Uploads
+Uplink uplink(store);
+
 /**
  * @brief Restart the ESP.
  *
@@ -60,6 +89,7 @@ CPortal portal;
  * requested.
  */
 void restart() {
+    history.flush();
     delay(1000);
     ESP.restart();
 }
@@ -112,103 +142,185 @@ void handleRedButtonPress() {
 }
 
 /**
- * @brief Handle changed measurement interval.
+ * @brief Handle a long press of the red button.
  *
- * This function is called when the measurement interval is changed
- * via the captive portal. It saves the new interval to the EEPROM
- * and updates the menu with the new interval.
+ * Closes the open menu entry or leaves the menu at once instead of
+ * waiting for its timeout.
+ */
+void handleRedLongPress() {
+    menu.back();
+}
+
+/**
+ * @brief Handle a double press of the black button.
  *
- * @param interval The new measurement interval.
+ * Goes back to the previous menu step.
  */
-void handleIntervalChanged(unsigned int interval) {
-    digitalWrite(STEP_UP_PIN, LOW);
-    measureInterval = interval;
-    store.save("interval", measureInterval);
-    menu.setInterval(measureInterval);
+void handleBlackDoublePress() {
+    menu.previousStep();
+}
+
+/**
+ * @brief Handle pressing both buttons together.
+ *
+ * Opens the menu directly at the step that sets the sensor minimum.
+ */
+void handleButtonChord() {
+    menu.openStep(MENU_STEP_MIN_ADC);
 }
 
 /**
- * @brief Handle changed ADC value.
+ * @brief Publishes the current sensor state.
  *
- * This function is called when the ADC value is changed via the captive
- * portal. It saves the new value to the EEPROM and updates the sensor
- * with the new value.
+ * Called after a measurement and after changed settings. The captive portal
+ * only rebuilds its responses when a new state was published.
+ */
+void publishSnapshot() {
+    SensorState state;
+    state.level = sensorLevel;
+    state.adc = sensorAdc;
+    state.adcMin = pressureSensor.getMinAdcValue();
+    state.adcMax = pressureSensor.getMaxAdcValue();
+    state.timestamp = measureTimestamp;
+    state.interval = measureInterval;
+    state.upsideDown = ledController.isUpsideDown();
+    state.calibration = calibration.status();
+    snapshot.publish(state);
+}
+
+/**
+ * @brief Applies and saves changed settings.
+ *
+ * This function applies all settings contained in the patch to the sensor
+ * and the LED strip, and saves them with a single write. The saved
+ * settings are passed on to the captive portal.
  *
- * @param which The type of value to set. Either "min" or "max".
- * @param value The new value.
+ * @param patch The changed settings.
  */
-void handleAdcChanged(String which, int value) {
-    if (which == "min") {
-        store.save("minAdcValue", value);
-        pressureSensor.setMinAdcValue(value);
-    } else if (which == "max") {
-        store.save("maxAdcValue", value);
-        pressureSensor.setMaxAdcValue(value);
+void applyConfig(const ConfigPatch& patch) {
+    if (patch.has(CONFIG_INTERVAL)) {
+        // Eine laufende Kalibrierung braucht den Step-Up, sie schaltet ihn selbst aus
+        if (!calibration.running()) {
+            digitalWrite(STEP_UP_PIN, LOW);
+        }
+        measureInterval = patch.values.interval;
+    }
+    if (patch.has(CONFIG_BRIGHTNESS)) {
+        ledController.setBrightness(patch.values.brightness);
+    }
+    if (patch.has(CONFIG_UPSIDE_DOWN)) {
+        ledController.setUpsideDown(patch.values.upsideDown);
+    }
+    // 0 steht für den Standardwert der Library
+    if (patch.has(CONFIG_MIN_ADC)) {
+        pressureSensor.setMinAdcValue(patch.values.minAdc != 0 ? patch.values.minAdc : CURRENT_LOOP_DEFAULT_MIN_ADC);
     }
+    if (patch.has(CONFIG_MAX_ADC)) {
+        pressureSensor.setMaxAdcValue(patch.values.maxAdc != 0 ? patch.values.maxAdc : CURRENT_LOOP_DEFAULT_MAX_ADC);
+    }
+    config.apply(patch);
+    config.commit();
+    portal.setConfig(config.get());
+    mqtt.setConfig(config.get());
+    publishSnapshot();
 }
 
 /**
- * @brief Callback function for the menu apply button.
+ * @brief Handle changed settings.
+ *
+ * This function is called for settings changed via the captive portal or
+ * MQTT. It applies and saves all changes at once and shows the apply
+ * animation if the LED direction was changed.
  *
- * This function is called when the apply button is pressed in the menu.
- * It updates the LED strip with the current menu step and keeps the menu
- * active.
+ * @param patch The changed settings.
  */
-void handleMenuApplyCallback() {
-    ledController.menuIndicator(menu.currentStep());
-    menu.keepAlive();
+void handleConfigChanged(const ConfigPatch& patch) {
+    applyConfig(patch);
+    if (patch.has(CONFIG_UPSIDE_DOWN)) {
+        ledController.applyAnimation();
+    }
+}
+
+/**
+ * @brief Applies the commands queued by the network callbacks.
+ *
+ * The web server and the MQTT client only queue their commands, so flash
+ * writes, the step-up pin and LED animations are only touched from loop().
+ * Config changes are validated again against the settings at the time they
+ * are applied, and dropped if an earlier change made them invalid. The
+ * captive portal is told the result, so it can answer the waiting request.
+ */
+void handleCommands() {
+    Command command;
+    while (commands.pop(command)) {
+        switch (command.type) {
+            case COMMAND_CONFIG: {
+                // Geprüft wurde beim Einreihen; ein früherer Befehl kann die Werte inzwischen geändert haben
+                String error;
+                if (!command.patch.validate(config.get(), error)) {
+                    Serial.println("handleCommands --> DROPPED: " + error);
+                    metrics.commandsInvalid++;
+                    portal.finishCommand(command.id, error);
+                    continue;  // nicht angewendet, zählt nicht zu sensor_commands_total
+                }
+                handleConfigChanged(command.patch);
+                portal.finishCommand(command.id, "");
+                break;
+            }
+            case COMMAND_CALIBRATE:
+                calibration.start(command.target);
+                break;
+            case COMMAND_CALIBRATION_CANCEL:
+                calibration.cancel();
+                break;
+        }
+        metrics.recordCommand(micros() - command.queuedAt);
+    }
 }
 
 /**
- * @brief Handle LED direction change.
+ * @brief Handle changed WiFi connection data.
  *
- * This function is called when the LED direction needs to be changed.
- * It updates the LED strip's orientation, saves the new state to persistent
- * storage, and applies an animation to reflect the change.
+ * This function is called after a WiFi connection with a different access
+ * point, channel or IP configuration. The data is saved for a fast
+ * reconnect after the next restart.
  *
- * @param upsideDown A boolean indicating the new LED direction state.
+ * @param cache The connection data.
  */
-void handleLedDirectionChanged(boolean upsideDown) {
-    Serial.println("Led direction changed to: " + String(upsideDown));
-    ledController.setUpsideDown(upsideDown);
-    store.save("upsideDown", upsideDown);
-    ledController.applyAnimation();
+void handleWifiCacheChanged(const WifiCache& cache) {
+    ConfigStore::saveWifiCache(cache);
 }
 
 /**
- * @brief Handle menu next step.
+ * @brief Handle changed measurement interval.
+ *
+ * This function is called when the measurement interval is changed.
+ * It saves the new interval and updates the menu with the new interval.
  *
- * This function is called when the menu next step button is pressed. It
- * updates the LED strip with the current menu step and keeps the menu
- * active.
+ * @param interval The new measurement interval.
  */
-void handleMenuNextStep() {
-    ledController.menuIndicator(menu.currentStep());
+void handleIntervalChanged(unsigned int interval) {
+    ConfigPatch patch;
+    patch.setInterval(interval);
+    applyConfig(patch);
 }
 
 /**
- * @brief Handles menu selection.
+ * @brief Handle a calibrated ADC value.
+ *
+ * Saves the mean of a finished calibration as new minimum or maximum,
+ * together with the confidence of the calibration.
  *
- * This function is called when a menu item is selected. It checks if the
- * first or second menu is active and exits the sub menu, updates the LED
- * strip with the current menu step, and keeps the menu active. If the
- * first menu is active, it also saves the current brightness to persistent
- * storage. If the second menu is active, it saves the current interval to
- * persistent storage. If neither menu is active, it just updates the LED
- * strip with the current menu step.
+ * @param status The finished calibration.
  */
-void handleMenuSelected() {
-    if (menu.isFirstMenuActive() == true) {
-        menu.exitSubMenu();
-        ledController.applyAnimation(handleMenuNextStep);
-        store.save("brightness", menu.currentBrightness());
-    } else if (menu.isSecondMenuActive() == true) {
-        menu.exitSubMenu();
-        ledController.applyAnimation(handleMenuNextStep);
-        handleIntervalChanged(menu.currentInterval());
+void handleAdcChanged(const CalibrationStatus& status) {
+    ConfigPatch patch;
+    if (status.target == CALIBRATION_MIN) {
+        patch.setMinAdc(status.mean, status.confidence);
     } else {
-        ledController.menuActiveAnimation(menu.currentStep());
+        patch.setMaxAdc(status.mean, status.confidence);
     }
+    applyConfig(patch);
 }
 
 /**
@@ -223,116 +335,161 @@ void handleSuccess() {
 }
 
 /**
- * @brief Handle menu apply.
- *
- * This function is called when a menu item is selected. It checks which menu
- * item was selected and applies the corresponding action. If the selected
- * menu item is the first or second menu, it saves the current brightness and
- * interval to persistent storage, respectively. If the selected menu item is
- * the third or fourth menu, it sets the minimum and maximum sensor value,
- * respectively. If the selected menu item is the fifth menu, it toggles the
- * LED strip upside down. If the selected menu item is the sixth menu, it
- * restarts the machine. If the selected menu item is the seventh menu, it
- * exits the menu. In all cases, it applies an animation to the LED strip to
- * visually indicate the success state to the user.
- */
-void handleMenuApply() {
-    // Serial.println("Main -> Menu wurde akzeptiert | step: " + String(menu.currentStep()));
-    if (menu.currentStep() == 3) {
-        // SET MINIMUM SENSOR VALUE
-        changingMeasureAdc = true;
-        digitalWrite(STEP_UP_PIN, HIGH);
-        pressureSensor.getValue();
-        sensorAdc = pressureSensor.getAdc();
-        store.save("minAdcValue", sensorAdc);
-        pressureSensor.setMinAdcValue(sensorAdc);
-        ledController.applyAnimation(handleMenuApplyCallback);
-        delay(1000);
-        changingMeasureAdc = false;
-        digitalWrite(STEP_UP_PIN, LOW);
-
-    } else if (menu.currentStep() == 4) {
-        // SET MAXIMUM SENSOR VALUE
-        changingMeasureAdc = true;
-        digitalWrite(STEP_UP_PIN, HIGH);
-        pressureSensor.getValue();
-        sensorAdc = pressureSensor.getAdc();
-        store.save("maxAdcValue", sensorAdc);
-        pressureSensor.setMaxAdcValue(sensorAdc);
-        ledController.applyAnimation(handleMenuApplyCallback);
-        delay(1000);
-        changingMeasureAdc = false;
-        digitalWrite(STEP_UP_PIN, LOW);
-    } else if (menu.currentStep() == 5) {
-        // UPSIDEDOWN MENU
-        bool upsideDown = ledController.isUpsideDown();
-        ledController.setUpsideDown(!upsideDown);
-        store.save("upsideDown", !upsideDown);
-        ledController.applyAnimation(handleMenuApplyCallback);
-    } else if (menu.currentStep() == 6) {
-        // RESET MACHINE
-        ledController.shutdownAnimation(onReset);
-        onReset();
-    } else if (menu.currentStep() == 7) {
-        // RESTART MACHINE
-        ledController.applyAnimation(restart);
-    } else {
-        // EVERYTHING ELSE
-        ledController.applyAnimation(handleMenuApplyCallback);
-    }
+ * @brief Keeps the menu open after an apply animation.
+ */
+void handleMenuApplied() {
+    menu.keepAlive();
 }
 
 /**
  * @brief Handles menu exit.
  *
- * This function is called when the menu exit button is pressed. It clears the
- * LED strip and exits the menu.
+ * This function is called when the menu is exited. It removes the menu from
+ * the LED strip, so the level display below is visible again.
  */
 void handleMenuExit() {
-    ledController.clear();
+    ledController.clearMenu();
 }
 
 /**
- * @brief Enter the brightness menu.
+ * @brief Shows the selected menu entry.
  *
- * This function is called when the brightness menu is entered. It displays the
- * current brightness on the LED strip.
+ * @param depth 0 on the top level, 1 in a submenu.
+ * @param page The page of the current level.
+ * @param position The entry on its page, counted from 1.
  */
-void enterBrightnessMenu() {
-    ledController.menuValueSelection(menu.currentBrightness());
+void renderMenuNavigation(uint8_t depth, uint8_t page, uint8_t position) {
+    ledController.menuIndicator(position, depth + page);
 }
 
 /**
- * @brief Enter the interval menu.
- *
- * This function is called when the interval menu is entered. It displays the
- * current interval on the LED strip.
+ * @brief Shows the selected option of an open value entry.
  */
-void enterIntervalMenu() {
-    ledController.menuValueSelection(menu.currentInterval());
+void renderMenuValue(uint8_t position, uint8_t option) {
+    ledController.menuValueSelection(option);
 }
 
 /**
- * @brief Updates the LED brightness.
+ * @brief Lets an armed entry blink until it is confirmed or cancelled.
+ */
+void renderMenuConfirm(uint8_t position, uint8_t option) {
+    ledController.menuActiveAnimation(position);
+}
+
+uint8_t menuBrightness() {
+    return config.get().brightness;
+}
+
+/**
+ * @brief Shows a brightness while it is selected in the menu.
+ */
+void previewBrightness(uint8_t value) {
+    ledController.setBrightness(value);
+}
+
+/**
+ * @brief Saves the brightness selected in the menu.
+ */
+void applyBrightness(uint8_t value) {
+    ConfigPatch patch;
+    patch.setBrightness(value);
+    applyConfig(patch);
+    ledController.applyAnimation(handleMenuApplied);
+}
+
+uint8_t menuInterval() {
+    return measureInterval;
+}
+
+/**
+ * @brief Saves the measurement interval selected in the menu.
+ */
+void applyInterval(uint8_t value) {
+    handleIntervalChanged(value);
+    ledController.applyAnimation(handleMenuApplied);
+}
+
+/**
+ * @brief Shows the progress of a calibration on the LEDs and in the portal.
  *
- * This function sets the LED strip's brightness to the current value from the menu
- * and updates the LED display to reflect the current brightness level.
+ * @param status The running calibration.
  */
-void updateBrightness() {
-    ledController.setBrightness(menu.currentBrightness());
-    ledController.menuValueSelection(menu.currentBrightness());
+void handleCalibrationProgress(const CalibrationStatus& status) {
+    if (status.running()) {
+        ledController.calibrationProgress(status.progress);
+    }
+    if (menu.isMenuActive()) {
+        menu.keepAlive();
+    }
+    publishSnapshot();
 }
 
 /**
- * @brief Updates the LED strip's interval display.
+ * @brief Handle a finished calibration.
+ *
+ * Saves the measured limit and shows the apply animation, or shows the
+ * failure animation if the calibration was rejected. The calibration
+ * switched the step-up off, so the measurement cycle starts anew and the
+ * next measurement gets the full settle time.
  *
- * This function sets the LED strip's display to reflect the current interval
- * selected in the menu.
+ * @param status The finished calibration.
+ */
+void handleCalibrationFinished(const CalibrationStatus& status) {
+    restartMeasureCycle = true;
+    sensorAdc = pressureSensor.getAdc();
+    if (status.state == CALIBRATION_DONE) {
+        handleAdcChanged(status);
+        ledController.applyAnimation(handleMenuApplied);
+    } else if (status.error == CALIBRATION_CANCELLED) {
+        ledController.stopAnimation();
+    } else {
+        ledController.failureAnimation();
+    }
+}
+
+void applyMinAdc(uint8_t) {
+    calibration.start(CALIBRATION_MIN);
+}
+
+void applyMaxAdc(uint8_t) {
+    calibration.start(CALIBRATION_MAX);
+}
+
+/**
+ * @brief Turns the LED display upside down.
  */
-void updateInterval() {
-    ledController.menuValueSelection(menu.currentInterval());
+void applyUpsideDown(uint8_t) {
+    ConfigPatch patch;
+    patch.setUpsideDown(!ledController.isUpsideDown());
+    applyConfig(patch);
+    ledController.applyAnimation(handleMenuApplied);
 }
 
+/**
+ * @brief Resets all settings and restarts once the shutdown animation ended.
+ */
+void applyReset(uint8_t) {
+    ledController.shutdownAnimation(onReset);
+}
+
+void applyRestart(uint8_t) {
+    ledController.applyAnimation(restart);
+}
+
+// Werte der Intervall-Auswahl, siehe timedInterval()
+static constexpr uint8_t INTERVAL_CHOICES[] PROGMEM = {1, 2, 3, 4, 5, 6};
+
+// Menübaum im Flash, die Reihenfolge ist die Reihenfolge auf den LEDs
+static constexpr MenuItem MENU_ITEMS[] PROGMEM = {
+    menuRange(1, 6, menuBrightness, previewBrightness, applyBrightness, renderMenuValue),
+    menuChoice(INTERVAL_CHOICES, menuInterval, nullptr, applyInterval, renderMenuValue),
+    menuConfirm(applyMinAdc, renderMenuConfirm),
+    menuConfirm(applyMaxAdc, renderMenuConfirm),
+    menuConfirm(applyUpsideDown, renderMenuConfirm),
+    menuConfirm(applyReset, renderMenuConfirm),
+    menuConfirm(applyRestart, renderMenuConfirm),
+};
+
 /**
  * @brief Converts a menu-selected interval into milliseconds.
  *
@@ -386,88 +543,125 @@ void setup() {
     Serial.begin(115200);
 
     store.begin();
+    history.begin();
 
-    static unsigned int savedBrightness = store.read("brightness", 5);
-    measureInterval = store.read("interval", 6);
+    config.begin(store);
+    const SensorConfig& settings = config.get();
+    static unsigned int savedBrightness = settings.brightness;
+    measureInterval = settings.interval;
 
     // ------------------- LED STRIP -------------------
-    static bool upsideDown = store.read("upsideDown", 1);
+    static bool upsideDown = settings.upsideDown;
     ledController.setUpsideDown(upsideDown);
+#ifdef LED_SEGMENTS
+    static const int16_t ledSegments[] = {LED_SEGMENTS};
+    for (int16_t count : ledSegments) {
+        if (!ledController.addSegment(abs(count), count < 0)) {
+            Serial.println("Main -> LED-Segment passt nicht: " + String(count));
+        }
+    }
+#endif
+    Serial.println("Main -> LED-Puffer: " + String(ledController.heapUsage()) + " Bytes");
     ledController.setBrightness(savedBrightness);
     ledController.startAnimation();
 
     // ------------------- SENSOR -------------------
     pinMode(STEP_UP_PIN, OUTPUT);
-    static unsigned int minAdcValue = store.read("minAdcValue", 0);
-    static unsigned int maxAdcValue = store.read("maxAdcValue", 0);
-    if (minAdcValue != 0) {
-        pressureSensor.setMinAdcValue(minAdcValue);
+    if (settings.minAdc != 0) {
+        pressureSensor.setMinAdcValue(settings.minAdc);
     }
-    if (maxAdcValue != 0) {
-        pressureSensor.setMaxAdcValue(maxAdcValue);
+    if (settings.maxAdc != 0) {
+        pressureSensor.setMaxAdcValue(settings.maxAdc);
     }
     pressureSensor.begin();
     // Die Library hat auch einen eigenen Check, der die erfassten Parameter auf Plausibilität überprüft und beispielsweise vor falschen Widerstandswerten warnt. Üblicherweise braucht man diesen Check nur beim ersten Sketch und kann im laufenden Betrieb auskommentiert werden:
     // pressureSensor.check();  // remove this line if check shows no error, will save about 320 bytes program memory (flash)
 
     // ------------------- Captive Portal -------------------
-    portal.update(0, 0, pressureSensor.getMinAdcValue(), pressureSensor.getMaxAdcValue(), measureInterval, 0, upsideDown);
-    portal.onIntervalChanged(handleIntervalChanged);
-    portal.onAdcChanged(handleAdcChanged);
-    portal.onLedDirectionChanged(handleLedDirectionChanged);
+    publishSnapshot();
+    portal.setSensorSnapshot(&snapshot);
+    portal.setConfig(settings);
+    portal.setHistory(&history);
+    WifiCache wifiCache;
+    ConfigStore::loadWifiCache(wifiCache);
+    portal.setWifiCache(wifiCache);
+    portal.onWifiCacheChanged(handleWifiCacheChanged);
     portal.begin();
+    configTime(0, 0, "pool.ntp.org");  // Zeitstempel der History, sobald das WLAN verbunden ist
+
+    // ------------------- MQTT -------------------
+    mqtt.setConfig(settings);
+    mqtt.begin(&history);
+
+    // ------------------- HTTP-UPLOAD -------------------
+    uplink.begin(&history);
 
     // ------------------- BUTTONS -------------------
+    buttons.begin();
     buttons.onButtonBlackPressed(handleBlackButtonPress);
     buttons.onButtonRedPressed(handleRedButtonPress);
+    buttons.onGesture(ButtonController::BUTTON_BLACK, ButtonController::GESTURE_REPEAT, handleBlackButtonPress);
+    buttons.onGesture(ButtonController::BUTTON_BLACK, ButtonController::GESTURE_DOUBLE_PRESS, handleBlackDoublePress);
+    buttons.onGesture(ButtonController::BUTTON_RED, ButtonController::GESTURE_LONG_PRESS, handleRedLongPress);
+    buttons.onChord(handleButtonChord);
 
     // ------------------- MENU -------------------
-    menu.setBrightness(savedBrightness);
-    menu.setInterval(measureInterval);
-
-    menu.onNextStep(handleMenuNextStep);
+    menu.begin(MENU_ITEMS, sizeof(MENU_ITEMS) / sizeof(MENU_ITEMS[0]), renderMenuNavigation);
     menu.onMenuExit(handleMenuExit);
-    menu.onSelect(handleMenuSelected);
-    menu.onApply(handleMenuApply);
-    menu.onMenuFirstEnter(enterBrightnessMenu);
-    menu.onMenuFirstChange(updateBrightness);
-    menu.onMenuSecondEnter(enterIntervalMenu);
-    menu.onMenuSecondChange(updateInterval);
+
+    // ------------------- CALIBRATION -------------------
+    calibration.onProgress(handleCalibrationProgress);
+    calibration.onFinished(handleCalibrationFinished);
 }
 
 /**
  * @brief Reading the current loop sensor at a specified interval.
  *
  * It:
+ * Restarts the cycle after a calibration: with the 1 second interval the
+ * step-up is switched on again and settles until the next measurement.
  * Checks if the interval has passed since the last measurement.
  * If so, it enables the step-up transistor and measures the sensor value.
  * If the measurement is successful, it updates the sensor level, ADC value, and timestamp.
- * If the menu is not active, it updates the LED display based on the sensor level.
+ * It updates the level display; while the menu is open, the menu stays on top of it.
  */
 void checkSensor(unsigned long interval) {
     unsigned long stepUpDelay = 1000;
     static unsigned long lastTimeMeasure = 0;
     unsigned long currentTimeMeasure = millis();
 
-    if (changingMeasureAdc == false && currentTimeMeasure - lastTimeMeasure >= interval) {
+    if (restartMeasureCycle && !calibration.running()) {
+        restartMeasureCycle = false;
+        lastTimeMeasure = currentTimeMeasure;
+        if (interval == 1000) {
+            digitalWrite(STEP_UP_PIN, HIGH);  // bleibt bei 1 Sekunde dauerhaft an
+        }
+    }
+
+    if (!calibration.running() && currentTimeMeasure - lastTimeMeasure >= interval) {
         digitalWrite(STEP_UP_PIN, HIGH);  // Schalte den Stepup über den Transistoren ein
         if (interval == 1000 || (currentTimeMeasure - lastTimeMeasure >= interval + stepUpDelay)) {
+            unsigned long measureStart = micros();
             sensorLevel = pressureSensor.getValue();
             sensorAdc = pressureSensor.getAdc();
+            metrics.recordMeasurement(sensorLevel, sensorAdc, pressureSensor.getCurrentMicroAmps(), micros() - measureStart);
             measureTimestamp = currentTimeMeasure;
             lastTimeMeasure = currentTimeMeasure;
+            history.append(sensorAdc, sensorLevel);
+            publishSnapshot();
             // Serial.println("Time in minutes: " + String(currentTimeMeasure / 60000) + " ");
             // Serial.println("Sensor: " + String(sensorLevel) + " ADC: " + String(sensorAdc));
             if (interval > 1000) {
                 digitalWrite(STEP_UP_PIN, LOW);  // Schalte den Stepup über den Transistoren aus
             }
-            if (menu.isMenuActive() == false) {
-                if (sensorLevel == 0) {
-                    ledController.clear();
-                    ledController.blinkRed();
-                } else {
-                    ledController.updateLEDs(sensorLevel);
-                }
+            if (sensorLevel == 0) {
+                ledController.blinkRed();
+            } else {
+#if LED_FRACTIONAL_LEVEL
+                ledController.updateFill(pressureSensor.getFill());
+#else
+                ledController.updateLEDs(sensorLevel);
+#endif
             }
         }
     }
@@ -476,15 +670,22 @@ void checkSensor(unsigned long interval) {
 /**
  * The main loop of the application.
  *
- * Calls {@link checkSensor} with the current measure interval,
- * then updates the captive portal with the current sensor values,
- * and finally updates the led controller, buttons and menu.
+ * Applies the queued commands, advances a running calibration, calls
+ * {@link checkSensor} with the current measure interval (skipped while
+ * calibrating), then updates the captive portal,
+ * publishes pending readings via MQTT and HTTP and finally updates the led
+ * controller, buttons and menu.
  */
 void loop() {
+    unsigned long loopStart = micros();
+    handleCommands();
+    calibration.update();
     checkSensor(timedInterval(measureInterval));
-    boolean upsideDown = ledController.isUpsideDown();
-    portal.update(sensorLevel, sensorAdc, pressureSensor.getMinAdcValue(), pressureSensor.getMaxAdcValue(), measureInterval, measureTimestamp, upsideDown);
+    portal.update();
+    mqtt.update();
+    uplink.update();
     ledController.update();
     buttons.update();
     menu.update();
+    metrics.recordLoop(micros() - loopStart);
 }
@@ -0,0 +1,17 @@
+#ifndef NATIVE_COMMAND_QUEUE_H
+#define NATIVE_COMMAND_QUEUE_H
+
+// Ersatz für die Befehlswarteschlange bei den Host-Tests, nur die Tiefe für /metrics
+
+#include <Arduino.h>
+
+class CommandQueue {
+   public:
+    size_t queued = 0;
+
+    size_t depth() const { return queued; }
+};
+
+inline CommandQueue commands;
+
+#endif
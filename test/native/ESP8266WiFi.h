@@ -0,0 +1,31 @@
+#ifndef NATIVE_ESP8266WIFI_H
+#define NATIVE_ESP8266WIFI_H
+
+// Ersatz für ESP und WiFi bei den Host-Tests; die Werte setzt der Test
+
+#include <Arduino.h>
+
+enum wl_status_t { WL_IDLE_STATUS = 0,
+                   WL_CONNECTED = 3,
+                   WL_DISCONNECTED = 6 };
+
+struct NativeEsp {
+    uint32_t freeHeap = 0;
+    uint32_t maxFreeBlockSize = 0;
+
+    uint32_t getFreeHeap() { return freeHeap; }
+    uint32_t getMaxFreeBlockSize() { return maxFreeBlockSize; }
+};
+
+struct NativeWiFi {
+    wl_status_t state = WL_DISCONNECTED;
+    int8_t rssi = 0;
+
+    wl_status_t status() { return state; }
+    int8_t RSSI() { return rssi; }
+};
+
+inline NativeEsp ESP;
+inline NativeWiFi WiFi;
+
+#endif
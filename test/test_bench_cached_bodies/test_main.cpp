@@ -0,0 +1,326 @@
+#include <unity.h>
+
+#include <ArduinoJson.h>
+
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "CachedBody.h"
+#include "CachedBody.cpp"
+#include "CalibrationStatus.cpp"
+#include "SensorSnapshot.cpp"
+
+/**
+ * Benchmark der Antworten von /sensor und /status mit dem Code aus CPortal:
+ * dieselben Builder (sensorToJson, statusToJson) einmal je Anfrage gebaut
+ * und serialisiert, und der zwischengespeicherte CachedBody mit ETag und 304.
+ *
+ * Gezählt werden die Heap-Allokationen je Anfrage (JsonDocument, Puffer und
+ * die Kopie des Bodys in die Antwort) und die Anfragen je Sekunde. Die
+ * Zeiten gelten nur für den Host und nur im Vergleich untereinander; die
+ * Allokationen sind auf dem ESP8266 dieselben.
+ */
+
+#define BENCH_REQUESTS 20000
+#define BENCH_TABS 8                 // Browser-Tabs, die /sensor abfragen
+#define BENCH_POLLS_PER_MEASUREMENT 10  // Abfragen je Tab zwischen zwei Messungen
+
+static size_t allocations = 0;
+static size_t allocatedBytes = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    allocatedBytes += size;
+    void* pointer = malloc(size);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t size) noexcept {
+    free(pointer);
+}
+
+// Allocator für JsonDocument, zählt wie operator new
+class CountingAllocator : public ArduinoJson::Allocator {
+   public:
+    void* allocate(size_t size) override {
+        allocations++;
+        allocatedBytes += size;
+        return malloc(size);
+    }
+
+    void deallocate(void* pointer) override {
+        free(pointer);
+    }
+
+    void* reallocate(void* pointer, size_t size) override {
+        allocations++;
+        allocatedBytes += size;
+        return realloc(pointer, size);
+    }
+};
+
+static CountingAllocator allocator;
+
+struct Result {
+    double requestsPerSecond;
+    double allocationsPerRequest;
+    double bytesPerRequest;
+};
+
+static SensorState sensor;  // wie CPortal::sensor
+static PortalStatus status;
+static CachedBody sensorBody('s');
+static CachedBody statusBody('t');
+static volatile size_t sink = 0;  // verhindert, dass der Compiler die Arbeit wegoptimiert
+
+// Werte wie im Betrieb
+static SensorState measurement(uint16_t adc) {
+    SensorState state;
+    state.level = adc / 128;
+    state.adc = adc;
+    state.adcMin = 192;
+    state.adcMax = 960;
+    state.timestamp = 1718000000;
+    state.interval = 5;
+    return state;
+}
+
+// wie CPortal::buildSensorBody() und buildStatusBody()
+static void buildSensorBody() {
+    JsonDocument doc(&allocator);
+    sensorToJson(sensor, doc.to<JsonObject>());
+    sensorBody.build(doc, sensor.version);
+}
+
+static void buildStatusBody() {
+    JsonDocument doc(&allocator);
+    statusToJson(status, sensor, doc.to<JsonObject>());
+    statusBody.build(doc, statusBody.version() + 1);
+}
+
+/**
+ * Weg einer Anfrage wie in CPortal::sendCached(): 304, wenn If-None-Match
+ * passt, sonst wird der passende Body in die Antwort kopiert (dort macht
+ * das beginResponse()).
+ *
+ * @param etag Erhält die ETag der Antwort.
+ * @return Größe des gesendeten Bodys, 0 bei 304.
+ */
+static size_t serveCached(const CachedBody& body, const char* ifNoneMatch, bool msgPack, char* etag) {
+    body.etag(etag, CACHED_BODY_ETAG_SIZE, msgPack);
+    if (ifNoneMatch && CachedBody::matches(ifNoneMatch, etag)) {
+        return 0;
+    }
+    if (msgPack) {
+        std::vector<uint8_t> response(body.pack(), body.pack() + body.packSize());
+        return response.size();
+    }
+    std::string response = body.json();
+    return response.size();
+}
+
+// Vorher: bei jeder Anfrage gebaut und serialisiert
+static size_t sensorPerRequest() {
+    JsonDocument doc(&allocator);
+    sensorToJson(sensor, doc.to<JsonObject>());
+    std::string body;
+    serializeJson(doc, body);
+    std::string response = body;  // beginResponse() kopiert den Body
+    return response.size();
+}
+
+static size_t statusPerRequest() {
+    JsonDocument doc(&allocator);
+    statusToJson(status, sensor, doc.to<JsonObject>());
+    std::string body;
+    serializeJson(doc, body);
+    std::string response = body;
+    return response.size();
+}
+
+static size_t sensorCached() {
+    char etag[CACHED_BODY_ETAG_SIZE];
+    return serveCached(sensorBody, nullptr, false, etag);
+}
+
+static size_t statusCached() {
+    char etag[CACHED_BODY_ETAG_SIZE];
+    return serveCached(statusBody, nullptr, false, etag);
+}
+
+// Der Browser schickt die ETag der letzten Antwort mit
+static size_t sensorNotModified() {
+    char current[CACHED_BODY_ETAG_SIZE];
+    sensorBody.etag(current, sizeof(current), false);
+    char etag[CACHED_BODY_ETAG_SIZE];
+    return serveCached(sensorBody, current, false, etag);
+}
+
+static Result finish(std::chrono::steady_clock::time_point start, size_t requests) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    Result result;
+    result.requestsPerSecond = requests / elapsed.count();
+    result.allocationsPerRequest = (double)allocations / requests;
+    result.bytesPerRequest = (double)allocatedBytes / requests;
+    return result;
+}
+
+static Result run(size_t (*handler)()) {
+    allocations = 0;
+    allocatedBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_REQUESTS; i++) {
+        sink = sink + handler();
+    }
+    return finish(start, BENCH_REQUESTS);
+}
+
+struct Tab {
+    char etag[CACHED_BODY_ETAG_SIZE] = "";
+    bool msgPack = false;
+};
+
+struct TabsResult {
+    Result result;
+    size_t notModified;
+    size_t rebuilds;
+};
+
+/**
+ * Mehrere Tabs fragen /sensor reihum ab, dazwischen kommen neue Messungen
+ * über den SensorSnapshot. Wie in CPortal::update() wird der Body nur neu
+ * gebaut, wenn sich die Version geändert hat. Ein Tab fragt MessagePack an.
+ *
+ * @param cached false: Body bei jeder Anfrage bauen, ohne ETag.
+ */
+static TabsResult runTabs(bool cached) {
+    SensorSnapshot snapshot;
+    Tab tabs[BENCH_TABS];
+    tabs[BENCH_TABS - 1].msgPack = true;
+    TabsResult tabsResult = {};
+    sensor.version = 0;
+
+    allocations = 0;
+    allocatedBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_REQUESTS; i++) {
+        if (i % (BENCH_TABS * BENCH_POLLS_PER_MEASUREMENT) == 0) {
+            snapshot.publish(measurement(400 + i / (BENCH_TABS * BENCH_POLLS_PER_MEASUREMENT) % 500));
+        }
+        if (!cached) {
+            sink = sink + sensorPerRequest();
+            continue;
+        }
+        if (snapshot.version() != sensor.version) {
+            sensor = snapshot.read();
+            buildSensorBody();
+            tabsResult.rebuilds++;
+        }
+        Tab& tab = tabs[i % BENCH_TABS];
+        char etag[CACHED_BODY_ETAG_SIZE];
+        size_t size = serveCached(sensorBody, tab.etag[0] ? tab.etag : nullptr, tab.msgPack, etag);
+        if (size == 0) {
+            tabsResult.notModified++;
+        }
+        memcpy(tab.etag, etag, sizeof(etag));
+        sink = sink + size;
+    }
+    tabsResult.result = finish(start, BENCH_REQUESTS);
+    return tabsResult;
+}
+
+static void report(const char* name, const Result& result) {
+    char message[128];
+    snprintf(message, sizeof(message), "%-22s %12.0f req/s %6.2f allocs/req %8.1f bytes/req", name,
+             result.requestsPerSecond, result.allocationsPerRequest, result.bytesPerRequest);
+    TEST_MESSAGE(message);
+}
+
+void setUp(void) {
+    sensor = measurement(612);
+    sensor.version = 1;
+    status = PortalStatus();
+    status.state = "connected";
+    status.attempts = 1;
+    status.lastAttemptMs = 1834;
+    status.bootToConnectedMs = 2210;
+    status.fastConnect = true;
+    status.connected = true;
+    status.ip = 0x2A01A8C0;  // 192.168.1.42
+    status.ssid = "Gartenhaus";
+    status.signal = 74;
+    status.channel = 6;
+    status.secured = true;
+    buildSensorBody();
+    buildStatusBody();
+}
+
+void tearDown(void) {}
+
+void test_sensor(void) {
+    Result perRequest = run(sensorPerRequest);
+    Result cached = run(sensorCached);
+    Result notModified = run(sensorNotModified);
+    report("/sensor per request", perRequest);
+    report("/sensor cached", cached);
+    report("/sensor 304", notModified);
+
+    TEST_ASSERT_TRUE(cached.allocationsPerRequest <= 1);
+    TEST_ASSERT_TRUE(perRequest.allocationsPerRequest > cached.allocationsPerRequest);
+    TEST_ASSERT_TRUE(notModified.allocationsPerRequest == 0);
+}
+
+void test_status(void) {
+    Result perRequest = run(statusPerRequest);
+    Result cached = run(statusCached);
+    report("/status per request", perRequest);
+    report("/status cached", cached);
+
+    TEST_ASSERT_TRUE(cached.allocationsPerRequest <= 1);
+    TEST_ASSERT_TRUE(perRequest.allocationsPerRequest > cached.allocationsPerRequest);
+}
+
+void test_many_tabs(void) {
+    TabsResult perRequest = runTabs(false);
+    TabsResult cached = runTabs(true);
+    report("tabs per request", perRequest.result);
+    report("tabs cached + 304", cached.result);
+    char message[128];
+    snprintf(message, sizeof(message), "%d tabs: %zu rebuilds, %zu of %d answered with 304", BENCH_TABS, cached.rebuilds,
+             cached.notModified, BENCH_REQUESTS);
+    TEST_MESSAGE(message);
+
+    // je Messung ein Neubau, und jeder Tab bekommt den neuen Body genau einmal
+    size_t measurements = (BENCH_REQUESTS + BENCH_TABS * BENCH_POLLS_PER_MEASUREMENT - 1) / (BENCH_TABS * BENCH_POLLS_PER_MEASUREMENT);
+    TEST_ASSERT_EQUAL(measurements, cached.rebuilds);
+    TEST_ASSERT_EQUAL(BENCH_REQUESTS - measurements * BENCH_TABS, cached.notModified);
+    TEST_ASSERT_TRUE(perRequest.result.allocationsPerRequest > cached.result.allocationsPerRequest);
+}
+
+void test_if_none_match(void) {
+    TEST_ASSERT_TRUE(CachedBody::matches("\"s7\"", "\"s7\""));
+    TEST_ASSERT_TRUE(CachedBody::matches("W/\"s7\"", "\"s7\""));
+    TEST_ASSERT_TRUE(CachedBody::matches("\"s6\", \"s7\"", "\"s7\""));
+    TEST_ASSERT_TRUE(CachedBody::matches("*", "\"s7\""));
+    TEST_ASSERT_FALSE(CachedBody::matches("\"s7m\"", "\"s7\""));
+    TEST_ASSERT_FALSE(CachedBody::matches("\"s70\"", "\"s7\""));
+    TEST_ASSERT_FALSE(CachedBody::matches("", "\"s7\""));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_sensor);
+    RUN_TEST(test_status);
+    RUN_TEST(test_many_tabs);
+    RUN_TEST(test_if_none_match);
+    return UNITY_END();
+}
@@ -0,0 +1,165 @@
+#include <unity.h>
+
+#include <ArduinoJson.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "HistoryFormat.h"
+#include "HistoryFormat.cpp"
+
+/**
+ * Benchmark der Formate: Größe und Serialisierungszeit von /sensor,
+ * /status und /history als JSON und MessagePack (bei /history auch CSV und
+ * binär). Die Größen gelten genauso auf dem ESP8266, die Zeiten nur im
+ * Vergleich untereinander.
+ */
+
+#define BENCH_DOCUMENTS 20000
+#define BENCH_RECORDS 20160  // eine Woche History
+
+struct Result {
+    size_t bytes;
+    double microsPerItem;
+};
+
+static volatile size_t sink = 0;  // verhindert, dass der Compiler die Arbeit wegoptimiert
+
+static void fillSensor(JsonDocument& doc) {
+    doc["value"] = 5;
+    doc["adcValue"] = 612;
+    doc["adcMin"] = 192;
+    doc["adcMax"] = 960;
+    doc["timestamp"] = 1718000000;
+    doc["interval"] = 10;
+    doc["menuUpsideDown"] = false;
+}
+
+static void fillStatus(JsonDocument& doc) {
+    JsonObject connection = doc["connection"].to<JsonObject>();
+    connection["state"] = "connected";
+    connection["attempts"] = 1;
+    connection["failures"] = 0;
+    connection["lastAttemptMs"] = 1834;
+    connection["bootToConnectedMs"] = 2210;
+    connection["fastConnect"] = true;
+    connection["accessPoint"] = false;
+    doc["connected"] = true;
+    doc["timestamp"] = 1718000000;
+    doc["interval"] = 10;
+    doc["menuUpsideDown"] = false;
+    JsonObject wifi = doc["wifi"].to<JsonObject>();
+    wifi["ip"] = "192.168.1.42";
+    wifi["ssid"] = "Gartenhaus";
+    wifi["signal"] = 74;
+    wifi["channel"] = 6;
+    wifi["secured"] = true;
+}
+
+static void fillRecord(JsonDocument& doc, const HistoryRecord& record) {
+    doc["timestamp"] = record.timestamp;
+    doc["value"] = record.level;
+    doc["adcValue"] = record.adc;
+    doc["flags"] = record.flags;
+}
+
+static HistoryRecord record(uint32_t index) {
+    HistoryRecord result = {1718000000 + index * 30, (uint16_t)(200 + index % 760), (uint8_t)(index % 9), 0};
+    return result;
+}
+
+// Dokument wie in buildSensorBody()/buildStatusBody() einmal bauen, dann serialisieren
+static Result serializeDocument(void (*fill)(JsonDocument&), bool msgPack) {
+    JsonDocument doc;
+    fill(doc);
+    uint8_t buffer[512];
+    size_t bytes = msgPack ? serializeMsgPack(doc, buffer, sizeof(buffer)) : serializeJson(doc, (char*)buffer, sizeof(buffer));
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_DOCUMENTS; i++) {
+        sink = sink + (msgPack ? serializeMsgPack(doc, buffer, sizeof(buffer)) : serializeJson(doc, (char*)buffer, sizeof(buffer)));
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return {bytes, elapsed.count() / BENCH_DOCUMENTS};
+}
+
+// Download wie in HistoryStream, ein Messwert nach dem anderen
+static Result formatHistory(HistoryFormat format) {
+    char line[HISTORY_LINE_SIZE];
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+        bytes += historyFormatRecord(format, record(i), i == 0, line, sizeof(line));
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    sink = sink + bytes;
+    return {bytes, elapsed.count() / BENCH_RECORDS};
+}
+
+static void report(const char* name, const char* format, const Result& result) {
+    char message[128];
+    snprintf(message, sizeof(message), "%-9s %-8s %8lu bytes %8.3f us", name, format, (unsigned long)result.bytes,
+             result.microsPerItem);
+    TEST_MESSAGE(message);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_sensor(void) {
+    Result json = serializeDocument(fillSensor, false);
+    Result msgPack = serializeDocument(fillSensor, true);
+    report("/sensor", "json", json);
+    report("/sensor", "msgpack", msgPack);
+    TEST_ASSERT_TRUE(msgPack.bytes < json.bytes);
+}
+
+void test_status(void) {
+    Result json = serializeDocument(fillStatus, false);
+    Result msgPack = serializeDocument(fillStatus, true);
+    report("/status", "json", json);
+    report("/status", "msgpack", msgPack);
+    TEST_ASSERT_TRUE(msgPack.bytes < json.bytes);
+}
+
+void test_history(void) {
+    Result csv = formatHistory(HISTORY_CSV);
+    Result json = formatHistory(HISTORY_JSON);
+    Result bin = formatHistory(HISTORY_BIN);
+    Result msgPack = formatHistory(HISTORY_MSGPACK);
+    report("/history", "csv", csv);
+    report("/history", "json", json);
+    report("/history", "bin", bin);
+    report("/history", "msgpack", msgPack);
+    TEST_ASSERT_EQUAL_UINT32(BENCH_RECORDS * HISTORY_RECORD_SIZE, bin.bytes);
+    TEST_ASSERT_TRUE(msgPack.bytes < json.bytes);
+}
+
+// Der eigene Kodierer der History muss dieselben Bytes liefern wie ArduinoJson
+void test_history_records_match_arduinojson(void) {
+    const HistoryRecord records[] = {record(0), record(5), {0, 0, 0, 0}, {0x7F, 0x80, 0xFF, 1}, {0xFFFF, 0xFFFF, 8, 0}, {0x10000, 0x100, 3, 0}};
+    for (const HistoryRecord& item : records) {
+        JsonDocument doc;
+        fillRecord(doc, item);
+        uint8_t expected[HISTORY_LINE_SIZE];
+        char line[HISTORY_LINE_SIZE];
+
+        size_t length = serializeMsgPack(doc, expected, sizeof(expected));
+        TEST_ASSERT_EQUAL(length, historyFormatRecord(HISTORY_MSGPACK, item, true, line, sizeof(line)));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, line, length);
+
+        length = serializeJson(doc, (char*)expected, sizeof(expected));
+        TEST_ASSERT_EQUAL(length, historyFormatRecord(HISTORY_JSON, item, true, line, sizeof(line)));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, line, length);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_sensor);
+    RUN_TEST(test_status);
+    RUN_TEST(test_history);
+    RUN_TEST(test_history_records_match_arduinojson);
+    return UNITY_END();
+}
@@ -0,0 +1,221 @@
+#include <unity.h>
+
+#include <math.h>
+#include <vector>
+
+#include "Lttb.h"
+
+/**
+ * Messwert-Quelle im Speicher. Liefert höchstens maxRead Messwerte je
+ * Aufruf, um das blockweise Lesen des Samplers zu prüfen.
+ */
+struct VectorSource {
+    std::vector<HistoryRecord> records;
+    uint32_t firstSeq = 0;
+    size_t maxRead = 1000;
+    size_t reads = 0;  // gelesene Messwerte
+
+    size_t read(uint32_t seq, HistoryRecord* out, size_t max) {
+        if (seq < firstSeq || seq - firstSeq >= records.size()) {
+            return 0;
+        }
+        size_t count = records.size() - (seq - firstSeq);
+        count = count < max ? count : max;
+        count = count < maxRead ? count : maxRead;
+        for (size_t i = 0; i < count; i++) {
+            out[i] = records[seq - firstSeq + i];
+        }
+        reads += count;
+        return count;
+    }
+};
+
+/**
+ * Referenz: LTTB nach Steinarsson (2013) über den ganzen Datensatz mit
+ * absoluten Koordinaten. Die Bucket-Grenzen werden ganzzahlig abgerundet.
+ */
+static std::vector<HistoryRecord> referenceLttb(const std::vector<HistoryRecord>& data, size_t threshold) {
+    size_t n = data.size();
+    if (threshold >= n || threshold < 3) {
+        return data;
+    }
+    std::vector<HistoryRecord> sampled;
+    sampled.push_back(data[0]);
+    size_t a = 0;
+    for (size_t i = 0; i < threshold - 2; i++) {
+        size_t avgStart = (i + 1) * (n - 2) / (threshold - 2) + 1;
+        size_t avgEnd = (i + 2) * (n - 2) / (threshold - 2) + 1;
+        avgEnd = avgEnd < n ? avgEnd : n;
+        if (i == threshold - 3) {
+            avgStart = n - 1;
+            avgEnd = n;
+        }
+        double avgX = 0;
+        double avgY = 0;
+        for (size_t j = avgStart; j < avgEnd; j++) {
+            avgX += data[j].timestamp;
+            avgY += data[j].adc;
+        }
+        avgX /= (avgEnd - avgStart);
+        avgY /= (avgEnd - avgStart);
+
+        size_t rangeStart = i * (n - 2) / (threshold - 2) + 1;
+        size_t rangeEnd = (i + 1) * (n - 2) / (threshold - 2) + 1;
+        double ax = data[a].timestamp;
+        double ay = data[a].adc;
+        double maxArea = -1;
+        size_t next = rangeStart;
+        for (size_t j = rangeStart; j < rangeEnd; j++) {
+            double area = fabs((ax - avgX) * (data[j].adc - ay) - (ax - data[j].timestamp) * (avgY - ay)) * 0.5;
+            if (area > maxArea) {
+                maxArea = area;
+                next = j;
+            }
+        }
+        sampled.push_back(data[next]);
+        a = next;
+    }
+    sampled.push_back(data[n - 1]);
+    return sampled;
+}
+
+// Zufallsweg mit festem Startwert, damit jeder Lauf dieselben Daten hat
+static std::vector<HistoryRecord> randomWalk(size_t count, uint32_t seed) {
+    std::vector<HistoryRecord> records;
+    uint32_t state = seed;
+    int32_t adc = 500;
+    for (size_t i = 0; i < count; i++) {
+        state = state * 1664525 + 1013904223;
+        adc += (int32_t)(state >> 24) % 41 - 20;
+        adc = adc < 0 ? 0 : (adc > 1023 ? 1023 : adc);
+        HistoryRecord record = {1700000000 + (uint32_t)i * 60 + (state >> 28), (uint16_t)adc, (uint8_t)(adc / 128), 0};
+        records.push_back(record);
+    }
+    return records;
+}
+
+/**
+ * Sammelt alle Punkte, wie HistoryStream::fill() mit einem Budget je Aufruf.
+ *
+ * @param maxReads Erhält die meisten Messwerte, die ein Aufruf gelesen hat.
+ */
+static std::vector<HistoryRecord> sample(VectorSource& source, uint32_t first, uint32_t end, uint32_t points,
+                                         uint32_t budget = 512, size_t* maxReads = nullptr) {
+    LttbSampler<VectorSource> sampler;
+    sampler.begin(&source, first, end, points);
+    std::vector<HistoryRecord> result;
+    HistoryRecord record;
+    LttbResult state;
+    do {
+        uint32_t left = budget;
+        size_t before = source.reads;
+        state = sampler.next(record, left);
+        TEST_ASSERT_EQUAL(budget - left, source.reads - before);
+        if (maxReads && source.reads - before > *maxReads) {
+            *maxReads = source.reads - before;
+        }
+        if (state == LTTB_POINT) {
+            result.push_back(record);
+        }
+    } while (state != LTTB_DONE);
+    return result;
+}
+
+static void assertSame(const std::vector<HistoryRecord>& expected, const std::vector<HistoryRecord>& actual) {
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected[i].timestamp, actual[i].timestamp, "timestamp");
+        TEST_ASSERT_EQUAL_UINT16_MESSAGE(expected[i].adc, actual[i].adc, "adc");
+    }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_fewer_records_than_points_are_returned_unchanged(void) {
+    VectorSource source;
+    source.records = randomWalk(20, 1);
+    assertSame(source.records, sample(source, 0, 20, 50));
+}
+
+void test_matches_reference(void) {
+    VectorSource source;
+    source.records = randomWalk(1000, 2);
+    assertSame(referenceLttb(source.records, 50), sample(source, 0, 1000, 50));
+}
+
+void test_matches_reference_with_uneven_buckets(void) {
+    VectorSource source;
+    source.records = randomWalk(20160, 3);
+    assertSame(referenceLttb(source.records, 997), sample(source, 0, 20160, 997));
+}
+
+void test_matches_reference_with_sequence_offset_and_short_reads(void) {
+    VectorSource source;
+    source.records = randomWalk(777, 4);
+    source.firstSeq = 123456;
+    source.maxRead = 5;
+    assertSame(referenceLttb(source.records, 100), sample(source, 123456, 123456 + 777, 100));
+}
+
+void test_keeps_first_and_last_record(void) {
+    VectorSource source;
+    source.records = randomWalk(500, 5);
+    std::vector<HistoryRecord> result = sample(source, 0, 500, 3);
+    TEST_ASSERT_EQUAL_UINT32(3, result.size());
+    TEST_ASSERT_EQUAL_UINT32(source.records.front().timestamp, result.front().timestamp);
+    TEST_ASSERT_EQUAL_UINT32(source.records.back().timestamp, result.back().timestamp);
+}
+
+void test_large_buckets_are_read_over_several_calls(void) {
+    VectorSource source;
+    source.records = randomWalk(20160, 8);
+    size_t maxReads = 0;
+    std::vector<HistoryRecord> result = sample(source, 0, 20160, 3, 512, &maxReads);
+    assertSame(referenceLttb(source.records, 3), result);
+    TEST_ASSERT_TRUE(maxReads <= 512);
+    TEST_ASSERT_TRUE(source.reads <= 2 * 20160);
+
+    // ein Budget von 1 liefert dasselbe Ergebnis
+    VectorSource small;
+    small.records = randomWalk(300, 9);
+    assertSame(referenceLttb(small.records, 20), sample(small, 0, 300, 20, 1));
+}
+
+void test_stops_when_records_are_missing(void) {
+    VectorSource source;
+    source.records = randomWalk(100, 6);
+    std::vector<HistoryRecord> result = sample(source, 0, 400, 50);
+    TEST_ASSERT_TRUE(result.size() < 50);
+}
+
+void test_selects_gaps_only_in_buckets_of_gaps(void) {
+    VectorSource source;
+    source.records = randomWalk(1000, 7);
+    // Lücke nach einem Reset: Zeitstempel des Messwerts davor, ADC 0
+    for (size_t i = 300; i < 364; i++) {
+        source.records[i] = {source.records[299].timestamp, 0, 0, HISTORY_FLAG_GAP};
+    }
+    std::vector<HistoryRecord> result = sample(source, 0, 1000, 100);
+    TEST_ASSERT_EQUAL_UINT32(100, result.size());
+    size_t gaps = 0;
+    for (size_t i = 0; i < result.size(); i++) {
+        gaps += (result[i].flags & HISTORY_FLAG_GAP) ? 1 : 0;
+    }
+    // nur fünf Buckets (Messwerte 306..356) liegen ganz in der Lücke
+    TEST_ASSERT_EQUAL(5, gaps);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fewer_records_than_points_are_returned_unchanged);
+    RUN_TEST(test_matches_reference);
+    RUN_TEST(test_matches_reference_with_uneven_buckets);
+    RUN_TEST(test_matches_reference_with_sequence_offset_and_short_reads);
+    RUN_TEST(test_keeps_first_and_last_record);
+    RUN_TEST(test_large_buckets_are_read_over_several_calls);
+    RUN_TEST(test_stops_when_records_are_missing);
+    RUN_TEST(test_selects_gaps_only_in_buckets_of_gaps);
+    return UNITY_END();
+}
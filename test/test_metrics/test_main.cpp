@@ -0,0 +1,262 @@
+#include <unity.h>
+
+#include <ESP8266WiFi.h>
+
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CommandQueue.h"
+#include "Metrics.cpp"
+
+struct Sample {
+    std::string name;
+    std::map<std::string, std::string> labels;
+    double value;
+};
+
+struct Family {
+    std::string name;
+    std::string type;
+    std::vector<Sample> samples;
+};
+
+static std::string expose(size_t chunk) {
+    MetricsStream stream;
+    std::string text;
+    std::vector<uint8_t> buffer(chunk);
+    size_t written;
+    while ((written = stream.fill(buffer.data(), chunk)) > 0) {
+        TEST_ASSERT_TRUE(written <= chunk);
+        text.append((const char*)buffer.data(), written);
+    }
+    return text;
+}
+
+static bool validName(const std::string& name) {
+    if (name.empty() || !(isalpha((unsigned char)name[0]) || name[0] == '_' || name[0] == ':')) {
+        return false;
+    }
+    for (char c : name) {
+        if (!(isalnum((unsigned char)c) || c == '_' || c == ':')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool startsWith(const std::string& text, const std::string& prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Darf der Wert `sample` in der Familie `family` vom Typ `type` stehen?
+static bool belongsTo(const std::string& sample, const std::string& family, const std::string& type) {
+    if (sample == family) {
+        return type != "histogram";
+    }
+    if (type == "histogram") {
+        return sample == family + "_bucket" || sample == family + "_sum" || sample == family + "_count";
+    }
+    if (type == "summary") {
+        return sample == family + "_sum" || sample == family + "_count";
+    }
+    return false;
+}
+
+static void parseSample(const std::string& line, Sample& sample) {
+    size_t pos = 0;
+    while (pos < line.size() && line[pos] != '{' && line[pos] != ' ') {
+        pos++;
+    }
+    sample.name = line.substr(0, pos);
+    TEST_ASSERT_TRUE_MESSAGE(validName(sample.name), line.c_str());
+    if (pos < line.size() && line[pos] == '{') {
+        pos++;
+        while (line[pos] != '}') {
+            size_t eq = line.find("=\"", pos);
+            TEST_ASSERT_TRUE_MESSAGE(eq != std::string::npos, line.c_str());
+            std::string label = line.substr(pos, eq - pos);
+            TEST_ASSERT_TRUE_MESSAGE(validName(label), line.c_str());
+            size_t close = line.find('"', eq + 2);
+            TEST_ASSERT_TRUE_MESSAGE(close != std::string::npos, line.c_str());
+            TEST_ASSERT_TRUE_MESSAGE(sample.labels.emplace(label, line.substr(eq + 2, close - eq - 2)).second, line.c_str());
+            pos = close + 1;
+            if (line[pos] == ',') {
+                pos++;
+            } else {
+                TEST_ASSERT_TRUE_MESSAGE(line[pos] == '}', line.c_str());
+            }
+        }
+        pos++;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(pos < line.size() && line[pos] == ' ', line.c_str());
+    std::string value = line.substr(pos + 1);
+    char* end;
+    sample.value = strtod(value.c_str(), &end);
+    TEST_ASSERT_TRUE_MESSAGE(!value.empty() && *end == '\0', line.c_str());
+}
+
+/**
+ * Liest die Exposition nach dem Prometheus-Textformat 0.0.4 und prüft dabei
+ * die Regeln, die ein Scraper voraussetzt.
+ */
+static std::vector<Family> parse(const std::string& text) {
+    std::vector<Family> families;
+    std::set<std::string> names;
+    TEST_ASSERT_TRUE_MESSAGE(!text.empty() && text.back() == '\n', "text ends with a line feed");
+
+    std::istringstream input(text);
+    std::string line;
+    bool typed = false;
+    while (std::getline(input, line)) {
+        TEST_ASSERT_FALSE_MESSAGE(line.empty(), "empty line");
+        if (startsWith(line, "# HELP ")) {
+            size_t space = line.find(' ', 7);
+            TEST_ASSERT_TRUE_MESSAGE(space != std::string::npos && space + 1 < line.size(), line.c_str());
+            Family family;
+            family.name = line.substr(7, space - 7);
+            TEST_ASSERT_TRUE_MESSAGE(validName(family.name), line.c_str());
+            TEST_ASSERT_TRUE_MESSAGE(names.insert(family.name).second, line.c_str());
+            families.push_back(family);
+            typed = false;
+        } else if (startsWith(line, "# TYPE ")) {
+            TEST_ASSERT_FALSE_MESSAGE(families.empty() || typed, line.c_str());
+            Family& family = families.back();
+            TEST_ASSERT_TRUE_MESSAGE(startsWith(line, "# TYPE " + family.name + " "), line.c_str());
+            family.type = line.substr(8 + family.name.size());
+            TEST_ASSERT_TRUE_MESSAGE(family.type == "counter" || family.type == "gauge" || family.type == "histogram" ||
+                                         family.type == "summary",
+                                     line.c_str());
+            typed = true;
+        } else {
+            TEST_ASSERT_FALSE_MESSAGE(line[0] == '#', line.c_str());
+            TEST_ASSERT_TRUE_MESSAGE(typed, line.c_str());
+            Family& family = families.back();
+            Sample sample;
+            parseSample(line, sample);
+            TEST_ASSERT_TRUE_MESSAGE(belongsTo(sample.name, family.name, family.type), line.c_str());
+            family.samples.push_back(sample);
+        }
+    }
+    return families;
+}
+
+static const Family* find(const std::vector<Family>& families, const std::string& name) {
+    for (const Family& family : families) {
+        if (family.name == name) {
+            return &family;
+        }
+    }
+    return nullptr;
+}
+
+void setUp(void) {
+    metrics = Metrics();
+    WiFi.state = WL_DISCONNECTED;
+    commands.queued = 0;
+}
+
+void tearDown(void) {}
+
+void test_exposition_is_valid(void) {
+    std::vector<Family> families = parse(expose(1024));
+    TEST_ASSERT_TRUE(families.size() > 30);
+    for (const Family& family : families) {
+        if (family.type == "counter") {
+            TEST_ASSERT_TRUE_MESSAGE(family.name.size() > 6 && family.name.compare(family.name.size() - 6, 6, "_total") == 0,
+                                     family.name.c_str());
+        }
+    }
+}
+
+void test_chunk_size_does_not_change_the_text(void) {
+    metrics.recordLoop(700);
+    metrics.countRequest(ROUTE_SENSOR);
+    std::string full = expose(4096);
+    TEST_ASSERT_EQUAL_STRING(full.c_str(), expose(1).c_str());
+    TEST_ASSERT_EQUAL_STRING(full.c_str(), expose(7).c_str());
+    TEST_ASSERT_EQUAL_STRING(full.c_str(), expose(127).c_str());
+}
+
+void test_values(void) {
+    metrics.recordMeasurement(5, 612, 12345, 101000);
+    metrics.countRequest(ROUTE_SENSOR);
+    metrics.countRequest(ROUTE_SENSOR);
+    metrics.countFlashWrite(FILE_HISTORY, 8);
+    metrics.calibrations[1] = 2;
+    commands.queued = 3;
+    ESP.freeHeap = 23456;
+    std::vector<Family> families = parse(expose(512));
+
+    TEST_ASSERT_EQUAL(5, find(families, "sensor_level")->samples[0].value);
+    TEST_ASSERT_EQUAL(612, find(families, "sensor_adc")->samples[0].value);
+    TEST_ASSERT_TRUE(find(families, "sensor_loop_current_milliamperes")->samples[0].value == 12.345);
+    TEST_ASSERT_TRUE(find(families, "sensor_measurement_duration_seconds")->samples[0].value == 0.101);
+    TEST_ASSERT_EQUAL(23456, find(families, "sensor_heap_free_bytes")->samples[0].value);
+    TEST_ASSERT_EQUAL(3, find(families, "sensor_command_queue_depth")->samples[0].value);
+
+    const Family* requests = find(families, "sensor_http_requests_total");
+    TEST_ASSERT_EQUAL(ROUTE_COUNT, requests->samples.size());
+    TEST_ASSERT_EQUAL_STRING("sensor", requests->samples[ROUTE_SENSOR].labels.at("route").c_str());
+    TEST_ASSERT_EQUAL(2, requests->samples[ROUTE_SENSOR].value);
+    TEST_ASSERT_EQUAL(8, find(families, "sensor_flash_written_bytes_total")->samples[FILE_HISTORY].value);
+
+    const Family* calibrations = find(families, "sensor_calibrations_total");
+    TEST_ASSERT_EQUAL_STRING("noisy", calibrations->samples[1].labels.at("result").c_str());
+    TEST_ASSERT_EQUAL(2, calibrations->samples[1].value);
+}
+
+void test_histogram_is_cumulative(void) {
+    metrics.recordLoop(50);
+    metrics.recordLoop(700);
+    metrics.recordLoop(700);
+    metrics.recordLoop(2000000);
+    std::vector<Family> families = parse(expose(512));
+    const Family* loop = find(families, "sensor_loop_duration_seconds");
+
+    double previous = 0;
+    double inf = -1;
+    double count = -1;
+    for (const Sample& sample : loop->samples) {
+        if (sample.name == "sensor_loop_duration_seconds_bucket") {
+            TEST_ASSERT_TRUE(sample.value >= previous);
+            previous = sample.value;
+            if (sample.labels.at("le") == "+Inf") {
+                inf = sample.value;
+            }
+        } else if (sample.name == "sensor_loop_duration_seconds_count") {
+            count = sample.value;
+        } else {
+            TEST_ASSERT_TRUE(sample.value == 2.00145);
+        }
+    }
+    TEST_ASSERT_EQUAL(METRICS_LOOP_BUCKETS + 3, loop->samples.size());
+    TEST_ASSERT_EQUAL(1, loop->samples[0].value);
+    TEST_ASSERT_EQUAL(4, inf);
+    TEST_ASSERT_EQUAL(4, count);
+}
+
+void test_optional_samples(void) {
+    std::vector<Family> families = parse(expose(512));
+    TEST_ASSERT_EQUAL(0, find(families, "sensor_wifi_rssi_dbm")->samples.size());
+    TEST_ASSERT_EQUAL(0, find(families, "sensor_wifi_boot_to_connected_seconds")->samples.size());
+
+    WiFi.state = WL_CONNECTED;
+    WiFi.rssi = -67;
+    metrics.wifiBootToConnectedMillis = 4321;
+    families = parse(expose(512));
+    TEST_ASSERT_EQUAL(-67, find(families, "sensor_wifi_rssi_dbm")->samples[0].value);
+    TEST_ASSERT_TRUE(find(families, "sensor_wifi_boot_to_connected_seconds")->samples[0].value == 4.321);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_exposition_is_valid);
+    RUN_TEST(test_chunk_size_does_not_change_the_text);
+    RUN_TEST(test_values);
+    RUN_TEST(test_histogram_is_cumulative);
+    RUN_TEST(test_optional_samples);
+    return UNITY_END();
+}
@@ -0,0 +1,219 @@
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "UplinkProtocol.h"
+#include "UplinkProtocol.cpp"
+
+// Messwert-Quelle im Speicher, liefert höchstens maxRead Messwerte je Aufruf
+struct VectorSource {
+    std::vector<HistoryRecord> records;
+    uint32_t firstSeq = 0;
+    size_t maxRead = 1000;
+
+    size_t read(uint32_t seq, HistoryRecord* out, size_t max) {
+        if (seq < firstSeq || seq - firstSeq >= records.size()) {
+            return 0;
+        }
+        size_t count = records.size() - (seq - firstSeq);
+        count = count < max ? count : max;
+        count = count < maxRead ? count : maxRead;
+        for (size_t i = 0; i < count; i++) {
+            out[i] = records[seq - firstSeq + i];
+        }
+        return count;
+    }
+};
+
+static VectorSource source(size_t count, uint32_t firstSeq) {
+    VectorSource result;
+    result.firstSeq = firstSeq;
+    for (size_t i = 0; i < count; i++) {
+        HistoryRecord record = {1718000000 + (uint32_t)i * 60, (uint16_t)(200 + i), (uint8_t)(i % 9), (uint8_t)(i % 2)};
+        result.records.push_back(record);
+    }
+    return result;
+}
+
+static std::vector<std::string> lines(const std::string& body) {
+    std::vector<std::string> result;
+    size_t start = 0;
+    while (start < body.size()) {
+        size_t end = body.find('\n', start);
+        TEST_ASSERT_TRUE(end != std::string::npos);
+        result.push_back(body.substr(start, end - start));
+        start = end + 1;
+    }
+    return result;
+}
+
+static std::string part(const char* url, size_t start, size_t end) {
+    return std::string(url + start, url + end);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_record_line(void) {
+    char line[80];
+    HistoryRecord record = {1718000000, 612, 5, 1};
+    size_t length = uplinkFormatRecord(line, sizeof(line), 1042, record);
+    TEST_ASSERT_EQUAL_STRING("{\"seq\":1042,\"ts\":1718000000,\"level\":5,\"adc\":612,\"flags\":1}\n", line);
+    TEST_ASSERT_EQUAL(strlen(line), length);
+}
+
+void test_record_line_fits_largest_values(void) {
+    char line[80];
+    HistoryRecord record = {0xFFFFFFFF, 0xFFFF, 0xFF, 0xFF};
+    size_t length = uplinkFormatRecord(line, sizeof(line), 0xFFFFFFFF, record);
+    TEST_ASSERT_TRUE(length < sizeof(line) - 1);
+    TEST_ASSERT_EQUAL('\n', line[length - 1]);
+}
+
+void test_batch_is_limited(void) {
+    VectorSource history = source(200, 1000);
+    std::string body;
+    uint32_t end = uplinkAppendBatch(history, 1000, 1200, body);
+    TEST_ASSERT_EQUAL_UINT32(1000 + UPLINK_BATCH_MAX, end);
+    std::vector<std::string> batch = lines(body);
+    TEST_ASSERT_EQUAL(UPLINK_BATCH_MAX, batch.size());
+    TEST_ASSERT_EQUAL_STRING("{\"seq\":1000,\"ts\":1718000000,\"level\":0,\"adc\":200,\"flags\":0}", batch.front().c_str());
+    TEST_ASSERT_EQUAL_STRING("{\"seq\":1063,\"ts\":1718003780,\"level\":0,\"adc\":263,\"flags\":1}", batch.back().c_str());
+}
+
+void test_batches_continue_without_gaps(void) {
+    VectorSource history = source(150, 0);
+    history.maxRead = 7;
+    uint32_t seq = 0;
+    uint32_t expected = 0;
+    size_t batches = 0;
+    while (true) {
+        std::string body;
+        uint32_t end = uplinkAppendBatch(history, seq, 150, body);
+        if (end == seq) {
+            break;
+        }
+        for (const std::string& line : lines(body)) {
+            TEST_ASSERT_EQUAL_STRING(("{\"seq\":" + std::to_string(expected++)).c_str(), line.substr(0, line.find(',')).c_str());
+        }
+        seq = end;
+        batches++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(150, expected);
+    TEST_ASSERT_EQUAL(3, batches);
+}
+
+void test_batch_stops_at_end_and_missing_records(void) {
+    VectorSource history = source(10, 0);
+    std::string body;
+    TEST_ASSERT_EQUAL_UINT32(4, uplinkAppendBatch(history, 0, 4, body));
+    TEST_ASSERT_EQUAL(4, lines(body).size());
+
+    body.clear();
+    TEST_ASSERT_EQUAL_UINT32(10, uplinkAppendBatch(history, 5, 40, body));
+    TEST_ASSERT_EQUAL(5, lines(body).size());
+
+    body.clear();
+    TEST_ASSERT_EQUAL_UINT32(10, uplinkAppendBatch(history, 10, 40, body));
+    TEST_ASSERT_TRUE(body.empty());
+}
+
+void test_batch_skips_gap_records(void) {
+    VectorSource history = source(8, 100);
+    for (size_t i = 2; i < 5; i++) {
+        history.records[i].flags = HISTORY_FLAG_GAP;
+    }
+    std::string body;
+    TEST_ASSERT_EQUAL_UINT32(108, uplinkAppendBatch(history, 100, 108, body));
+    std::vector<std::string> batch = lines(body);
+    TEST_ASSERT_EQUAL(5, batch.size());
+    TEST_ASSERT_EQUAL_STRING("{\"seq\":101,\"ts\":1718000060,\"level\":1,\"adc\":201,\"flags\":1}", batch[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("{\"seq\":105,\"ts\":1718000300,\"level\":5,\"adc\":205,\"flags\":1}", batch[2].c_str());
+
+    // nur Lücken: Position rückt vor, ohne dass etwas angehängt wird
+    body.clear();
+    TEST_ASSERT_EQUAL_UINT32(105, uplinkAppendBatch(history, 102, 105, body));
+    TEST_ASSERT_TRUE(body.empty());
+}
+
+void test_url(void) {
+    UplinkUrl parts;
+    const char* url = "http://192.168.1.10:8080/readings?site=3";
+    TEST_ASSERT_TRUE(uplinkParseUrl(url, parts));
+    TEST_ASSERT_EQUAL_STRING("192.168.1.10", part(url, parts.hostStart, parts.hostEnd).c_str());
+    TEST_ASSERT_EQUAL(8080, parts.port);
+    TEST_ASSERT_EQUAL_STRING("/readings?site=3", url + parts.pathStart);
+
+    url = "http://collector.local";
+    TEST_ASSERT_TRUE(uplinkParseUrl(url, parts));
+    TEST_ASSERT_EQUAL_STRING("collector.local", part(url, parts.hostStart, parts.hostEnd).c_str());
+    TEST_ASSERT_EQUAL(80, parts.port);
+    TEST_ASSERT_EQUAL_STRING("", url + parts.pathStart);
+}
+
+void test_invalid_urls(void) {
+    UplinkUrl parts;
+    TEST_ASSERT_FALSE(uplinkParseUrl("", parts));
+    TEST_ASSERT_FALSE(uplinkParseUrl("https://collector.local/readings", parts));
+    TEST_ASSERT_FALSE(uplinkParseUrl("http://", parts));
+    TEST_ASSERT_FALSE(uplinkParseUrl("http:///readings", parts));
+    TEST_ASSERT_FALSE(uplinkParseUrl("http://collector:/readings", parts));
+    TEST_ASSERT_FALSE(uplinkParseUrl("http://collector:80a/readings", parts));
+    TEST_ASSERT_FALSE(uplinkParseUrl("http://collector:0", parts));
+    TEST_ASSERT_FALSE(uplinkParseUrl("http://collector:65536", parts));
+}
+
+void test_status_line(void) {
+    TEST_ASSERT_EQUAL(0, uplinkParseStatus("HTTP/1.1 20", 11));
+    TEST_ASSERT_EQUAL(204, uplinkParseStatus("HTTP/1.1 204 No Content\r\n", 25));
+    TEST_ASSERT_EQUAL(200, uplinkParseStatus("HTTP/1.0 200", 12));
+    TEST_ASSERT_EQUAL(503, uplinkParseStatus("HTTP/1.1 503 Service Unavailable", 32));
+    TEST_ASSERT_EQUAL(-1, uplinkParseStatus("HTTP/2 200 OK", 13));
+    TEST_ASSERT_EQUAL(-1, uplinkParseStatus("SSH-2.0-OpenSSH", 15));
+    TEST_ASSERT_EQUAL(-1, uplinkParseStatus("HTTP/1.1 2x0 OK", 15));
+}
+
+void test_backoff_doubles_up_to_maximum(void) {
+    unsigned long backoff = 0;
+    const unsigned long expected[] = {5000, 10000, 20000, 40000, 80000, 160000, 320000, 600000, 600000};
+    for (unsigned long value : expected) {
+        backoff = uplinkNextBackoff(backoff, 5000, 600000);
+        TEST_ASSERT_EQUAL_UINT32(value, backoff);
+    }
+}
+
+void test_retry_delay_stays_within_backoff(void) {
+    const unsigned long backoffs[] = {5000, 5001, 600000};
+    const uint32_t randoms[] = {0, 1, 2500, 2501, 123456789, 0xFFFFFFFF};
+    for (unsigned long backoff : backoffs) {
+        unsigned long shortest = backoff;
+        unsigned long longest = 0;
+        for (uint32_t random : randoms) {
+            unsigned long delay = uplinkRetryDelay(backoff, random);
+            TEST_ASSERT_TRUE(delay >= backoff / 2 && delay <= backoff);
+            shortest = delay < shortest ? delay : shortest;
+            longest = delay > longest ? delay : longest;
+        }
+        TEST_ASSERT_EQUAL_UINT32(backoff / 2, shortest);
+        TEST_ASSERT_TRUE(longest > backoff / 2);
+    }
+    TEST_ASSERT_EQUAL_UINT32(5000, uplinkRetryDelay(5000, 2500));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_record_line);
+    RUN_TEST(test_record_line_fits_largest_values);
+    RUN_TEST(test_batch_is_limited);
+    RUN_TEST(test_batches_continue_without_gaps);
+    RUN_TEST(test_batch_stops_at_end_and_missing_records);
+    RUN_TEST(test_batch_skips_gap_records);
+    RUN_TEST(test_url);
+    RUN_TEST(test_invalid_urls);
+    RUN_TEST(test_status_line);
+    RUN_TEST(test_backoff_doubles_up_to_maximum);
+    RUN_TEST(test_retry_delay_stays_within_backoff);
+    return UNITY_END();
+}
@@ -0,0 +1,98 @@
+#include <unity.h>
+
+#include <string>
+
+#include "Ws2812Encoding.h"
+#include "Ws2812Encoding.cpp"
+
+/**
+ * Pegel auf der Datenleitung, wie ihn der UART mit 6N1 und invertiertem TX
+ * ausgibt: je Zeichen Start, 6 Datenbits LSB zuerst, Stop; ein Zeichen pro
+ * Bitzeit von 312,5 ns.
+ */
+static std::string lineLevels(const uint8_t* chars, size_t count) {
+    std::string levels;
+    for (size_t i = 0; i < count; i++) {
+        levels += 'H';  // Startbit 0, invertiert
+        for (uint8_t bit = 0; bit < 6; bit++) {
+            levels += (chars[i] >> bit) & 1 ? 'L' : 'H';
+        }
+        levels += 'L';  // Stopbit 1, invertiert
+    }
+    return levels;
+}
+
+// Erwartete WS2812-Wellenform: 0 = H L L L, 1 = H H H L, MSB zuerst
+static std::string waveform(const uint8_t* data, size_t length) {
+    std::string levels;
+    for (size_t i = 0; i < length; i++) {
+        for (int8_t bit = 7; bit >= 0; bit--) {
+            levels += (data[i] >> bit) & 1 ? "HHHL" : "HLLL";
+        }
+    }
+    return levels;
+}
+
+static std::string encode(const uint8_t* data, size_t length) {
+    uint8_t out[64 * WS2812_UART_BYTES_PER_BYTE];
+    size_t count = ws2812EncodeUart(data, length, out);
+    TEST_ASSERT_EQUAL_UINT32(length * WS2812_UART_BYTES_PER_BYTE, count);
+    return lineLevels(out, count);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_zero_byte(void) {
+    const uint8_t data[] = {0x00};
+    TEST_ASSERT_EQUAL_STRING("HLLLHLLLHLLLHLLLHLLLHLLLHLLLHLLL", encode(data, 1).c_str());
+}
+
+void test_full_byte(void) {
+    const uint8_t data[] = {0xFF};
+    TEST_ASSERT_EQUAL_STRING("HHHLHHHLHHHLHHHLHHHLHHHLHHHLHHHL", encode(data, 1).c_str());
+}
+
+void test_msb_first(void) {
+    const uint8_t data[] = {0x80, 0x01};
+    TEST_ASSERT_EQUAL_STRING(
+        "HHHLHLLLHLLLHLLLHLLLHLLLHLLLHLLL"
+        "HLLLHLLLHLLLHLLLHLLLHLLLHLLLHHHL",
+        encode(data, 2).c_str());
+}
+
+void test_all_bytes_match_waveform(void) {
+    for (uint16_t value = 0; value < 256; value++) {
+        uint8_t data[] = {(uint8_t)value};
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(waveform(data, 1).c_str(), encode(data, 1).c_str(), "byte");
+    }
+}
+
+void test_grb_pixels_match_waveform(void) {
+    const uint8_t data[] = {0x12, 0x34, 0x56, 0xA5, 0x5A, 0xC3, 0x00, 0xFF, 0x0F};
+    TEST_ASSERT_EQUAL_STRING(waveform(data, sizeof(data)).c_str(), encode(data, sizeof(data)).c_str());
+}
+
+void test_uses_only_six_data_bits(void) {
+    uint8_t data[64];
+    uint8_t out[sizeof(data) * WS2812_UART_BYTES_PER_BYTE];
+    for (uint8_t i = 0; i < sizeof(data); i++) {
+        data[i] = i * 37;
+    }
+    size_t count = ws2812EncodeUart(data, sizeof(data), out);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_UINT8(0, out[i] & 0xC0);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_zero_byte);
+    RUN_TEST(test_full_byte);
+    RUN_TEST(test_msb_first);
+    RUN_TEST(test_all_bytes_match_waveform);
+    RUN_TEST(test_grb_pixels_match_waveform);
+    RUN_TEST(test_uses_only_six_data_bits);
+    return UNITY_END();
+}
@@ -7,9 +7,11 @@ export {
 	onScanForNetworks,
 	onToggleLedDirection,
 	getSensorData,
+	startSensorEvents,
 	getWifiStatus,
 	onIntervalChange,
-	onSetAdc
+	onSetAdc,
+	onCalibrate
 }
 
 let baseUrl = '';
@@ -28,10 +30,10 @@ let state = {
 		disconnect: 'disconnect',
 		status: 'status',
 		sensor: 'sensor',
-		interval: 'interval',
-		toggleWifi: 'toggleWifi',
-		ledDirection: 'ledDirection',
-		adc: 'adc'
+		events: 'events',
+		config: 'config',
+		calibration: 'calibration',
+		toggleWifi: 'toggleWifi'
 	},
 	wifi: {
 		active: {
@@ -50,39 +52,50 @@ let state = {
 };
 
 let sensorDataRequested = false;
+let sensorEvents = null;
+let sensorEventsConnected = false;
+let lastSensorData = null;
+
+/**
+ * Subscribes to the SSE channel of the device. While the channel is open,
+ * the polling in getSensorData() is paused; if the channel breaks (or the
+ * browser has no EventSource), polling takes over again. The last event is
+ * kept, so the sensor section is up to date as soon as it is shown again.
+ */
+function startSensorEvents() {
+	if (!window.EventSource || sensorEvents) {
+		return;
+	}
+	sensorEvents = new EventSource(state.api.baseUrl + state.api.events);
+	sensorEvents.onopen = () => {
+		sensorEventsConnected = true;
+	};
+	sensorEvents.onerror = () => {
+		sensorEventsConnected = false;
+	};
+	sensorEvents.addEventListener('sensor', (event) => {
+		sensorEventsConnected = true;
+		try {
+			lastSensorData = JSON.parse(event.data);
+		} catch (e) {
+			return;
+		}
+		if (state.activeSection === 'SectionSensorData') {
+			setSensorData(lastSensorData);
+		}
+	});
+}
 
 async function getSensorData() {
-	if (state.activeSection === 'SectionSensorData' && !sensorDataRequested) {
+	if (state.activeSection === 'SectionSensorData' && !sensorDataRequested && !sensorEventsConnected) {
 		sensorDataRequested = true;
 
 		try {
 			const response = await fetch(state.api.baseUrl + state.api.sensor, {
 				method: 'GET',
 			})
-			const data = await response.json();
-			const value = parseInt(data.value, 10);
-			const adcValue = parseInt(data.adcValue, 10);
-
-			const inputSensorSignalValue = document.getElementById('InputSensorSignalValue');
-			const sensorAdcMin = document.getElementById('SensorSignalAdcMin');
-			const sensorAdcMax = document.getElementById('SensorSignalAdcMax');
-
-			setIntervalSelection(data.interval);
-
-			if (!inputSensorSignalValue.classList.contains('focused')) {
-				inputSensorSignalValue.value = adcValue;
-			}
-			sensorAdcMin.innerHTML = `${data.adcMin}`;
-			sensorAdcMax.innerHTML = `${data.adcMax}`;
-
-			const sensorDigits = document.getElementById('SensorDigits');
-			const digits = sensorDigits.querySelectorAll('.digit');
-
-			sensorDigits.classList.toggle('alert', value === 0);
-			sensorDigits.classList.toggle('low', value <= 1);
-			sensorDigits.classList.toggle('medium', value > 1 && value <= 3);
-
-			digits.forEach((element, index) => element.classList.toggle('active', value >= index));
+			lastSensorData = await response.json();
+			setSensorData(lastSensorData);
 		} catch (e) {
 			return;
 		} finally {
@@ -91,6 +104,33 @@ async function getSensorData() {
 	}
 }
 
+function setSensorData(data) {
+	const value = parseInt(data.value, 10);
+	const adcValue = parseInt(data.adcValue, 10);
+
+	const inputSensorSignalValue = document.getElementById('InputSensorSignalValue');
+	const sensorAdcMin = document.getElementById('SensorSignalAdcMin');
+	const sensorAdcMax = document.getElementById('SensorSignalAdcMax');
+
+	setIntervalSelection(data.interval);
+
+	if (!inputSensorSignalValue.classList.contains('focused')) {
+		inputSensorSignalValue.value = adcValue;
+	}
+	sensorAdcMin.innerHTML = `${data.adcMin}`;
+	sensorAdcMax.innerHTML = `${data.adcMax}`;
+	setCalibrationStatus(data.calibration);
+
+	const sensorDigits = document.getElementById('SensorDigits');
+	const digits = sensorDigits.querySelectorAll('.digit');
+
+	sensorDigits.classList.toggle('alert', value === 0);
+	sensorDigits.classList.toggle('low', value <= 1);
+	sensorDigits.classList.toggle('medium', value > 1 && value <= 3);
+
+	digits.forEach((element, index) => element.classList.toggle('active', value >= index));
+}
+
 function showLoader(value) {
 	const loader = document.getElementById('Loader');
 	if (value) {
@@ -118,6 +158,9 @@ function onSwitchSection(id) {
 		getWifiStatus();
 	}
 	state.activeSection = id;
+	if (id === 'SectionSensorData' && lastSensorData) {
+		setSensorData(lastSensorData);
+	}
 }
 async function onToggleLedDirection(event) {
 	const toggle = document.getElementById('LedDirectionSwitch');
@@ -131,11 +174,7 @@ async function onToggleLedDirection(event) {
 async function toggleLedDirection(status) {
 	showLoader(true);
 	try {
-		await fetch(state.api.baseUrl + state.api.ledDirection, {
-			method: 'POST',
-			headers: { 'Content-Type': 'application/json' },
-			body: JSON.stringify({ status })
-		})
+		await patchConfig({ upsideDown: status });
 		return true;
 	} catch (e) {
 		return false;
@@ -225,7 +264,11 @@ async function onWifiConnect() {
 		});
 
 		const data = await response.json();
-		if (data?.connected) {
+		if (data?.added) {
+			// Das Gerät verbindet sich im Hintergrund, Status etwas später abfragen
+			modal.classList.remove('show');
+			setTimeout(getWifiStatus, 5000);
+		} else if (data?.connected) {
 			modal.classList.remove('show');
 			const wifiListItems = document.querySelectorAll('#WifiList .wifi-item');
 			setActiveWifi(data);
@@ -340,13 +383,9 @@ function setIntervalSelection(value) {
 
 async function onIntervalChange(event) {
 	showLoader(true);
-	const interval = event.target.value;
+	const interval = parseInt(event.target.value, 10);
 	try {
-		return await fetch(state.api.baseUrl + state.api.interval, {
-			method: 'POST',
-			headers: { 'Content-Type': 'application/json' },
-			body: JSON.stringify({ interval }),
-		});
+		return await patchConfig({ interval });
 	} catch (e) {
 		return;
 	} finally {
@@ -363,16 +402,74 @@ async function onSetAdc(change) {
 	showLoader(true);
 	try {
 		const inputSensorSignalValue = document.getElementById('InputSensorSignalValue');
-		const value = inputSensorSignalValue.value;
-		return await fetch(state.api.baseUrl + state.api.adc, {
+		const value = parseInt(inputSensorSignalValue.value, 10);
+		return await patchConfig(change === 'min' ? { adcMin: value } : { adcMax: value });
+	} catch (e) {
+		return;
+	} finally {
+		setTimeout(() => showLoader(false), 1000);
+	}
+}
+
+const calibrationErrors = {
+	noisy: 'Messwerte zu unruhig',
+	out_of_range: 'Minimum muss unter dem Maximum liegen',
+	cancelled: 'abgebrochen'
+};
+
+/**
+ * Shows the running or last calibration below the calibration buttons.
+ *
+ * @param {object} calibration the calibration of the sensor data, if any
+ */
+function setCalibrationStatus(calibration) {
+	const element = document.getElementById('SensorCalibrationStatus');
+	if (!calibration) {
+		element.innerHTML = '';
+		return;
+	}
+	const target = calibration.target === 'min' ? 'Minimum' : 'Maximum';
+	if (calibration.state === 'settling') {
+		element.innerHTML = `${target}: Sensor wird eingeschaltet …`;
+	} else if (calibration.state === 'sampling') {
+		element.innerHTML = `${target}: Messung ${calibration.progress} %`;
+	} else if (calibration.state === 'done') {
+		element.innerHTML = `${target}: ${calibration.mean} übernommen (Konfidenz ${calibration.confidence} %)`;
+	} else if (calibration.state === 'failed') {
+		element.innerHTML = `${target}: ${calibrationErrors[calibration.error] || 'fehlgeschlagen'}`;
+	}
+}
+
+/**
+ * Measures the minimum or maximum on the device. The progress arrives with
+ * the sensor data.
+ *
+ * @param {string} target "min" | "max"
+ */
+async function onCalibrate(target) {
+	try {
+		const response = await fetch(state.api.baseUrl + state.api.calibration, {
 			method: 'POST',
 			headers: { 'Content-Type': 'application/json' },
-			body: JSON.stringify({ change, value }),
+			body: JSON.stringify({ target }),
 		});
+		return await response.json();
 	} catch (e) {
 		return;
-	} finally {
-		setTimeout(() => showLoader(false), 1000);
 	}
 }
 
+/**
+ * Changes any subset of the settings with one request.
+ *
+ * @param {object} settings e.g. { interval: 5, upsideDown: true }
+ * @returns the saved settings with their version, or { error } if the change was rejected
+ */
+async function patchConfig(settings) {
+	const response = await fetch(state.api.baseUrl + state.api.config, {
+		method: 'PATCH',
+		headers: { 'Content-Type': 'application/json' },
+		body: JSON.stringify(settings),
+	});
+	return await response.json();
+}